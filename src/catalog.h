@@ -28,4 +28,9 @@ struct AttrCatEntry {
     int indexNo;                // index number, or -1 if not indexed
 };
 
+// Catalog entries are stored as records; keep their layout the same in
+// 32-bit and 64-bit builds
+static_assert(sizeof(RelCatEntry) == 44, "RelCatEntry layout changed");
+static_assert(sizeof(AttrCatEntry) == 76, "AttrCatEntry layout changed");
+
 #endif //REBASE_CATALOG_H
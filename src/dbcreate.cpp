@@ -27,14 +27,24 @@ int main(int argc, char *argv[]) {
     char *dbname;
     char command[255] = "mkdir ";
     RC rc;
+    int pageSize = PF_MIN_PAGE_BYTES;
 
-    // Look for 2 arguments. The first is always the name of the program
-    // that was executed, and the second should be the name of the
-    // database.
-    if (argc != 2) {
-        cerr << "Usage: " << argv[0] << " dbname \n";
+    // Look for 2 or 3 arguments. The first is always the name of the
+    // program that was executed, the second should be the name of the
+    // database and the optional third the size of its pages in bytes.
+    if (argc != 2 && argc != 3) {
+        cerr << "Usage: " << argv[0] << " dbname [pagesize]\n";
         exit(1);
     }
+    if (argc == 3) {
+        pageSize = atoi(argv[2]);
+        if (pageSize < PF_MIN_PAGE_BYTES || pageSize > PF_MAX_PAGE_BYTES ||
+                (pageSize & (pageSize - 1))) {
+            cerr << "page size must be a power of 2 from " << PF_MIN_PAGE_BYTES
+                << " to " << PF_MAX_PAGE_BYTES << "\n";
+            exit(1);
+        }
+    }
 
     // The database name is the second argument
     dbname = argv[1];
@@ -61,6 +71,12 @@ int main(int argc, char *argv[]) {
     PF_Manager pfm;
     RM_Manager rmm(pfm);
 
+    // All files of the database have pages of this size
+    if ((rc = pfm.SetPageSize(pageSize))) {
+        PF_PrintError(rc);
+        exit(1);
+    }
+
     // Calculate the size of entries in relcat:
     int relCatRecSize = sizeof(RelCatEntry);
     int attrCatRecSize = sizeof(AttrCatEntry);
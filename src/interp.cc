@@ -39,6 +39,7 @@ extern QL_Manager *pQlm;
 #define E_STRINGTOOLONG     -10
 #define E_MULTIPLEPRIMARYKEY -11
 #define E_PRIMARYKEYNOTFOUND -12
+#define E_INVPAGESIZE       -13
 
 /*
  * file pointer to which error messages are printed
@@ -89,7 +90,8 @@ RC interp(NODE *n) {
         return 0;
     }
 
-    static char cmd[MAXNAME * 2];
+    // the longest command: "cd ..; ./dbcreate <name> <page size>"
+    static char cmd[MAXNAME + 64];
 
     switch (n -> kind) {
         case N_SHOWDBS:
@@ -144,10 +146,16 @@ RC interp(NODE *n) {
             print_error((char*)"createdb", E_TOOLONG);
             break;
         }
-        if (db_opened) {
-            sprintf(cmd, "cd ..; ./dbcreate %s", relname);
-        } else {
-            sprintf(cmd, "./dbcreate %s", relname);
+        int pageSize = n->u.DB_OP.pageSize;
+        if (pageSize && (pageSize < PF_MIN_PAGE_BYTES || pageSize > PF_MAX_PAGE_BYTES ||
+                         (pageSize & (pageSize - 1)))) {
+            print_error((char*)"createdb", E_INVPAGESIZE);
+            break;
+        }
+        int len = snprintf(cmd, sizeof(cmd),
+                           db_opened ? "cd ..; ./dbcreate %s" : "./dbcreate %s", relname);
+        if (pageSize) {
+            snprintf(cmd + len, sizeof(cmd) - len, " %d", pageSize);
         }
         int ret = system(cmd);
         if (ret != 0) {
@@ -166,12 +174,12 @@ RC interp(NODE *n) {
             if (!strcmp(current_db, relname)) {
                 if ((errval = pSmm->CloseDb())) break;
                 db_opened = false;
-                sprintf(cmd, "rm -r %s", relname);
+                snprintf(cmd, sizeof(cmd), "rm -r %s", relname);
             } else {
-                sprintf(cmd, "rm -r ../%s", relname);
+                snprintf(cmd, sizeof(cmd), "rm -r ../%s", relname);
             }
         } else {
-            sprintf(cmd, "rm -r %s", relname);
+            snprintf(cmd, sizeof(cmd), "rm -r %s", relname);
         }
         int ret = system(cmd);
         if (ret != 0) {
@@ -231,7 +239,9 @@ RC interp(NODE *n) {
 
         /* Make the call to create */
         errval = pSmm->CreateTable(n->u.CREATETABLE.relname, nattrs,
-                                   attrInfos);
+                                   attrInfos,
+                                   n->u.CREATETABLE.options & TABLE_COMPRESSED,
+                                   n->u.CREATETABLE.options & TABLE_PAX);
         break;
     }
 
@@ -451,7 +461,7 @@ static int mk_attr_infos(NODE *list, int max, AttrInfo attrInfos[]) {
         }
         if (!strcmp(type_str, "int")) {
             type = INT;
-        } else if (!strcmp(type_str, "char")) {
+        } else if (!strcmp(type_str, "char") || !strcmp(type_str, "varchar")) {
             type = STRING;
         } else if (!strcmp(type_str, "float")) {
             type = FLOAT;
@@ -465,6 +475,8 @@ static int mk_attr_infos(NODE *list, int max, AttrInfo attrInfos[]) {
         info.attrType = type;
         info.attrLength = attrtype.size;
         info.attrSpecs = attrtype.spec;
+        if (!strcmp(type_str, "varchar"))
+            info.attrSpecs |= ATTR_SPEC_VARCHAR;
     }
 
     list_length = i;
@@ -757,6 +769,10 @@ static void print_error(char *errmsg, RC errval) {
     case E_PRIMARYKEYNOTFOUND:
         fprintf(ERRFP, "specified primary key does not appear to be an attribute name\n");
         break;
+    case E_INVPAGESIZE:
+        fprintf(ERRFP, "page size must be a power of 2 from %d to %d\n",
+                PF_MIN_PAGE_BYTES, PF_MAX_PAGE_BYTES);
+        break;
     default:
         fprintf(ERRFP, "unrecognized errval: %d\n", errval);
     }
@@ -768,7 +784,11 @@ static void echo_query(NODE *n) {
         printf("show databases;\n");
         break;
     case N_CREATEDB:
-        printf("create database %s;\n", n->u.DB_OP.relname);
+        if (n->u.DB_OP.pageSize)
+            printf("create database %s page_size %d;\n", n->u.DB_OP.relname,
+                   n->u.DB_OP.pageSize);
+        else
+            printf("create database %s;\n", n->u.DB_OP.relname);
         break;
     case N_DROPDB:
         printf("drop database %s;\n", n->u.DB_OP.relname);
@@ -783,6 +803,10 @@ static void echo_query(NODE *n) {
         printf("create table %s (", n -> u.CREATETABLE.relname);
         print_attrtypes(n -> u.CREATETABLE.attrlist);
         printf(")");
+        if (n -> u.CREATETABLE.options & TABLE_COMPRESSED)
+            printf(" compressed");
+        if (n -> u.CREATETABLE.options & TABLE_PAX)
+            printf(" pax");
         printf(";\n");
         break;
     case N_CREATEINDEX:            /* for CreateIndex() */
@@ -15,6 +15,7 @@
 #include "rm.h"
 
 #include <memory>
+#include <set>
 #include <glog/logging.h>
 
 class IX_IndexHandle;
@@ -25,6 +26,7 @@ class IX_IndexHandle;
 class IX_Manager {
     PF_Manager *pfm;
     // RM_Manager rmm;
+    int residentLimit;
 
 public:
     IX_Manager   (PF_Manager &pfm);              // Constructor
@@ -39,6 +41,10 @@ public:
                      int        indexNo,
                      IX_IndexHandle &indexHandle);
     RC CloseIndex   (IX_IndexHandle &indexHandle);  // Close index
+
+    // Most internal nodes an open index keeps pinned in the buffer pool,
+    // for indexes opened from now on (0 = none)
+    RC SetResidentLimit (int numPages);
 };
 
 //
@@ -60,6 +66,13 @@ class IX_IndexHandle {
 
     int ridsPerBucket;
 
+    // internal nodes visited by a descent stay pinned, up to residentLimit
+    // of them, until the index is closed
+    mutable int residentLimit;
+    mutable std::set<int> residentNodes;
+    RC keep_resident(int nodeNum, const void *header) const;
+    RC release_resident();
+
     // use attrType and attrLength to calculate the
     // internal parameters
     void __initialize();
@@ -102,6 +115,7 @@ class IX_IndexScan {
     const IX_IndexHandle *indexHandle;
     CompOp compOp;
     void* value;
+    ClientHint pinHint;
 
     bool scanOpened;
     int currentNodeNum;
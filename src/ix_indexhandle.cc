@@ -8,7 +8,9 @@
 #include <stddef.h>
 #include <memory>
 
-IX_IndexHandle::IX_IndexHandle() { }
+IX_IndexHandle::IX_IndexHandle() {
+    residentLimit = 0;
+}
 
 IX_IndexHandle::~IX_IndexHandle() { }
 
@@ -28,9 +30,41 @@ int IX_IndexHandle::__cmp(void* lhs, void* rhs) const {
 
 void IX_IndexHandle::__initialize() {
     entrySize = offsetof(Entry, key) + upper_align<4>(attrLength);
-    // b = (PF_PAGE_SIZE - offsetof(Entry, key) - offsetof(IX_PageHeader, entries)) / entrySize + 1;
+    int dataSize = PF_PAGE_SIZE;
+    pfHandle.GetDataSize(dataSize);
+    // b = (dataSize - offsetof(Entry, key) - offsetof(IX_PageHeader, entries)) / entrySize + 1;
     b = 4; // for debugging
-    ridsPerBucket = (PF_PAGE_SIZE - offsetof(IX_BucketHeader, rids)) / sizeof(RID);
+    ridsPerBucket = (dataSize - offsetof(IX_BucketHeader, rids)) / sizeof(RID);
+}
+
+// Root-to-leaf descents pass through the same few internal nodes every
+// time.  Keep such a node resident in the buffer pool until the index is
+// closed, so that heap scans cannot evict it; beyond residentLimit nodes
+// (or once the buffer pool has no room for more) they are only fetched
+// with KEEP_HOT.
+RC IX_IndexHandle::keep_resident(int nodeNum, const void *_header) const {
+    const IX_PageHeader *header = (const IX_PageHeader*)_header;
+    if (header->type != kInternalNode ||
+            (int)residentNodes.size() >= residentLimit ||
+            residentNodes.count(nodeNum)) {
+        return 0;
+    }
+    int rc = pfHandle.KeepResident(nodeNum);
+    if (rc == PF_TOOMANYRESIDENT) {
+        residentLimit = (int)residentNodes.size();
+        return 0;
+    }
+    TRY(rc);
+    residentNodes.insert(nodeNum);
+    return 0;
+}
+
+RC IX_IndexHandle::release_resident() {
+    for (int nodeNum : residentNodes) {
+        TRY(pfHandle.ReleaseResident(nodeNum));
+    }
+    residentNodes.clear();
+    return 0;
 }
 
 RC IX_IndexHandle::new_node(int *nodeNum) {
@@ -171,8 +205,9 @@ RC IX_IndexHandle::insert_internal_entry(void *_header, int index, void* key, in
 RC IX_IndexHandle::insert_internal(int nodeNum, int *splitNode, std::unique_ptr<char[]> *splitKey, void *pData, const RID &rid) {
     PF_PageHandle ph;
     IX_PageHeader *header;
-    TRY(pfHandle.GetThisPage(nodeNum, ph));
+    TRY(pfHandle.GetThisPage(nodeNum, ph, KEEP_HOT));
     TRY(ph.GetData(CVOID(header)));
+    TRY(keep_resident(nodeNum, header));
     char* entries = header->entries;
     short &n = header->childrenNum;
     // NOTE: entry[0] .. entry[n - 1] contains child_ptr[i] and key[i]
@@ -371,9 +406,10 @@ RC IX_IndexHandle::DeleteEntry(void *pData, const RID &rid) {
     bool should_stop = false;
     int ret = 0;
     while (!should_stop) {
-        TRY(pfHandle.GetThisPage(currentNodeNum, page));
+        TRY(pfHandle.GetThisPage(currentNodeNum, page, KEEP_HOT));
         int openedPageNum = currentNodeNum;
         TRY(page.GetData(CVOID(header)));
+        TRY(keep_resident(currentNodeNum, header));
         if (header->type == kLeafNode) {
             should_stop = true;
             for (int i = 0; i < header->childrenNum; ++i) {
@@ -41,6 +41,7 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle, CompOp compOp, void
     this->indexHandle = &indexHandle;
     this->compOp = compOp;
     this->value = value;
+    this->pinHint = pinHint;
     bool initial_search_needed = false;
     switch (compOp) {
         case GT_OP:
@@ -66,9 +67,15 @@ RC IX_IndexScan::OpenScan(const IX_IndexHandle &indexHandle, CompOp compOp, void
     while (!should_stop) {
         PF_PageHandle page;
         IX_PageHeader *header;
-        TRY(file.GetThisPage(currentNodeNum, page));
+        // the path from the root is shared by every lookup, keep it in the
+        // buffer unless the whole index is being scanned once
+        TRY(file.GetThisPage(currentNodeNum, page,
+                    pinHint == SEQUENTIAL_SCAN ? pinHint : KEEP_HOT));
         int openedPageNum = currentNodeNum;
         TRY(page.GetData(CVOID(header)));
+        if (pinHint != SEQUENTIAL_SCAN) {
+            TRY(indexHandle.keep_resident(currentNodeNum, header));
+        }
         if (header->type == kLeafNode) {
             if (compOp == GT_OP || compOp == GE_OP) {
                 for (currentEntryIndex = 0; currentEntryIndex < header->childrenNum;
@@ -115,7 +122,7 @@ RC IX_IndexScan::GetNextEntry(RID &rid) {
     while (!should_exit) {
         IX_PageHeader* header;
         int openedPageNum = currentNodeNum;
-        TRY(file.GetThisPage(currentNodeNum, page));
+        TRY(file.GetThisPage(currentNodeNum, page, pinHint));
         TRY(page.GetData(CVOID(header)));
         Entry* entry = (Entry*)indexHandle->__get_entry(header->entries, currentEntryIndex);
         if (currentEntryIndex == header->childrenNum) {
@@ -135,7 +142,7 @@ RC IX_IndexScan::GetNextEntry(RID &rid) {
                 } else {
                     PF_PageHandle bucket;
                     IX_BucketHeader *bucket_header;
-                    TRY(file.GetThisPage(entry->pageNum, bucket));
+                    TRY(file.GetThisPage(entry->pageNum, bucket, pinHint));
                     TRY(bucket.GetData(CVOID(bucket_header)));
                     // NOTE: currentBucketIndex may be greater than bucket_header->ridNum
                     // as a result of deletion during the scan
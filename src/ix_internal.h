@@ -1,11 +1,13 @@
 #pragma once
 
+#include <cstddef>
 #include "redbase.h"
 #include "rm_rid.h"
 
 static const int kLastFreePage = -1;
 static const int kNullNode = -1;
 static const int kInvalidBucket = -1;
+static const int kResidentNodes = 4;    // default internal nodes kept pinned
 
 struct IX_FileHeader {
     AttrType attrType;
@@ -39,3 +41,9 @@ struct IX_BucketHeader {
     RID rids[1];
 };
 
+// The headers are stored on disk; keep their layout the same in 32-bit
+// and 64-bit builds
+static_assert(sizeof(IX_FileHeader) == 16, "IX_FileHeader layout changed");
+static_assert(offsetof(IX_PageHeader, entries) == 4, "IX_PageHeader layout changed");
+static_assert(offsetof(IX_BucketHeader, rids) == 4, "IX_BucketHeader layout changed");
+
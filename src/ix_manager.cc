@@ -17,13 +17,16 @@ static std::string filename_gen(const char* fileName, int indexNo) {
 
 IX_Manager::IX_Manager(PF_Manager &pfm) /* : rmm(pfm) */ {
     this->pfm = &pfm;
+    this->residentLimit = kResidentNodes;
 }
 
 IX_Manager::~IX_Manager() { }
 
 RC IX_Manager::CreateIndex(const char *fileName, int indexNo, AttrType attrType, int attrLength) {
     int attrSize = upper_align<4>(attrLength);
-    if (offsetof(IX_PageHeader, entries) + attrSize + 2 * offsetof(Entry, key) > PF_PAGE_SIZE) {
+    int dataSize;
+    TRY(pfm->GetDataSize(dataSize));
+    if (offsetof(IX_PageHeader, entries) + attrSize + 2 * offsetof(Entry, key) > (size_t)dataSize) {
         return IX_ATTR_TOO_LARGE;
     }
     std::string indexFileName = filename_gen(fileName, indexNo);
@@ -83,6 +86,8 @@ RC IX_Manager::OpenIndex(const char *fileName, int indexNo, IX_IndexHandle &inde
     indexHandle.root = fileHeader->root;
     indexHandle.firstFreePage = fileHeader->firstFreePage;
     indexHandle.isHeaderDirty = false;
+    indexHandle.residentLimit = residentLimit;
+    indexHandle.residentNodes.clear();
     TRY(fileHandle.UnpinPage(0));
     // the initialization MUST come after information in the
     // header copied into the handle
@@ -97,6 +102,8 @@ RC IX_Manager::OpenIndex(const char *fileName, int indexNo, IX_IndexHandle &inde
 RC IX_Manager::CloseIndex(IX_IndexHandle &indexHandle) {
     PF_FileHandle &fileHandle = indexHandle.pfHandle;
 
+    TRY(indexHandle.release_resident());
+
     if (indexHandle.isHeaderDirty) {
         PF_PageHandle pageHandle;
         IX_FileHeader *fileHeader;
@@ -116,3 +123,8 @@ RC IX_Manager::CloseIndex(IX_IndexHandle &indexHandle) {
     // TRY(rmm.CloseFile(rmHandle));
     return 0;
 }
+
+RC IX_Manager::SetResidentLimit(int numPages) {
+    residentLimit = numPages < 0 ? 0 : numPages;
+    return 0;
+}
@@ -79,9 +79,10 @@ NODE *show_dbs_node() {
     return newnode(N_SHOWDBS);
 }
 
-NODE *create_db_node(char *relname) {
+NODE *create_db_node(char *relname, int pageSize) {
     NODE *n = newnode(N_CREATEDB);
     n->u.DB_OP.relname = relname;
+    n->u.DB_OP.pageSize = pageSize;
     return n;
 }
 
@@ -105,11 +106,12 @@ NODE *show_tables_node() {
  * create_table_node: allocates, initializes, and returns a pointer to a new
  * create table node having the indicated values.
  */
-NODE *create_table_node(char *relname, NODE *attrlist) {
+NODE *create_table_node(char *relname, NODE *attrlist, int options) {
     NODE *n = newnode(N_CREATETABLE);
 
     n -> u.CREATETABLE.relname = relname;
     n -> u.CREATETABLE.attrlist = attrlist;
+    n -> u.CREATETABLE.options = options;
     return n;
 }
 
@@ -36,17 +36,9 @@ using namespace std;
 void yyrestart(FILE*);
 #endif
 
-// The PF_STATS indicates that we will be tracking statistics for the PF
-// Layer.  The Manager is defined within pf_buffermgr.cc.  
-// We include it within the parser so that a system command can display
+// The statistics of the PF layer, so that a system command can display
 // statistics about the DB.
-#ifdef PF_STATS
-#include "statistics.h"
-
-// This is defined within the pf_buffermgr.cc
-extern StatisticsMgr *pStatisticsMgr;
-
-#endif    // PF_STATS
+#include "pf_statistics.h"
 
 /*
  * string representation of tokens; provided by scanner
@@ -97,6 +89,9 @@ QL_Manager *pQlm;          // QL component manager
       RW_VALUES
       RW_DATABASE
       RW_DATABASES
+      RW_PAGE_SIZE
+      RW_COMPRESSED
+      RW_PAX
       RW_TABLES
       RW_SHOW
       RW_USE
@@ -134,6 +129,8 @@ QL_Manager *pQlm;          // QL component manager
 
 %type   <sval>   opt_relname
 
+%type   <ival>   opt_table_options
+
 %type   <n>   command
       ddl
       dml
@@ -286,23 +283,13 @@ buffer
 statistics
    : RW_PRINT RW_IO
    {
-      #ifdef PF_STATS
-         cout << "Statistics\n";
-         cout << "----------\n";
-         pStatisticsMgr->Print();
-      #else
-         cout << "Statitisics not compiled.\n";
-      #endif
+      PF_Statistics();
       $$ = NULL;
    }
    | RW_RESET RW_IO
    {
-      #ifdef PF_STATS
-         cout << "Statistics reset.\n";
-         pStatisticsMgr->Reset();
-      #else
-         cout << "Statitisics not compiled.\n";
-      #endif
+      cout << "Statistics reset.\n";
+      PF_ResetStatistics();
       $$ = NULL;
    }
    ;
@@ -317,7 +304,11 @@ showdbs
 createdb
    : RW_CREATE RW_DATABASE T_STRING
    {
-      $$ = create_db_node($3);
+      $$ = create_db_node($3, 0);
+   }
+   | RW_CREATE RW_DATABASE T_STRING RW_PAGE_SIZE T_INT
+   {
+      $$ = create_db_node($3, $5);
    }
    ;
 
@@ -343,9 +334,24 @@ showtables
    ;
 
 createtable
-   : RW_CREATE RW_TABLE T_STRING '(' non_mt_attrtype_list ')'
+   : RW_CREATE RW_TABLE T_STRING '(' non_mt_attrtype_list ')' opt_table_options
+   {
+      $$ = create_table_node($3, $5, $7);
+   }
+   ;
+
+opt_table_options
+   : opt_table_options RW_COMPRESSED
    {
-      $$ = create_table_node($3, $5);
+      $$ = $1 | TABLE_COMPRESSED;
+   }
+   | opt_table_options RW_PAX
+   {
+      $$ = $1 | TABLE_PAX;
+   }
+   | nothing
+   {
+      $$ = 0;
    }
    ;
 
@@ -383,6 +389,13 @@ set
    {
       $$ = set_node($2, $4);
    }
+   | RW_SET T_STRING T_EQ T_INT
+   {
+      /* the node is interpreted before the next command is parsed */
+      static char intValue[16];
+      sprintf(intValue, "%d", $4);
+      $$ = set_node($2, intValue);
+   }
    ;
 
 help
@@ -446,6 +459,11 @@ non_mt_attrtype_list
    }
    ;
 
+/*
+ * The type is a name: int, float, char or varchar.  A varchar(n) is a
+ * string of at most n characters that is stored at its actual length.
+ * Type names are not reserved words; mk_attr_infos checks them.
+ */
 attrtype
    : T_STRING T_STRING '(' T_INT ')'
    {
@@ -22,6 +22,12 @@ typedef float real;
  */
 #define PROMPT  "\nREDBASE >> "
 
+/*
+ * options of create table
+ */
+#define TABLE_COMPRESSED    0x1     /* store the pages compressed */
+#define TABLE_PAX           0x2     /* store each page column by column */
+
 /*
  * REL_ATTR: describes a qualified attribute (relName.attrName)
  */
@@ -81,12 +87,14 @@ typedef struct node {
         /* SM component nodes */
         struct {
             char *relname;
+            int pageSize;       /* CREATE DATABASE only; 0 = default */
         } DB_OP;
 
         /* create table node */
         struct {
             char *relname;
             struct node *attrlist;
+            int options;        /* TABLE_COMPRESSED, TABLE_PAX */
         } CREATETABLE;
 
         /* create index node */
@@ -212,11 +220,11 @@ typedef struct node {
  */
 NODE *newnode(NODEKIND kind);
 NODE *show_dbs_node();
-NODE *create_db_node(char *relname);
+NODE *create_db_node(char *relname, int pageSize);
 NODE *drop_db_node(char *relname);
 NODE *use_db_node(char *relname);
 NODE *show_tables_node();
-NODE *create_table_node(char *relname, NODE *attrlist);
+NODE *create_table_node(char *relname, NODE *attrlist, int options);
 NODE *create_index_node(char *relname, char *attrname);
 NODE *drop_index_node(char *relname, char *attrname);
 NODE *drop_table_node(char *relname);
@@ -12,10 +12,23 @@
 //       a particular file.  Allows students to use main memory chunks
 //       that are associated with (and limited by) the buffer.
 // 2005: Added GetLastPage and GetPrevPage for rocking
+//
+// The file header keeps a free-page bitmap, and files grow in preallocated
+// chunks (SetExtendChunk).  Files can be opened read-only through mmap
+// (PF_MMAP) and their pages stored compressed (CreateFile).  The page size
+// is chosen per database, from 4K to 64K (SetPageSize).  Pages are fetched
+// with a ClientHint, and clients can keep pages resident (KeepResident).
+// The pages resident when files are closed are read in again when the
+// files are next opened, even after a restart (warm-up).  Buffer accesses
+// can be traced for pf_replay (StartTrace).
 
 #ifndef PF_H
 #define PF_H
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 #include "redbase.h"
 
 //
@@ -30,7 +43,42 @@ typedef int PageNum;
 // Unfortunately, we cannot use sizeof(PF_PageHdr) here, but it is an
 // int and we simply use that.
 //
-const int PF_PAGE_SIZE = 4096 - sizeof(int);
+// Pages take PF_MIN_PAGE_BYTES on disk unless PF_Manager::SetPageSize
+// chose a larger power of two, up to PF_MAX_PAGE_BYTES.  PF_PAGE_SIZE is
+// the space clients get in a page of the default size; ask the file
+// handle (GetDataSize) for the space in the pages of a given file.
+//
+const int PF_MIN_PAGE_BYTES = 4096;
+const int PF_MAX_PAGE_BYTES = 65536;
+const int PF_PAGE_SIZE = PF_MIN_PAGE_BYTES - sizeof(int);
+const int PF_MAX_PAGE_SIZE = PF_MAX_PAGE_BYTES - sizeof(int);
+
+//
+// PF_ReplacePolicy: how the buffer manager chooses a page to replace
+//
+// PF_LRU replaces the least recently used unpinned page.  PF_2Q keeps
+// pages that were only touched once (e.g. by a sequential scan) apart
+// from pages that are re-referenced, so large scans do not flush the
+// working set out of the buffer.
+//
+enum PF_ReplacePolicy {
+    PF_LRU,
+    PF_2Q
+};
+
+//
+// PF_OpenMode: how PF_Manager::OpenFile opens a file
+//
+// PF_MMAP maps the file read-only into memory.  Pages are handed out as
+// pointers into the mapping and do not take up buffer frames.  Such a
+// file cannot be changed: AllocatePage, DisposePage and MarkDirty return
+// PF_READONLY, and the page data must not be written to.  The pages of
+// a compressed file cannot be mapped; PF_MMAP opens it like PF_READWRITE.
+//
+enum PF_OpenMode {
+    PF_READWRITE,
+    PF_MMAP
+};
 
 //
 // PF_PageHandle: PF page interface
@@ -57,15 +105,40 @@ private:
 //
 // PF_FileHdr: Header structure for files
 //
+// The header fills the first PF_MIN_PAGE_BYTES of the file, whatever the
+// size of its pages.  The space after the counters holds a bitmap with
+// one bit per page, set when the page is free, so that scans and
+// allocation need not read free pages.  Pages past the end of the bitmap,
+// and the free pages of files written before the bitmap existed, are kept
+// on the linked free list instead.  The flags and the page size come
+// last; they are 0 in files written before they were recorded, whose
+// pages are 4K and not compressed.
+//
+// Disk space is reserved for allocPages pages; the pages past numPages
+// are the preallocated tail that AllocatePage hands out before it extends
+// the file again.  Files written before the tail was recorded have 0.
+//
+const int PF_FREEMAP_BYTES = PF_MIN_PAGE_BYTES - 5 * sizeof(int);
+
 struct PF_FileHdr {
     int firstFree;     // first free page in the linked list
     int numPages;      // # of pages in the file
+    unsigned char freeMap[PF_FREEMAP_BYTES];      // bit set: page is free
+    int allocPages;    // pages with disk space reserved
+    int flags;         // PF_FILE_COMPRESSED
+    int pageSize;      // bytes per page, page header included
 };
 
 //
 // PF_FileHandle: PF File interface
 //
+// Several threads may share a handle for GetThisPage, MarkDirty and
+// UnpinPage.  The other methods must not run concurrently with any
+// method of the same handle.
+//
 class PF_BufferMgr;
+struct PF_FileMap;
+class PF_PageMap;
 
 class PF_FileHandle {
     friend class PF_Manager;
@@ -80,11 +153,13 @@ public:
     PF_FileHandle& operator=(const PF_FileHandle &fileHandle);
 
     // Get the first page
-    RC GetFirstPage(PF_PageHandle &pageHandle) const;
+    RC GetFirstPage(PF_PageHandle &pageHandle, ClientHint hint = NO_HINT) const;
     // Get the next page after current
-    RC GetNextPage (PageNum current, PF_PageHandle &pageHandle) const;
+    RC GetNextPage (PageNum current, PF_PageHandle &pageHandle,
+                    ClientHint hint = NO_HINT) const;
     // Get a specific page
-    RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle) const;
+    RC GetThisPage (PageNum pageNum, PF_PageHandle &pageHandle,
+                    ClientHint hint = NO_HINT) const;
     // Get the last page
     RC GetLastPage(PF_PageHandle &pageHandle) const;
     // Get the prev page after current
@@ -95,23 +170,58 @@ public:
     RC MarkDirty   (PageNum pageNum) const;        // Mark page as dirty
     RC UnpinPage   (PageNum pageNum) const;        // Unpin the page
 
+    // Keep a page pinned in the buffer until ReleaseResident.  At most
+    // half of the buffer can be kept resident by all files together.
+    RC KeepResident   (PageNum pageNum) const;
+    RC ReleaseResident(PageNum pageNum) const;
+
     // Flush pages from buffer pool.  Will write dirty pages to disk.
     RC FlushPages  () const;
 
     // Force a page or pages to disk (but do not remove from the buffer pool)
     RC ForcePages  (PageNum pageNum=ALL_PAGES) const;
 
+    // Space for client data in each page of the file
+    RC GetDataSize (int &dataSize) const;
+
 private:
 
     // IsValidPageNum will return TRUE if page number is valid and FALSE
     // otherwise
     int IsValidPageNum (PageNum pageNum) const;
 
+    // Read ahead if the page after current is fetched sequentially
+    void ReadAhead     (PageNum current, ClientHint hint) const;
+
+    // Transfer the file header
+    RC ReadHdr         ();
+    RC WriteHdr        () const;
+
+    // Get a page of a file opened with PF_MMAP
+    RC GetMappedPage   (PageNum pageNum, PF_PageHandle &pageHandle) const;
+
+    // Free-space bitmap in the file header
+    int  IsFree        (PageNum pageNum) const;
+    void SetFree       (PageNum pageNum, int bFree);
+    PageNum LowestFree ();
+
+    // Reserve disk space for pageNum and the chunk after it
+    void ExtendFile    (PageNum pageNum);
+
     PF_BufferMgr *pBufferMgr;                      // pointer to buffer manager
     PF_FileHdr hdr;                                // file header
     int bFileOpen;                                 // file open flag
     int bHdrChanged;                               // dirty flag for file hdr
     int unixfd;                                    // OS file descriptor
+    int freeHint;                                  // no free bit before
+                                                   // this byte of freeMap
+    PF_FileMap *pMap;                              // mapping, if PF_MMAP
+    PF_PageMap *pPageMap;                          // extents, if compressed
+
+    // Sequential access detection for read-ahead
+    mutable PageNum raLast;                        // last page from GetNextPage
+    mutable PageNum raEnd;                         // end of last read-ahead
+    mutable int     raWindow;                      // current read-ahead size
 };
 
 //
@@ -121,11 +231,13 @@ class PF_Manager {
 public:
     PF_Manager    ();                              // Constructor
     ~PF_Manager   ();                              // Destructor
-    RC CreateFile    (const char *fileName);       // Create a new file
+    // Create a new file.  With bCompress its pages are stored compressed.
+    RC CreateFile    (const char *fileName, int bCompress = FALSE);
     RC DestroyFile   (const char *fileName);       // Delete a file
 
     // Open and close file methods
-    RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle);
+    RC OpenFile      (const char *fileName, PF_FileHandle &fileHandle,
+                      PF_OpenMode mode = PF_READWRITE);
     RC CloseFile     (PF_FileHandle &fileHandle);
 
     // Three methods that manipulate the buffer manager.  The calls are
@@ -135,6 +247,49 @@ public:
     RC PrintBuffer   ();
     RC ResizeBuffer  (int iNewSize);
 
+    // Select the page replacement policy of the buffer manager
+    RC SetReplacePolicy(PF_ReplacePolicy policy);
+
+    // Set the largest number of pages read ahead by a sequential scan
+    // (0 disables read-ahead)
+    RC SetReadAhead  (int maxPages);
+
+    // Set the percentage of the buffer, counted from the next page to be
+    // replaced, that a background thread keeps clean (0 turns it off)
+    RC SetCleanTarget(int percent);
+
+    // Set how many bytes of disk space are reserved at a time when a
+    // file grows, up to PF_MAX_EXTEND_BYTES (0 grows files page by page)
+    RC SetExtendChunk(int numBytes);
+
+    // Write the buffer accesses to a trace file, for pf_replay
+    RC StartTrace    (const char *fileName);
+    RC StopTrace     ();
+
+    // Back the buffer pool with (transparent) huge pages
+    RC SetHugePages  (int bHugePages);
+
+    // Size of the pages of the files created and opened from now on: a
+    // power of two from PF_MIN_PAGE_BYTES to PF_MAX_PAGE_BYTES.  No page
+    // may be pinned in the buffer.
+    RC SetPageSize   (int pageSize);
+    RC GetPageSize   (int &pageSize) const;
+    // Space for client data in a page of the current size
+    RC GetDataSize   (int &dataSize) const;
+    // Page size recorded in the header of a file that is not open
+    RC GetFilePageSize(const char *fileName, int &pageSize) const;
+
+    // Open files from now on with O_DIRECT so that the buffer pool is
+    // their only cache (where the file system supports it)
+    RC SetDirectIO   (int bDirectIO);
+
+    // Buffer warm-up.  The pages of a file that are in the buffer when
+    // the file is closed are remembered, least recently used first.
+    // SaveWarmUp writes the list; after LoadWarmUp the pages of each file
+    // in the list are read ahead the first time the file is opened.
+    RC SaveWarmUp    (const char *listName);
+    RC LoadWarmUp    (const char *listName);
+
     // Three Methods for manipulating raw memory buffers.  These memory
     // locations are handled by the buffer manager, but are not
     // associated with a particular file.  These should be used if you
@@ -155,7 +310,19 @@ public:
     RC DisposeBlock  (char *buffer);
 
 private:
+    // Remember the resident pages of a file being closed
+    void RecordWarmUp  (int fd);
+    // Read ahead the remembered pages of a file being opened
+    void StartWarmUp   (const char *fileName, int fd);
+
     PF_BufferMgr *pBufferMgr;                      // page-buffer manager
+    int          bDirectIO;                        // open files O_DIRECT
+
+    std::map<int, std::string> fileNames;          // open files by fd
+    std::vector<std::pair<std::string, PageNum> >
+                 warmPages;                        // remembered pages, least
+                                                   // recently used first
+    std::set<std::string> warmedFiles;             // opened since LoadWarmUp
 };
 
 //
@@ -172,7 +339,12 @@ void PF_PrintError(RC rc);
 #define PF_PAGEUNPINNED    (START_PF_WARN + 6) // page already unpinned
 #define PF_EOF             (START_PF_WARN + 7) // end of file
 #define PF_TOOSMALL        (START_PF_WARN + 8) // Resize buffer too small
-#define PF_LASTWARN        PF_TOOSMALL
+#define PF_READONLY        (START_PF_WARN + 9) // file is opened read-only
+#define PF_TOOMANYRESIDENT (START_PF_WARN + 10) // resident pages use up
+                                                // half of the buffer
+#define PF_BADPAGESIZE     (START_PF_WARN + 11) // page size not supported
+                                                // or not the buffer's
+#define PF_LASTWARN        PF_BADPAGESIZE
 
 #define PF_NOMEM           (START_PF_ERR - 0)  // no memory
 #define PF_NOBUF           (START_PF_ERR - 1)  // no buffer space
@@ -187,8 +359,10 @@ void PF_PrintError(RC rc);
 #define PF_HASHPAGEEXIST   (START_PF_ERR - 8) // page already in hash table
 #define PF_INVALIDNAME     (START_PF_ERR - 9) // invalid PC file name
 
+#define PF_BADCOMPRESSED   (START_PF_ERR - 10) // compressed page is corrupt
+
 // Error in UNIX system call or library routine
-#define PF_UNIX            (START_PF_ERR - 10) // Unix error
+#define PF_UNIX            (START_PF_ERR - 11) // Unix error
 #define PF_LASTERROR       PF_UNIX
 
 #endif
@@ -14,23 +14,28 @@
 // 1998: The statistics manager is now instantiated in this file and is
 //       created and destroyed by the buffer manager.
 //
+// The buffer may be used by several threads; see pf_buffermgr.h for the
+// latching rules.  An optional background flusher (SetCleanTarget) writes
+// dirty pages ahead of their replacement.  Pages of compressed files go
+// through ReadCompressed and WriteCompressed.  GetResidentPages and WarmUp
+// serve the warm-up of PF_Manager, and StartTrace records the accesses
+// for pf_replay.  The statistics are the counters of pf_statistics.h.
+//
 
 #include <cstdio>
+#include <cerrno>
+#include <climits>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 #include <iostream>
+#include <chrono>
+#include <algorithm>
 #include "pf_buffermgr.h"
+#include "pf_statistics.h"
 
 using namespace std;
 
-// The switch PF_STATS indicates that the user wishes to have statistics
-// tracked for the PF layer
-#ifdef PF_STATS
-#include "statistics.h"   // For StatisticsMgr interface
-
-// Global variable for the statistics manager
-StatisticsMgr *pStatisticsMgr;
-#endif
-
 #ifdef PF_LOG
 
 //
@@ -85,27 +90,19 @@ void WriteLog(const char *psMessage)
 //       it checks if it is in the buffer.  If so, it pins the page (pages
 //       can be pinned multiple times).  If not, it reads it from the file
 //       and pins it.  If the buffer is full and a new page needs to be
-//       inserted, an unpinned page is replaced according to an LRU
+//       inserted, an unpinned page is replaced according to the
+//       replacement policy (LRU by default, see SetReplacePolicy).
 // In:   numPages - the number of pages in the buffer
 //
-// Note: The constructor will initialize the global pStatisticsMgr.  We
-//       make it global so that other components may use it and to allow
-//       easy access.
-//
 // Aut2003
 // numPages changed to _numPages for to eliminate CC warnings
 
-PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
+PF_BufferMgr::PF_BufferMgr(int _numPages) : sharedLatch(bufLatch)
 {
     // Initialize local variables
     this->numPages = _numPages;
     pageSize = PF_PAGE_SIZE + sizeof(PF_PageHdr);
 
-#ifdef PF_STATS
-    // Initialize the global variable for the statistics manager
-    pStatisticsMgr = new StatisticsMgr();
-#endif
-
 #ifdef PF_LOG
     char psMessage[100];
     sprintf (psMessage, "Creating buffer manager. %d pages of size %d.\n",
@@ -113,31 +110,130 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
     WriteLog(psMessage);
 #endif
 
-    // Allocate memory for buffer page description table
+    // Allocate memory for buffer page description table and page table
     bufTable = new PF_BufPageDesc[numPages];
+    parts = new PF_BufPartition[PF_BUFFER_PARTITIONS];
+    for (int i = 0; i < PF_BUFFER_PARTITIONS; i++)
+        parts[i].hashTable.Resize(numPages / PF_BUFFER_PARTITIONS + 1);
 
-    // Initialize the buffer table and allocate memory for buffer pages.
-    // Initially, the free list contains all pages
-    for (int i = 0; i < numPages; i++) {
-        if ((bufTable[i].pData = new char[pageSize]) == NULL) {
-            cerr << "Not enough memory for buffer\n";
-            exit(1);
-        }
-
-        memset ((void *)bufTable[i].pData, 0, pageSize);
+    // Allocate memory for buffer pages
+    bHugePages = FALSE;
+    MapFrames(0, numPages);
 
-        bufTable[i].prev = i - 1;
-        bufTable[i].next = i + 1;
+    // Initialize the buffer table.  Initially, the free lists contain
+    // all pages
+    for (int i = 0; i < numPages; i++) {
+        bufTable[i].bDirty = FALSE;
+        bufTable[i].pinCount = 0;
+        bufTable[i].usage = FALSE;
+        bufTable[i].bInIO = FALSE;
+        bufTable[i].pPending = NULL;
+        bufTable[i].bWriting = FALSE;
     }
-    bufTable[0].prev = bufTable[numPages - 1].next = INVALID_SLOT;
-    free = 0;
-    first = last = INVALID_SLOT;
+    shards = new PF_BufShard[PF_BUFFER_PARTITIONS];
+    numShards = 1;
+    policy = PF_LRU;
+    RebuildShards();
+    readAheadPages = PF_READAHEAD_PAGES;
+    extendBytes = PF_EXTEND_BYTES;
+    scanRingPages = RingSize(numPages);
+    ringReuses = 0;
+    numResident = 0;
+    pIO = PF_IOService::Create();
+
+    pFlushIO = NULL;
+    cleanTarget = 0;
+    bStopFlusher = FALSE;
+    numWriting = 0;
+    flushRounds = flushedPages = dirtyEvictions = 0;
+    compPageBytes = compStoredBytes = 0;
 
 #ifdef PF_LOG
     WriteLog("Succesfully created the buffer manager.\n");
 #endif
 }
 
+//
+// operator=
+//
+// Desc: Copy a descriptor when the table of descriptors is replaced.
+//       The caller holds every latch, so the atomic members are simply
+//       copied by value.
+//
+PF_BufPageDesc &PF_BufPageDesc::operator=(const PF_BufPageDesc &desc)
+{
+    pData       = desc.pData;
+    next        = desc.next;
+    prev        = desc.prev;
+    bDirty      = desc.bDirty.load();
+    pinCount    = desc.pinCount.load();
+    usage       = desc.usage.load();
+    pageNum     = desc.pageNum;
+    fd          = desc.fd;
+    bInIO       = desc.bInIO;
+    pPending    = desc.pPending;
+    bWriting    = desc.bWriting;
+    return (*this);
+}
+
+//
+// PF_PoolLatch
+//
+// Desc: Hold the latch exclusive (lock) or shared (lock_shared), and
+//       release it again.  The names are those of std::shared_mutex, so
+//       that the latch works with the standard lock guards.
+//       A thread that wants the latch exclusive announces itself
+//       (numWaiting, then bExclusive) before it looks at numShared, and a
+//       thread that wants it shared counts itself in numShared before it
+//       looks at those two, so one of them always sees the other.  The
+//       shared holder then backs off; the last one to leave wakes up the
+//       exclusive one.
+//
+void PF_PoolLatch::lock()
+{
+    unique_lock<mutex> guard(latch);
+    numWaiting++;
+    while (bExclusive)
+        changed.wait(guard);
+    bExclusive = true;
+    numWaiting--;
+    while (numShared > 0)
+        changed.wait(guard);
+}
+
+void PF_PoolLatch::unlock()
+{
+    {
+        lock_guard<mutex> guard(latch);
+        bExclusive = false;
+    }
+    changed.notify_all();
+}
+
+void PF_PoolLatch::lock_shared()
+{
+    for (;;) {
+        if (numWaiting == 0 && !bExclusive) {
+            numShared++;
+            if (numWaiting == 0 && !bExclusive)
+                return;
+            unlock_shared();
+        }
+
+        unique_lock<mutex> guard(latch);
+        while (numWaiting > 0 || bExclusive)
+            changed.wait(guard);
+    }
+}
+
+void PF_PoolLatch::unlock_shared()
+{
+    if (--numShared == 0 && (numWaiting > 0 || bExclusive)) {
+        lock_guard<mutex> guard(latch);
+        changed.notify_all();
+    }
+}
+
 //
 // ~PF_BufferMgr
 //
@@ -145,16 +241,28 @@ PF_BufferMgr::PF_BufferMgr(int _numPages) : hashTable(PF_HASH_TBL_SIZE)
 //
 PF_BufferMgr::~PF_BufferMgr()
 {
-    // Free up buffer pages and tables
-    for (int i = 0; i < this->numPages; i++)
-        delete [] bufTable[i].pData;
+    // Stop the flusher; it finishes the round it is in
+    if (flusher.joinable()) {
+        {
+            lock_guard<PF_PoolLatch> guard(bufLatch);
+            bStopFlusher = TRUE;
+        }
+        flusherWake.notify_all();
+        flusher.join();
+        delete pFlushIO;
+    }
 
-    delete [] bufTable;
+    // No read may still be going into the buffer pages
+    FinishAllReads();
+    delete pIO;
 
-#ifdef PF_STATS
-    // Destroy the global statistics manager
-    delete pStatisticsMgr;
-#endif
+    // Free up buffer pages and tables
+    UnmapFrames(0);
+    delete [] bufTable;
+    delete [] parts;
+    for (int i = 0; i < PF_BUFFER_PARTITIONS; i++)
+        delete shards[i].replacer;
+    delete [] shards;
 
 #ifdef PF_LOG
     WriteLog("Destroyed the buffer manager.\n");
@@ -173,14 +281,20 @@ PF_BufferMgr::~PF_BufferMgr()
 //       pageNum - number of the page to read
 //       bMultiplePins - if FALSE, it is an error to ask for a page that is
 //                       already pinned in the buffer.
+//       hint - SEQUENTIAL_SCAN: a hit does not count as a use of the
+//                  page, and a miss reads the page into the file's scan
+//                  ring (see AllocFor)
+//              KEEP_HOT: the page gets PF_HOT_USAGE second chances
+//              otherwise the page is used as usual
 // Out:  ppBuffer - set *ppBuffer to point to the page in the buffer
 // Ret:  PF return code
 //
 RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
-        int bMultiplePins)
+        int bMultiplePins, ClientHint hint)
 {
     RC  rc;     // return code
     int slot;   // buffer slot where page is located
+    PF_BufPartition &part = Partition(fd, pageNum);
 
 #ifdef PF_LOG
     char psMessage[100];
@@ -189,73 +303,605 @@ RC PF_BufferMgr::GetPage(int fd, PageNum pageNum, char **ppBuffer,
 #endif
 
 
-#ifdef PF_STATS
-    pStatisticsMgr->Register(PF_GETPAGE, STAT_ADDONE);
-#endif
+    PF_Count(PF_GETPAGE);
+    tracer.Record(PF_TRACE_GET, fd, pageNum);
+
+    for (;;) {
+
+        // Search for page in buffer, holding only the partition latch
+        {
+            unique_lock<mutex> lock(part.latch);
 
-    // Search for page in buffer
-    if ((rc = hashTable.Find(fd, pageNum, slot)) &&
-            (rc != PF_HASHNOTFOUND))
-        return (rc);                // unexpected error
+            if ((rc = part.hashTable.Find(fd, pageNum, slot)) &&
+                    (rc != PF_HASHNOTFOUND))
+                return (rc);                // unexpected error
 
-    // If page not in buffer...
-    if (rc == PF_HASHNOTFOUND) {
+            // Another thread is reading the page in, or writing it out to
+            // replace it.  Wait for it and look again.
+            if (!rc && bufTable[slot].bInIO) {
+                part.ioDone.wait(lock);
+                continue;
+            }
 
-#ifdef PF_STATS
-    pStatisticsMgr->Register(PF_PAGENOTFOUND, STAT_ADDONE);
+            // Page is in the buffer (and not still being read ahead)...
+            if (!rc && bufTable[slot].pPending == NULL) {
+                PF_Count(PF_PAGEFOUND);
+
+                // Error if we don't want to get a pinned page
+                if (!bMultiplePins && bufTable[slot].pinCount > 0)
+                    return (PF_PAGEPINNED);
+
+                // Page is alredy in memory, just increment pin count.  The
+                // replacer finds out about the use through the usage count.
+                bufTable[slot].pinCount++;
+                if (hint == KEEP_HOT)
+                    bufTable[slot].usage = PF_HOT_USAGE;
+                else if (hint != SEQUENTIAL_SCAN && !bufTable[slot].usage)
+                    bufTable[slot].usage = TRUE;
+#ifdef PF_LOG
+                sprintf (psMessage, "Page found in buffer.  %d pin count.\n",
+                        bufTable[slot].pinCount.load());
+                WriteLog(psMessage);
 #endif
 
-        // Allocate an empty page, this will also promote the newly allocated
-        // page to the MRU slot
-        if ((rc = InternalAlloc(slot)))
-            return (rc);
+                // Point ppBuffer to page
+                *ppBuffer = bufTable[slot].pData;
+                return (0);
+            }
+        }
+
+        // Misses hold the pool latch shared, so that they find frames in
+        // parallel
+        unique_lock<PF_PoolLatch::Shared> pool(sharedLatch);
+
+        // If the page is still being read ahead, wait for it.  It is not in
+        // the buffer any more if the read came up short.  Another thread
+        // may also have loaded the page since we looked.
+        {
+            lock_guard<mutex> lock(part.latch);
+            rc = part.hashTable.Find(fd, pageNum, slot);
+        }
+        if (!rc) {
+            lock_guard<mutex> reads(readLatch);
+            PF_PendingRead *pPending = NULL;
+            {
+                lock_guard<mutex> lock(part.latch);
+                if (!part.hashTable.Find(fd, pageNum, slot))
+                    pPending = bufTable[slot].pPending;
+            }
+            if (pPending)
+                FinishRead(pPending);
+            continue;
+        }
 
-        // read the page, insert it into the hash table,
-        // and initialize the page description entry
-        if ((rc = ReadPage(fd, pageNum, bufTable[slot].pData)) ||
-                (rc = hashTable.Insert(fd, pageNum, slot)) ||
-                (rc = InitPageDesc(fd, pageNum, slot))) {
+        PF_Count(PF_PAGENOTFOUND);
+
+        // Allocate an empty page
+        if ((rc = AllocFor(fd, pageNum, hint, slot)))
+            return (rc);
 
-            // Put the slot back on the free list before returning the error
+        // Insert the page into the hash table, pinned and marked as being
+        // read.  Another thread may have got there first.
+        {
+            PF_BufShard &shard = ShardOf(slot);
+            lock_guard<mutex> shardLock(shard.latch);
+            {
+                lock_guard<mutex> lock(part.latch);
+                if (!(rc = part.hashTable.Insert(fd, pageNum, slot))) {
+                    InitPageDesc(fd, pageNum, slot);
+                    bufTable[slot].bInIO = TRUE;
+                    if (hint == KEEP_HOT)
+                        bufTable[slot].usage = PF_HOT_USAGE;
+                }
+            }
+            if (rc) {
+                // Put the slot back on the free list
+                Unlink(slot);
+                InsertFree(slot);
+            }
+        }
+        if (rc == PF_HASHPAGEEXIST)
+            continue;
+        if (rc)
+            return (rc);
+        if (hint == SEQUENTIAL_SCAN)
+            AddToRing(fd, pageNum, slot);
+
+        // Read the page with no latch held.  The frame is pinned, so it
+        // neither moves nor is reused meanwhile.
+        char *pData = bufTable[slot].pData;
+        pool.unlock();
+        rc = ReadPage(fd, pageNum, pData);
+
+        if (rc) {
+            // Take the page out of the buffer again before returning the
+            // error.  The buffer may have been resized meanwhile, so the
+            // shard of the slot is looked up again.
+            pool.lock();
+            PF_BufShard &shard = ShardOf(slot);
+            lock_guard<mutex> shardLock(shard.latch);
+            {
+                lock_guard<mutex> lock(part.latch);
+                part.hashTable.Delete(fd, pageNum);
+                bufTable[slot].bInIO = FALSE;
+                bufTable[slot].pinCount = 0;
+            }
+            part.ioDone.notify_all();
+            shard.replacer->Remove(slot / numShards);
             Unlink(slot);
             InsertFree(slot);
             return (rc);
         }
+
+        {
+            lock_guard<mutex> lock(part.latch);
+            bufTable[slot].bInIO = FALSE;
+        }
+        part.ioDone.notify_all();
 #ifdef PF_LOG
-    WriteLog("Page not found in buffer. Loaded.\n");
+        WriteLog("Page not found in buffer. Loaded.\n");
 #endif
+
+        // Point ppBuffer to page
+        *ppBuffer = pData;
+        return (0);
     }
-    else {   // Page is in the buffer...
+}
 
-#ifdef PF_STATS
-    pStatisticsMgr->Register(PF_PAGEFOUND, STAT_ADDONE);
-#endif
+//
+// ReadAhead
+//
+// Desc: Read pages that are about to be requested into the buffer.
+//       Pages that are already in the buffer are skipped; each run of
+//       consecutive missing pages is read with a single preadv into
+//       frames obtained from InternalAlloc.  The pages are left unpinned
+//       and are handed to the replacer like any other unpinned page;
+//       GetPage asks for a page that is still being read with readLatch
+//       held and waits for the read.  Frames are not waited for: a
+//       read-ahead holds readLatch, which the flusher and the read-aheads
+//       in progress may need to free them.
+//       At most a quarter of the buffer is used, so that a read-ahead
+//       never evicts the pages of the previous one before they are used.
+//       Reading stops quietly if no frame is available or the file ends.
+//       The frames of a SEQUENTIAL_SCAN come from its scan ring.
+// In:   fd - OS file descriptor of the file to read
+//       pageNum - first page to read
+//       numPages - number of pages to read
+//       hint - how the pages will be used
+// Ret:  PF return code
+//
+RC PF_BufferMgr::ReadAhead(int fd, PageNum pageNum, int numPages,
+                           ClientHint hint)
+{
+    int  slot;
+    unique_lock<PF_PoolLatch::Shared> pool(sharedLatch);
+    lock_guard<mutex> reads(readLatch);
 
-        // Error if we don't want to get a pinned page
-        if (!bMultiplePins && bufTable[slot].pinCount > 0)
-            return (PF_PAGEPINNED);
+    // Compressed pages are read one at a time when they are needed
+    if (PageMapOf(fd))
+        return (0);
 
-        // Page is alredy in memory, just increment pin count
-        bufTable[slot].pinCount++;
-#ifdef PF_LOG
-        sprintf (psMessage, "Page found in buffer.  %d pin count.\n",
-                bufTable[slot].pinCount);
-        WriteLog(psMessage);
-#endif
+    if (numPages > this->numPages / 4)
+        numPages = this->numPages / 4;
+    if (numPages > IOV_MAX)
+        numPages = IOV_MAX;
 
-        // Make this page the most recently used page
-        if ((rc = Unlink(slot)) ||
-                (rc = LinkHead (slot)))
-            return (rc);
+    PageNum end = pageNum + numPages;
+    while (pageNum < end) {
+
+        // Skip pages that are already in the buffer
+        if (InBuffer(fd, pageNum)) {
+            pageNum++;
+            continue;
+        }
+
+        // Collect frames for the run of missing pages starting here.  The
+        // frames stay pinned until the run is complete so that they cannot
+        // be chosen as victims for the rest of the run.
+        PF_PendingRead *pRead = new PF_PendingRead;
+        pRead->req.op = PF_IORequest::READ;
+        pRead->req.fd = fd;
+        pRead->req.offset = pageNum * (off_t)pageSize + PF_FILE_HDR_SIZE;
+
+        int bNoFrame = FALSE;
+        PageNum runPage = pageNum;
+        while (runPage < end && !InBuffer(fd, runPage)) {
+            if (AllocFor(fd, runPage, hint, slot, FALSE)) {
+                bNoFrame = TRUE;
+                break;
+            }
+
+            // Another thread may have loaded the page in the meantime
+            RC rc;
+            {
+                PF_BufShard &shard = ShardOf(slot);
+                lock_guard<mutex> shardLock(shard.latch);
+                {
+                    PF_BufPartition &part = Partition(fd, runPage);
+                    lock_guard<mutex> lock(part.latch);
+                    if (!(rc = part.hashTable.Insert(fd, runPage, slot))) {
+                        InitPageDesc(fd, runPage, slot);
+                        bufTable[slot].pPending = pRead;
+                    }
+                }
+                if (rc) {
+                    Unlink(slot);
+                    InsertFree(slot);
+                }
+            }
+            if (rc) {
+                bNoFrame = TRUE;
+                break;
+            }
+            if (hint == SEQUENTIAL_SCAN)
+                AddToRing(fd, runPage, slot);
+
+            struct iovec iov;
+            iov.iov_base = bufTable[slot].pData;
+            iov.iov_len = pageSize;
+            pRead->req.iov.push_back(iov);
+            pRead->slots.push_back(slot);
+            runPage++;
+        }
+
+        if (pRead->slots.empty()) {
+            delete pRead;
+            return (0);
+        }
+
+        for (size_t i = 0; i < pRead->slots.size(); i++)
+            bufTable[pRead->slots[i]].pinCount = 0;
+
+        // Start the read.  If it cannot be started the pages are dropped
+        // again right away.
+        pendingReads.insert(pRead);
+        if (pIO->Submit(pRead->req)) {
+            pRead->req.result = -EIO;
+            pRead->req.bDone = TRUE;
+            FinishRead(pRead);
+            return (0);
+        }
+
+        // Stop when out of frames
+        if (bNoFrame)
+            return (0);
+        pageNum = runPage;
     }
 
-    // Point ppBuffer to page
-    *ppBuffer = bufTable[slot].pData;
+    return (0);
+}
 
-    // Return ok
+//
+// FinishRead
+//
+// Desc: Internal.  Wait for a read-ahead to complete.  The pages that were
+//       read become ordinary unpinned pages; the frames of pages that
+//       could not be read (end of file or error) go back to the free list.
+//       readLatch, or bufLatch exclusive, must be held.
+// In:   pRead - the read-ahead; it is deleted
+//
+void PF_BufferMgr::FinishRead(PF_PendingRead *pRead)
+{
+    pIO->Wait(pRead->req);
+
+    int numRead = pRead->req.result < 0 ? 0 :
+        (int)(pRead->req.result / pageSize);
+    PF_Count(PF_READAHEAD, numRead);
+
+    for (int i = 0; i < (int)pRead->slots.size(); i++) {
+        int slot = pRead->slots[i];
+        PF_BufPageDesc &desc = bufTable[slot];
+        PF_BufShard &shard = ShardOf(slot);
+        lock_guard<mutex> shardLock(shard.latch);
+        {
+            PF_BufPartition &part = Partition(desc.fd, desc.pageNum);
+            lock_guard<mutex> lock(part.latch);
+            desc.pPending = NULL;
+            if (i >= numRead)
+                part.hashTable.Delete(desc.fd, desc.pageNum);
+        }
+        if (i >= numRead) {
+            shard.replacer->Remove(slot / numShards);
+            Unlink(slot);
+            InsertFree(slot);
+        }
+    }
+
+    pendingReads.erase(pRead);
+    delete pRead;
+}
+
+//
+// FinishAllReads
+//
+// Desc: Internal.  Wait for every read-ahead in progress.  Called before
+//       frames are dropped or moved wholesale.  readLatch, or bufLatch
+//       exclusive, must be held.
+//
+void PF_BufferMgr::FinishAllReads()
+{
+    while (!pendingReads.empty())
+        FinishRead(*pendingReads.begin());
+}
+
+//
+// GetResidentPages
+//
+// Desc: List the pages of a file that are in the buffer, in the order in
+//       which they would be replaced.  Frames of the file's scan ring are
+//       left out: a sequential scan does not make its pages worth
+//       keeping.
+// In:   fd - the file
+// Out:  pages - page numbers, least recently used first
+//
+void PF_BufferMgr::GetResidentPages(int fd, vector<PageNum> &pages)
+{
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+
+    set<int> ring;
+    map<int, deque<pair<int, PageNum> > >::iterator it = scanRings.find(fd);
+    if (it != scanRings.end())
+        for (size_t i = 0; i < it->second.size(); i++)
+            ring.insert(it->second[i].first);
+
+    // Take the candidates of the shards in turn
+    vector<vector<int> > cands(numShards);
+    size_t numCand = 0;
+    for (int s = 0; s < numShards; s++) {
+        cands[s].resize(numPages);
+        cands[s].resize(Candidates(s, cands[s].data(), numPages));
+        numCand = max(numCand, cands[s].size());
+    }
+    pages.clear();
+    for (size_t i = 0; i < numCand; i++)
+        for (int s = 0; s < numShards; s++) {
+            if (i >= cands[s].size())
+                continue;
+            PF_BufPageDesc &desc = bufTable[cands[s][i]];
+            if (desc.fd == fd && !ring.count(cands[s][i]))
+                pages.push_back(desc.pageNum);
+        }
+}
+
+//
+// WarmUp
+//
+// Desc: Read pages of a file into the buffer without waiting for them.
+//       The pages are sorted and each run of consecutive pages is read
+//       ahead with as few requests as ReadAhead allows.  Pages already in
+//       the buffer are skipped.
+// In:   fd - the file
+//       pages - page numbers, at most the size of the buffer
+//
+void PF_BufferMgr::WarmUp(int fd, vector<PageNum> pages)
+{
+    sort(pages.begin(), pages.end());
+    pages.erase(unique(pages.begin(), pages.end()), pages.end());
+
+    // The largest read ReadAhead makes
+    int maxRun = min(GetNumPages() / 4, IOV_MAX);
+    if (maxRun < 1)
+        return;
+
+    size_t i = 0;
+    while (i < pages.size()) {
+        size_t j = i + 1;
+        while (j < pages.size() && pages[j] == pages[j - 1] + 1)
+            j++;
+        for (size_t k = i; k < j; k += maxRun)
+            ReadAhead(fd, pages[k], (int)min(j - k, (size_t)maxRun));
+        i = j;
+    }
+}
+
+//
+// GetNumPages
+//
+// Desc: Return the number of pages in the buffer
+//
+int PF_BufferMgr::GetNumPages()
+{
+    lock_guard<PF_PoolLatch::Shared> guard(sharedLatch);
+    return (numPages);
+}
+
+//
+// SetReadAhead
+//
+// Desc: Set the largest number of pages read ahead in one request
+// In:   maxPages - page limit, 0 disables read-ahead
+// Ret:  0 for success
+//
+RC PF_BufferMgr::SetReadAhead(int maxPages)
+{
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+    readAheadPages = maxPages < 0 ? 0 : maxPages;
+    return (0);
+}
+
+//
+// StartTrace
+//
+// Desc: Start writing a trace of the pages requested, allocated and
+//       marked dirty, ending the trace being written if there is one
+// In:   fileName - trace file, replaced if it exists
+// Ret:  PF_UNIX if the file cannot be written
+//
+RC PF_BufferMgr::StartTrace(const char *fileName)
+{
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+    return (tracer.Open(fileName, pageSize, numPages));
+}
+
+//
+// StopTrace
+//
+// Desc: End the trace being written, if there is one
+// Ret:  PF_UNIX if part of the trace could not be written
+//
+RC PF_BufferMgr::StopTrace()
+{
+    return (tracer.Close());
+}
+
+//
+// SetExtendChunk
+//
+// Desc: Set the disk space reserved at a time when a file grows.  The
+//       chunk is rounded down to whole pages when it is used.
+// In:   numBytes - 0 to PF_MAX_EXTEND_BYTES, 0 to grow files page by page
+// Ret:  0 for success
+//
+RC PF_BufferMgr::SetExtendChunk(int numBytes)
+{
+    extendBytes = numBytes < 0 ? 0 :
+        numBytes > PF_MAX_EXTEND_BYTES ? PF_MAX_EXTEND_BYTES : numBytes;
+    return (0);
+}
+
+//
+// SetCleanTarget
+//
+// Desc: Set how much of the buffer the background flusher looks at.
+//       Every PF_FLUSH_INTERVAL_MS (or sooner if a dirty page had to be
+//       written on replacement) the flusher writes the dirty, unpinned
+//       pages among the next percent% of the buffer in line for
+//       replacement, so that a replacement seldom has to wait for a write.
+//       The flusher thread is started the first time percent is positive.
+// In:   percent - 0 to 100, 0 stops background writes
+// Ret:  0 for success
+//
+RC PF_BufferMgr::SetCleanTarget(int percent)
+{
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+
+    if (percent < 0)
+        percent = 0;
+    if (percent > 100)
+        percent = 100;
+    cleanTarget = percent;
+
+    if (cleanTarget > 0 && !flusher.joinable()) {
+        pFlushIO = PF_IOService::Create();
+        flusher = thread(&PF_BufferMgr::FlushDaemon, this);
+    }
     return (0);
 }
 
+//
+// FlushDaemon
+//
+// Desc: Internal.  Body of the flusher thread.  The frames chosen in a
+//       round are marked bWriting and clean before bufLatch is released
+//       for the writes, so they may be pinned (and dirtied again) but
+//       not reused until the round is over.  Only pages that are not
+//       pinned when their partition latch is held are chosen, so a page
+//       whose user has marked it dirty is never marked clean before the
+//       user is done with it.  A page that could not be
+//       written is marked dirty again.  The flusher has its own
+//       PF_IOService since a service is driven by one thread only.
+//
+void PF_BufferMgr::FlushDaemon()
+{
+    unique_lock<PF_PoolLatch> lock(bufLatch);
+    vector<int> cands, slots;
+    vector<PF_IORequest> reqs;
+
+    while (!bStopFlusher) {
+        flusherWake.wait_for(lock, chrono::milliseconds(PF_FLUSH_INTERVAL_MS));
+        if (bStopFlusher || cleanTarget == 0)
+            continue;
+
+        // Pick the dirty pages among the next ones to be replaced in
+        // each shard
+        int window = (int)((long long)numPages * cleanTarget / 100 /
+                           numShards);
+        if (window < 1)
+            window = 1;
+        cands.resize(window);
+        slots.clear();
+        for (int s = 0; s < numShards; s++) {
+            int numCand = Candidates(s, cands.data(), window);
+            for (int i = 0; i < numCand; i++) {
+                PF_BufPageDesc &desc = bufTable[cands[i]];
+                if (desc.bWriting || desc.fd < 0 || desc.pPending != NULL ||
+                        PageMapOf(desc.fd))
+                    continue;
+                lock_guard<mutex> lock(Partition(desc.fd, desc.pageNum).latch);
+                if (desc.bDirty && desc.pinCount == 0 && !desc.bInIO) {
+                    desc.bWriting = TRUE;
+                    desc.bDirty = FALSE;
+                    slots.push_back(cands[i]);
+                }
+            }
+        }
+        int numDirty = (int)slots.size();
+        if (numDirty == 0)
+            continue;
+
+        reqs.assign(numDirty, PF_IORequest());
+        for (int i = 0; i < numDirty; i++) {
+            PF_BufPageDesc &desc = bufTable[slots[i]];
+            struct iovec iov = { desc.pData, (size_t)pageSize };
+            reqs[i].op = PF_IORequest::WRITE;
+            reqs[i].fd = desc.fd;
+            reqs[i].offset = desc.pageNum * (off_t)pageSize + PF_FILE_HDR_SIZE;
+            reqs[i].iov.push_back(iov);
+        }
+        numWriting += numDirty;
+
+        // Write without holding the latch
+        lock.unlock();
+        for (int i = 0; i < numDirty; i++)
+            if (pFlushIO->Submit(reqs[i])) {
+                reqs[i].result = -EIO;
+                reqs[i].bDone = TRUE;
+            }
+        for (int i = 0; i < numDirty; i++)
+            pFlushIO->Wait(reqs[i]);
+        lock.lock();
+
+        for (int i = 0; i < numDirty; i++) {
+            bufTable[slots[i]].bWriting = FALSE;
+            if (reqs[i].result != pageSize)
+                bufTable[slots[i]].bDirty = TRUE;
+            else
+                flushedPages++;
+        }
+        numWriting -= numDirty;
+        flushRounds++;
+        writeDone.notify_all();
+    }
+}
+
+//
+// WaitAllWrites
+//
+// Desc: Internal.  Wait until the flusher is not writing any page.
+//       Called before frames are dropped or moved wholesale, with bufLatch
+//       held exclusive; it is released while waiting.
+//
+void PF_BufferMgr::WaitAllWrites()
+{
+    while (numWriting > 0)
+        writeDone.wait(bufLatch);
+}
+
+//
+// Quiesce
+//
+// Desc: Internal.  Wait until no read-ahead and no flusher write is in
+//       progress.  Waiting for writes releases bufLatch, during which a
+//       new read-ahead may start, hence the loop.
+//
+void PF_BufferMgr::Quiesce()
+{
+    do {
+        FinishAllReads();
+        WaitAllWrites();
+    } while (!pendingReads.empty());
+}
+
 //
 // AllocatePage
 //
@@ -269,6 +915,7 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
 {
     RC  rc;     // return code
     int slot;   // buffer slot where page is located
+    lock_guard<PF_PoolLatch::Shared> guard(sharedLatch);
 
 #ifdef PF_LOG
     char psMessage[100];
@@ -276,26 +923,36 @@ RC PF_BufferMgr::AllocatePage(int fd, PageNum pageNum, char **ppBuffer)
     WriteLog(psMessage);
 #endif
 
+    tracer.Record(PF_TRACE_ALLOC, fd, pageNum);
+
     // If page is already in buffer, return an error
-    if (!(rc = hashTable.Find(fd, pageNum, slot)))
+    if (InBuffer(fd, pageNum))
         return (PF_PAGEINBUF);
-    else if (rc != PF_HASHNOTFOUND)
-        return (rc);              // unexpected error
 
     // Allocate an empty page
-    if ((rc = InternalAlloc(slot)))
+    if ((rc = InternalAlloc(slot, HomeShard(fd, pageNum))))
         return (rc);
 
     // Insert the page into the hash table,
     // and initialize the page description entry
-    if ((rc = hashTable.Insert(fd, pageNum, slot)) ||
-            (rc = InitPageDesc(fd, pageNum, slot))) {
-
-        // Put the slot back on the free list before returning the error
-        Unlink(slot);
-        InsertFree(slot);
-        return (rc);
+    {
+        PF_BufShard &shard = ShardOf(slot);
+        lock_guard<mutex> shardLock(shard.latch);
+        {
+            PF_BufPartition &part = Partition(fd, pageNum);
+            lock_guard<mutex> lock(part.latch);
+            if (!(rc = part.hashTable.Insert(fd, pageNum, slot)))
+                rc = InitPageDesc(fd, pageNum, slot);
+        }
+        if (rc) {
+            // Put the slot back on the free list before returning the
+            // error.  Another thread may have loaded the page meanwhile.
+            Unlink(slot);
+            InsertFree(slot);
+        }
     }
+    if (rc)
+        return (rc == PF_HASHPAGEEXIST ? PF_PAGEINBUF : rc);
 
 #ifdef PF_LOG
     WriteLog("Succesfully allocated page.\n");
@@ -321,6 +978,8 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
 {
     RC  rc;       // return code
     int slot;     // buffer slot where page is located
+    PF_BufPartition &part = Partition(fd, pageNum);
+    lock_guard<mutex> guard(part.latch);
 
 #ifdef PF_LOG
     char psMessage[100];
@@ -328,8 +987,10 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
     WriteLog(psMessage);
 #endif
 
+    tracer.Record(PF_TRACE_DIRTY, fd, pageNum);
+
     // The page must be found and pinned in the buffer
-    if ((rc = hashTable.Find(fd, pageNum, slot))){
+    if ((rc = part.hashTable.Find(fd, pageNum, slot))){
         if (rc == PF_HASHNOTFOUND)
             return (PF_PAGENOTINBUF);
         else
@@ -342,11 +1003,6 @@ RC PF_BufferMgr::MarkDirty(int fd, PageNum pageNum)
     // Mark this page dirty
     bufTable[slot].bDirty = TRUE;
 
-    // Make this page the most recently used page
-    if ((rc = Unlink(slot)) ||
-            (rc = LinkHead (slot)))
-        return (rc);
-
     // Return ok
     return (0);
 }
@@ -363,9 +1019,11 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
 {
     RC  rc;       // return code
     int slot;     // buffer slot where page is located
+    PF_BufPartition &part = Partition(fd, pageNum);
+    lock_guard<mutex> guard(part.latch);
 
     // The page must be found and pinned in the buffer
-    if ((rc = hashTable.Find(fd, pageNum, slot))){
+    if ((rc = part.hashTable.Find(fd, pageNum, slot))){
         if (rc == PF_HASHNOTFOUND)
             return (PF_PAGENOTINBUF);
         else
@@ -382,30 +1040,74 @@ RC PF_BufferMgr::UnpinPage(int fd, PageNum pageNum)
     WriteLog(psMessage);
 #endif
 
-    // If unpinning the last pin, make it the most recently used page
-    if (--(bufTable[slot].pinCount) == 0) {
-        if ((rc = Unlink(slot)) ||
-                (rc = LinkHead (slot)))
-            return (rc);
-    }
+    // Once the last pin is gone the page may be replaced
+    bufTable[slot].pinCount--;
 
     // Return ok
     return (0);
 }
 
+//
+// KeepResident
+//
+// Desc: Pin a page, as KEEP_HOT, on behalf of the file rather than of a
+//       single access, so that it stays in the buffer until
+//       ReleaseResident.  Resident pages may take up at most half of the
+//       buffer, so that the other pages can still be replaced.
+// In:   fd - file descriptor
+//       pageNum - page number
+// Ret:  PF_TOOMANYRESIDENT if half of the buffer is resident already,
+//       other PF return code (see GetPage)
+//
+RC PF_BufferMgr::KeepResident(int fd, PageNum pageNum)
+{
+    RC   rc;
+    char *pData;
+
+    {
+        lock_guard<PF_PoolLatch::Shared> guard(sharedLatch);
+        if (numResident >= numPages / 2)
+            return (PF_TOOMANYRESIDENT);
+        numResident++;
+    }
+
+    if ((rc = GetPage(fd, pageNum, &pData, TRUE, KEEP_HOT)))
+        numResident--;
+    return (rc);
+}
+
+//
+// ReleaseResident
+//
+// Desc: Drop the pin taken by KeepResident
+// In:   fd - file descriptor
+//       pageNum - page number
+// Ret:  PF return code (see UnpinPage)
+//
+RC PF_BufferMgr::ReleaseResident(int fd, PageNum pageNum)
+{
+    RC rc;
+
+    if ((rc = UnpinPage(fd, pageNum)))
+        return (rc);
+    numResident--;
+    return (0);
+}
+
 //
 // FlushPages
 //
 // Desc: Release all pages for this file and put them onto the free list
 //       Returns a warning if any of the file's pages are pinned.
-//       A linear search of the buffer is performed.
-//       A better method is not needed because # of buffers are small.
+//       A linear search of the buffer is performed.  The dirty pages
+//       are written first, in page order (see WritePages).
 // In:   fd - file descriptor
 // Ret:  PF_PAGEPINNED or other PF return code
 //
 RC PF_BufferMgr::FlushPages(int fd)
 {
     RC rc, rcWarn = 0;  // return codes
+    lock_guard<PF_PoolLatch> guard(bufLatch);
 
 #ifdef PF_LOG
     char psMessage[100];
@@ -413,15 +1115,26 @@ RC PF_BufferMgr::FlushPages(int fd)
     WriteLog(psMessage);
 #endif
 
-#ifdef PF_STATS
-    pStatisticsMgr->Register(PF_FLUSHPAGES, STAT_ADDONE);
-#endif
+    PF_Count(PF_FLUSHPAGES);
+    tracer.Record(PF_TRACE_DROP, fd, 0);
+
+    Quiesce();
+    scanRings.erase(fd);
+
+    // Write the file's dirty, unpinned pages
+    vector<int> used, dirty;
+    GetUsedSlots(used);
+    for (size_t i = 0; i < used.size(); i++)
+        if (bufTable[used[i]].fd == fd && bufTable[used[i]].bDirty &&
+                bufTable[used[i]].pinCount == 0)
+            dirty.push_back(used[i]);
+    if ((rc = WritePages(dirty)))
+        return (rc);
 
     // Do a linear scan of the buffer to find pages belonging to the file
-    int slot = first;
-    while (slot != INVALID_SLOT) {
+    for (size_t i = 0; i < used.size(); i++) {
 
-        int next = bufTable[slot].next;
+        int slot = used[i];
 
         // If the page belongs to the passed-in file descriptor
         if (bufTable[slot].fd == fd) {
@@ -430,30 +1143,24 @@ RC PF_BufferMgr::FlushPages(int fd)
  sprintf (psMessage, "Page (%d) is in buffer manager.\n", bufTable[slot].pageNum);
  WriteLog(psMessage);
 #endif
-            // Ensure the page is not pinned
-            if (bufTable[slot].pinCount) {
+            // Ensure the page is not pinned (nor was used again after it
+            // was written)
+            PF_BufPartition &part = Partition(fd, bufTable[slot].pageNum);
+            unique_lock<mutex> lock(part.latch);
+            if (bufTable[slot].pinCount || bufTable[slot].bDirty) {
                 rcWarn = PF_PAGEPINNED;
             }
             else {
-                // Write the page if dirty
-                if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-                    if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-                        return (rc);
-                    bufTable[slot].bDirty = FALSE;
-                }
-
                 // Remove page from the hash table and add the slot to the free list
-                if ((rc = hashTable.Delete(fd, bufTable[slot].pageNum)) ||
-                        (rc = Unlink(slot)) ||
+                if ((rc = part.hashTable.Delete(fd, bufTable[slot].pageNum)))
+                    return (rc);
+                lock.unlock();
+                ShardOf(slot).replacer->Remove(slot / numShards);
+                if ((rc = Unlink(slot)) ||
                         (rc = InsertFree(slot)))
                     return (rc);
             }
         }
-        slot = next;
     }
 
 #ifdef PF_LOG
@@ -469,6 +1176,8 @@ RC PF_BufferMgr::FlushPages(int fd)
 //
 // Desc: If a page is dirty then force the page from the buffer pool
 //       onto disk.  The page will not be forced out of the buffer pool.
+//       When all pages are forced they are written in page order (see
+//       WritePages).
 // In:   The page number, a default value of ALL_PAGES will be used if
 //       the client doesn't provide a value.  This will force all pages.
 // Ret:  Standard PF errors
@@ -477,6 +1186,7 @@ RC PF_BufferMgr::FlushPages(int fd)
 RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
 {
     RC rc;  // return codes
+    lock_guard<PF_PoolLatch> guard(bufLatch);
 
 #ifdef PF_LOG
     char psMessage[100];
@@ -484,36 +1194,143 @@ RC PF_BufferMgr::ForcePages(int fd, PageNum pageNum)
     WriteLog(psMessage);
 #endif
 
-    // Do a linear scan of the buffer to find the page for the file
-    int slot = first;
-    while (slot != INVALID_SLOT) {
+    // Pages the flusher is writing must be on disk before we return
+    WaitAllWrites();
 
-        int next = bufTable[slot].next;
+    // Do a linear scan of the buffer to find the dirty pages for the file.
+    // I don't care if a page is pinned or not, just write it if it is
+    // dirty.
+    vector<int> used, dirty;
+    GetUsedSlots(used);
+    for (size_t i = 0; i < used.size(); i++)
+        if (bufTable[used[i]].fd == fd && bufTable[used[i]].bDirty &&
+                (pageNum==ALL_PAGES || bufTable[used[i]].pageNum == pageNum))
+            dirty.push_back(used[i]);
 
-        // If the page belongs to the passed-in file descriptor
-        if (bufTable[slot].fd == fd &&
-                (pageNum==ALL_PAGES || bufTable[slot].pageNum == pageNum)) {
+    if ((rc = WritePages(dirty, TRUE)))
+        return (rc);
+
+    return 0;
+}
+
+//
+// WritePages
+//
+// Desc: Internal.  Write the pages in the given slots and mark them clean.
+//       The pages are sorted by file and page number and each run of
+//       consecutive pages goes out with a single pwritev, so that writing
+//       back many pages costs sequential bandwidth rather than one seek
+//       per page.  All runs are submitted before the first is waited for.
+//       The pages are marked clean before they are written, so that a
+//       page dirtied again meanwhile stays dirty.  Pages of compressed
+//       files are written one at a time by WriteCompressed.
+// In:   slots - slots holding dirty pages of files (not memory blocks);
+//               the vector is sorted in place and loses the pages that
+//               are not written
+//       bPinnedToo - also write pages that are pinned.  Otherwise a page
+//                    that was pinned since it was chosen is left alone,
+//                    as its user may be changing it.
+// Ret:  PF return code of the first run that failed.  Pages of failed
+//       runs stay dirty.
+//
+RC PF_BufferMgr::WritePages(vector<int> &slots, int bPinnedToo)
+{
+    RC rc = 0;
+
+    size_t numTaken = 0;
+    for (size_t i = 0; i < slots.size(); i++) {
+        PF_BufPageDesc &desc = bufTable[slots[i]];
+        lock_guard<mutex> lock(Partition(desc.fd, desc.pageNum).latch);
+        if (desc.bDirty && (bPinnedToo || desc.pinCount == 0)) {
+            desc.bDirty = FALSE;
+            slots[numTaken++] = slots[i];
+        }
+    }
+    slots.resize(numTaken);
+
+    if (slots.empty())
+        return (0);
+
+    PF_Count(PF_WRITEPAGE, slots.size());
+
+    // Pages of compressed files are written one by one
+    numTaken = 0;
+    for (size_t i = 0; i < slots.size(); i++) {
+        PF_BufPageDesc &desc = bufTable[slots[i]];
+        PF_PageMap *pPageMap = PageMapOf(desc.fd);
+        if (pPageMap == NULL) {
+            slots[numTaken++] = slots[i];
+            continue;
+        }
+        RC rcWrite = WriteCompressed(pPageMap, desc.fd, desc.pageNum,
+                                     desc.pData);
+        if (rcWrite) {
+            desc.bDirty = TRUE;
+            if (!rc)
+                rc = rcWrite;
+        }
+    }
+    slots.resize(numTaken);
+
+    sort(slots.begin(), slots.end(), [this](int a, int b) {
+        return bufTable[a].fd < bufTable[b].fd ||
+            (bufTable[a].fd == bufTable[b].fd &&
+             bufTable[a].pageNum < bufTable[b].pageNum);
+    });
+
+    // Split the slots into runs of consecutive pages.  runStart[i] is
+    // the index in slots of the first page of run i.
+    vector<PF_IORequest> reqs;
+    vector<size_t> runStart;
+    for (size_t i = 0; i < slots.size(); i++) {
+        PF_BufPageDesc &desc = bufTable[slots[i]];
+        if (i == 0 || reqs.back().iov.size() >= IOV_MAX ||
+                desc.fd != bufTable[slots[i - 1]].fd ||
+                desc.pageNum != bufTable[slots[i - 1]].pageNum + 1) {
+            reqs.push_back(PF_IORequest());
+            reqs.back().op = PF_IORequest::WRITE;
+            reqs.back().fd = desc.fd;
+            reqs.back().offset =
+                desc.pageNum * (off_t)pageSize + PF_FILE_HDR_SIZE;
+            runStart.push_back(i);
+        }
+        struct iovec iov = { desc.pData, (size_t)pageSize };
+        reqs.back().iov.push_back(iov);
 
 #ifdef PF_LOG
- sprintf (psMessage, "Page (%d) is in buffer pool.\n", bufTable[slot].pageNum);
- WriteLog(psMessage);
-#endif
-            // I don't care if the page is pinned or not, just write it if
-            // it is dirty.
-            if (bufTable[slot].bDirty) {
-#ifdef PF_LOG
-sprintf (psMessage, "Page (%d) is dirty\n",bufTable[slot].pageNum);
-WriteLog(psMessage);
+        char psMessage[100];
+        sprintf (psMessage, "Writing (%d,%d).\n", desc.fd, desc.pageNum);
+        WriteLog(psMessage);
 #endif
-                if ((rc = WritePage(fd, bufTable[slot].pageNum, bufTable[slot].pData)))
-                    return (rc);
-                bufTable[slot].bDirty = FALSE;
+    }
+    runStart.push_back(slots.size());
+
+    for (size_t r = 0; r < reqs.size(); r++)
+        if (pIO->Submit(reqs[r])) {
+            reqs[r].result = -EIO;
+            reqs[r].bDone = TRUE;
+        }
+
+    for (size_t r = 0; r < reqs.size(); r++) {
+        pIO->Wait(reqs[r]);
+
+        ssize_t numBytes = reqs[r].result;
+        if (numBytes == (ssize_t)(reqs[r].iov.size() * pageSize))
+            continue;
+
+        for (size_t i = runStart[r]; i < runStart[r + 1]; i++)
+            bufTable[slots[i]].bDirty = TRUE;
+        if (!rc) {
+            if (numBytes < 0) {
+                errno = -numBytes;
+                rc = PF_UNIX;
             }
+            else
+                rc = PF_INCOMPLETEWRITE;
         }
-        slot = next;
     }
 
-    return 0;
+    return (rc);
 }
 
 
@@ -528,24 +1345,47 @@ WriteLog(psMessage);
 //
 RC PF_BufferMgr::PrintBuffer()
 {
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+
     cout << "Buffer contains " << numPages << " pages of size "
         << pageSize <<".\n";
-    cout << "Contents in order from most recently used to "
-        << "least recently used.\n";
-
-    int slot, next;
-    slot = first;
-    while (slot != INVALID_SLOT) {
-        next = bufTable[slot].next;
+    cout << "Replacement policy is " << shards[0].replacer->Name()
+        << ", in " << numShards << " shard(s).\n";
+    if (cleanTarget > 0)
+        cout << "Background flusher keeps " << cleanTarget
+            << "% of the replacement candidates clean.\n";
+    cout << flushedPages << " pages written in the background in "
+        << flushRounds << " rounds, " << dirtyEvictions
+        << " dirty pages written on replacement.\n";
+    cout << "Sequential scans recycle " << scanRingPages
+        << " frames per file, " << ringReuses << " frames reused.\n";
+    cout << numResident << " pages are kept resident.\n";
+    long long numGets = PF_GetCounter(PF_GETPAGE);
+    if (numGets > 0)
+        cout << numGets << " calls to GetPage, "
+            << (PF_GetCounter(PF_PAGEFOUND) * 100 / numGets)
+            << "% found in the buffer.\n";
+    PF_PrintLatency(PF_READLATENCY);
+    PF_PrintLatency(PF_WRITELATENCY);
+    if (compPageBytes > 0)
+        cout << "Compressed pages written take " << compStoredBytes
+            << " bytes for " << compPageBytes << " ("
+            << (compStoredBytes * 100 / compPageBytes) << "%).\n";
+    cout << "Contents of each shard in order from most recently loaded to "
+        << "least recently loaded.\n";
+
+    vector<int> used;
+    GetUsedSlots(used);
+    for (size_t i = 0; i < used.size(); i++) {
+        int slot = used[i];
         cout << slot << " :: \n";
         cout << "  fd = " << bufTable[slot].fd << "\n";
         cout << "  pageNum = " << bufTable[slot].pageNum << "\n";
         cout << "  bDirty = " << bufTable[slot].bDirty << "\n";
         cout << "  pinCount = " << bufTable[slot].pinCount << "\n";
-        slot = next;
     }
 
-    if (first==INVALID_SLOT)
+    if (used.empty())
         cout << "Buffer is empty!\n";
     else
         cout << "All remaining slots are free.\n";
@@ -560,7 +1400,8 @@ RC PF_BufferMgr::PrintBuffer()
 // Desc: Remove all entries from the buffer manager.
 //       This routine will be called via the system command and is only
 //       really useful if the user wants to run some performance
-//       comparison starting with an clean buffer.
+//       comparison starting with an clean buffer.  Dirty pages are
+//       written out before they are dropped.
 // In:   Nothing
 // Out:  Nothing
 // Ret:  Will return an error if a page is pinned and the Clear routine
@@ -568,132 +1409,581 @@ RC PF_BufferMgr::PrintBuffer()
 RC PF_BufferMgr::ClearBuffer()
 {
     RC rc;
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+
+    Quiesce();
+    scanRings.clear();
+    tracer.Record(PF_TRACE_DROP, -1, 0);
+
+    vector<int> used, dirty;
+    GetUsedSlots(used);
+    for (size_t i = 0; i < used.size(); i++)
+        if (bufTable[used[i]].pinCount == 0 && bufTable[used[i]].bDirty &&
+                bufTable[used[i]].fd >= 0)
+            dirty.push_back(used[i]);
+    if ((rc = WritePages(dirty)))
+        return (rc);
 
-    int slot, next;
-    slot = first;
-    while (slot != INVALID_SLOT) {
-        next = bufTable[slot].next;
-        if (bufTable[slot].pinCount == 0)
-            if ((rc = hashTable.Delete(bufTable[slot].fd,
-                    bufTable[slot].pageNum)) ||
-                (rc = Unlink(slot)) ||
+    for (size_t i = 0; i < used.size(); i++) {
+        int slot = used[i];
+        PF_BufPartition &part =
+            Partition(bufTable[slot].fd, bufTable[slot].pageNum);
+        unique_lock<mutex> lock(part.latch);
+        if (bufTable[slot].pinCount == 0 && !bufTable[slot].bDirty) {
+            if ((rc = part.hashTable.Delete(bufTable[slot].fd,
+                    bufTable[slot].pageNum)))
+                return (rc);
+            lock.unlock();
+            ShardOf(slot).replacer->Remove(slot / numShards);
+            if ((rc = Unlink(slot)) ||
                 (rc = InsertFree(slot)))
-            return (rc);
-        slot = next;
+                return (rc);
+        }
     }
 
     return 0;
 }
 
+//
+// SetPageSize
+//
+// Desc: Switch the buffer to pages of pageSize bytes (page header
+//       included).  Dirty pages are written out and all pages dropped,
+//       then the frames are mapped again with the new size; the number
+//       of pages in the buffer stays the same.
+// In:   pageSize - new page size, checked by PF_Manager::SetPageSize
+// Ret:  PF_PAGEPINNED if a page is pinned (nothing changes), or some
+//       other PF error
+//
+RC PF_BufferMgr::SetPageSize(int newPageSize)
+{
+    RC rc;
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+
+    if (newPageSize == pageSize)
+        return (0);
+
+    Quiesce();
+
+    vector<int> used, dirty;
+    GetUsedSlots(used);
+    for (size_t i = 0; i < used.size(); i++) {
+        if (bufTable[used[i]].pinCount > 0)
+            return (PF_PAGEPINNED);
+        if (bufTable[used[i]].bDirty)
+            dirty.push_back(used[i]);
+    }
+    if ((rc = WritePages(dirty)))
+        return (rc);
+
+    // A hit pins a page holding only its partition latch.  Hold them all
+    // while looking at the pages again and dropping them, so that no
+    // client gets a pointer into frames about to be unmapped.
+    vector<unique_lock<mutex> > latches;
+    latches.reserve(PF_BUFFER_PARTITIONS);
+    for (int i = 0; i < PF_BUFFER_PARTITIONS; i++)
+        latches.push_back(unique_lock<mutex>(parts[i].latch));
+
+    for (size_t i = 0; i < used.size(); i++) {
+        int slot = used[i];
+        if (bufTable[slot].pinCount > 0)
+            return (PF_PAGEPINNED);
+        // Dirtied again since it was written above
+        if (bufTable[slot].bDirty &&
+                (rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
+                                bufTable[slot].pData)))
+            return (rc);
+        bufTable[slot].bDirty = FALSE;
+    }
+
+    scanRings.clear();
+    tracer.Record(PF_TRACE_DROP, -1, 0);
+    for (size_t i = 0; i < used.size(); i++) {
+        int slot = used[i];
+        PF_HashTable &hashTable =
+            Partition(bufTable[slot].fd, bufTable[slot].pageNum).hashTable;
+        if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)))
+            return (rc);
+        ShardOf(slot).replacer->Remove(slot / numShards);
+        if ((rc = Unlink(slot)) ||
+            (rc = InsertFree(slot)))
+            return (rc);
+    }
+
+    UnmapFrames(0);
+    pageSize = newPageSize;
+    MapFrames(0, numPages);
+
+    return (0);
+}
+
+//
+// GetPageSize
+//
+// Desc: Return the size of the pages in the buffer, page header included
+//
+int PF_BufferMgr::GetPageSize()
+{
+    lock_guard<PF_PoolLatch::Shared> guard(sharedLatch);
+    return (pageSize);
+}
+
 //
 // ResizeBuffer
 //
 // Desc: Resizes the buffer manager to the size passed in.
 //       This routine will be called via the system command.
+//       Resident pages stay in the buffer: growing only adds free slots,
+//       and shrinking moves the unpinned pages held in the slots that go
+//       away into free slots that remain.  Only when there is no room
+//       left are pages evicted.  The dirty pages to evict are written
+//       first, in one call to WritePages, before the partition latches
+//       are taken; then all partition latches are held while pages move
+//       and the descriptor table is replaced.  The slots are then dealt
+//       out to the shards for the new size (see RebuildShards).
+//       If no page is pinned afterwards, the frames are moved into a
+//       single arena extent.
 // In:   The new buffer size
 // Out:  Nothing
 // Ret:  0 for success or,
-//       Some other PF error (probably PF_NOBUF)
-//
-// Notes: This method attempts to copy all the old pages which I am
-// unable to kick out of the old buffer manager into the new buffer
-// manager.  This obviously cannot always be successfull!
+//       PF_TOOSMALL if iNewSize is not positive or a pinned page lives in
+//       a slot that would go away (the buffer is left unchanged), or
+//       some other PF error
 //
 RC PF_BufferMgr::ResizeBuffer(int iNewSize)
 {
-    int i;
     RC rc;
+    int slot;
+    lock_guard<PF_PoolLatch> guard(bufLatch);
 
-    // First try and clear out the old buffer!
-    ClearBuffer();
-
-    // Allocate memory for a new buffer table
-    PF_BufPageDesc *pNewBufTable = new PF_BufPageDesc[iNewSize];
+    if (iNewSize <= 0)
+        return (PF_TOOSMALL);
+    if (iNewSize == numPages)
+        return (0);
 
-    // Initialize the new buffer table and allocate memory for buffer
-    // pages.  Initially, the free list contains all pages
-    for (i = 0; i < iNewSize; i++) {
-        if ((pNewBufTable[i].pData = new char[pageSize]) == NULL) {
-            cerr << "Not enough memory for buffer\n";
-            exit(1);
+    Quiesce();
+    scanRings.clear();
+
+    // Write the dirty pages that will be evicted while hits can still go
+    // on.  Holding bufLatch keeps the lists as they are, so the pages
+    // evicted below are the ones chosen here.
+    vector<int> used, room;
+    GetUsedSlots(used);
+    for (int s = 0; s < numShards; s++)
+        for (slot = shards[s].free; slot != INVALID_SLOT;
+                slot = bufTable[slot].next)
+            if (slot < iNewSize)
+                room.push_back(slot);
+    if (iNewSize < numPages) {
+        size_t numRoom = room.size();
+        vector<int> dirty;
+        for (size_t i = 0; i < used.size(); i++) {
+            if (used[i] < iNewSize)
+                continue;
+            if (numRoom > 0)
+                numRoom--;
+            else if (bufTable[used[i]].bDirty)
+                dirty.push_back(used[i]);
         }
+        if ((rc = WritePages(dirty)))
+            return (rc);
+    }
 
-        memset ((void *)pNewBufTable[i].pData, 0, pageSize);
+    vector<unique_lock<mutex> > latches;
+    latches.reserve(PF_BUFFER_PARTITIONS);
+    for (int i = 0; i < PF_BUFFER_PARTITIONS; i++)
+        latches.push_back(unique_lock<mutex>(parts[i].latch));
+
+    if (iNewSize < numPages) {
+        // Pinned pages cannot move since clients hold pointers to them
+        for (slot = iNewSize; slot < numPages; slot++)
+            if (bufTable[slot].pinCount > 0)
+                return (PF_TOOSMALL);
+
+        // Move or evict the pages held in the slots that go away, moving
+        // them into the free slots that survive.  The free lists and the
+        // replacers are rebuilt below.
+        for (size_t i = 0; i < used.size(); i++) {
+            slot = used[i];
+            if (slot < iNewSize)
+                continue;
+
+            PF_HashTable &hashTable =
+                Partition(bufTable[slot].fd, bufTable[slot].pageNum).hashTable;
+            if ((rc = hashTable.Delete(bufTable[slot].fd,
+                    bufTable[slot].pageNum)))
+                return (rc);
 
-        pNewBufTable[i].prev = i - 1;
-        pNewBufTable[i].next = i + 1;
+            if (!room.empty()) {
+                int newSlot = room.back();
+                room.pop_back();
+
+                memcpy(bufTable[newSlot].pData, bufTable[slot].pData,
+                       pageSize);
+                bufTable[newSlot].fd       = bufTable[slot].fd;
+                bufTable[newSlot].pageNum  = bufTable[slot].pageNum;
+                bufTable[newSlot].bDirty   = bufTable[slot].bDirty.load();
+                bufTable[newSlot].pinCount = 0;
+                bufTable[newSlot].usage = FALSE;
+                bufTable[newSlot].bInIO = FALSE;
+                bufTable[newSlot].pPending = NULL;
+                bufTable[newSlot].bWriting = FALSE;
+                if ((rc = hashTable.Insert(bufTable[newSlot].fd,
+                        bufTable[newSlot].pageNum, newSlot)))
+                    return (rc);
+                ReplaceLink(slot, newSlot);
+            }
+            else {
+                // Dirtied again since it was written above
+                if (bufTable[slot].bDirty &&
+                        (rc = WritePage(bufTable[slot].fd,
+                        bufTable[slot].pageNum, bufTable[slot].pData)))
+                    return (rc);
+                Unlink(slot);
+            }
+        }
+
+        UnmapFrames(iNewSize);
     }
-    pNewBufTable[0].prev = pNewBufTable[iNewSize - 1].next = INVALID_SLOT;
 
-    // Now we must remember the old first and last slots and (of course)
-    // the buffer table itself.  Then we use insert methods to insert
-    // each of the entries into the new buffertable
-    int oldFirst = first;
-    PF_BufPageDesc *pOldBufTable = bufTable;
+    // Move the descriptors into a table of the new size.  Page contents
+    // are not copied.
+    PF_BufPageDesc *pNewBufTable = new PF_BufPageDesc[iNewSize];
+    int numCopied = iNewSize < numPages ? iNewSize : numPages;
+    for (slot = 0; slot < numCopied; slot++)
+        pNewBufTable[slot] = bufTable[slot];
+    delete [] bufTable;
+    bufTable = pNewBufTable;
+
+    // New slots are free
+    if (iNewSize > numCopied)
+        MapFrames(numCopied, iNewSize - numCopied);
+    for (slot = iNewSize - 1; slot >= numCopied; slot--) {
+        bufTable[slot].bDirty = FALSE;
+        bufTable[slot].pinCount = 0;
+        bufTable[slot].usage = FALSE;
+        bufTable[slot].bInIO = FALSE;
+        bufTable[slot].pPending = NULL;
+        bufTable[slot].bWriting = FALSE;
+    }
 
-    // Setup the new number of pages,  first, last and free
     numPages = iNewSize;
-    first = last = INVALID_SLOT;
-    free = 0;
+    scanRingPages = RingSize(numPages);
+    for (int i = 0; i < PF_BUFFER_PARTITIONS; i++)
+        if ((rc = parts[i].hashTable.Resize(numPages / PF_BUFFER_PARTITIONS + 1)))
+            return (rc);
+    RebuildShards();
 
-    // Setup the new buffer table
-    bufTable = pNewBufTable;
+    // Merge the arena if nothing points into it
+    if (arena.size() > 1) {
+        for (slot = 0; slot < numPages; slot++)
+            if (bufTable[slot].pinCount > 0)
+                break;
+        if (slot == numPages)
+            CompactArena();
+    }
 
-    // We must first remove from the hashtable any possible entries
-    int slot, next, newSlot;
-    slot = oldFirst;
-    while (slot != INVALID_SLOT) {
-        next = pOldBufTable[slot].next;
+    return 0;
+}
 
-        // Must remove the entry from the hashtable from the
-        if ((rc=hashTable.Delete(pOldBufTable[slot].fd, pOldBufTable[slot].pageNum)))
-            return (rc);
-        slot = next;
+//
+// SetHugePages
+//
+// Desc: Advise the kernel to back the arena with (transparent) huge
+//       pages, or not to.  Applies to the current arena right away; an
+//       arena mapped later is also aligned to PF_HUGE_PAGE_SIZE.
+// In:   bHuge - TRUE to use huge pages
+// Ret:  0 for success
+//
+RC PF_BufferMgr::SetHugePages(int bHuge)
+{
+    lock_guard<PF_PoolLatch> guard(bufLatch);
+
+    bHugePages = bHuge;
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+    for (size_t i = 0; i < arena.size(); i++)
+        madvise(arena[i].pBase, arena[i].length,
+                bHugePages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+    return (0);
+}
+
+//
+// MapFrames
+//
+// Desc: Internal.  Map a new arena extent for numSlots frames starting at
+//       firstSlot and point their descriptors at it.  The memory is
+//       page-aligned (huge-page aligned if huge pages were asked for) and
+//       zero-filled.  Exits if the memory cannot be had, as running out
+//       of buffer memory always has.
+//
+void PF_BufferMgr::MapFrames(int firstSlot, int numSlots)
+{
+    size_t sysPageSize = sysconf(_SC_PAGESIZE);
+    size_t align = bHugePages ? PF_HUGE_PAGE_SIZE : sysPageSize;
+    size_t length = (size_t)numSlots * pageSize;
+    length = (length + sysPageSize - 1) / sysPageSize * sysPageSize;
+
+    // Map extra room for the alignment, then trim it off
+    size_t extra = align > sysPageSize ? align : 0;
+    char *pMap = (char *)mmap(NULL, length + extra, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pMap == (char *)MAP_FAILED) {
+        cerr << "Not enough memory for buffer\n";
+        exit(1);
     }
+    if (extra) {
+        size_t head = (align - (size_t)pMap % align) % align;
+        if (head)
+            munmap(pMap, head);
+        if (extra - head)
+            munmap(pMap + head + length, extra - head);
+        pMap += head;
+    }
+#ifdef MADV_HUGEPAGE
+    if (bHugePages)
+        madvise(pMap, length, MADV_HUGEPAGE);
+#endif
 
-    // Now we traverse through the old buffer table and copy any old
-    // entries into the new one
-    slot = oldFirst;
-    while (slot != INVALID_SLOT) {
+    PF_ArenaExtent ext = { pMap, length, firstSlot, numSlots };
+    arena.push_back(ext);
+    for (int i = 0; i < numSlots; i++)
+        bufTable[firstSlot + i].pData = pMap + (size_t)i * pageSize;
+}
 
-        next = pOldBufTable[slot].next;
-        // Allocate a new slot for the old page
-        if ((rc = InternalAlloc(newSlot)))
-            return (rc);
+//
+// UnmapFrames
+//
+// Desc: Internal.  Release the frames of all slots from firstSlot on.
+//       The extents are in slot order, so only the last ones are
+//       affected; an extent that is cut in two keeps its head.
+//
+void PF_BufferMgr::UnmapFrames(int firstSlot)
+{
+    size_t sysPageSize = sysconf(_SC_PAGESIZE);
+
+    while (!arena.empty()) {
+        PF_ArenaExtent &ext = arena.back();
+        if (ext.firstSlot >= firstSlot) {
+            munmap(ext.pBase, ext.length);
+            arena.pop_back();
+            continue;
+        }
 
-        // Insert the page into the hash table,
-        // and initialize the page description entry
-        if ((rc = hashTable.Insert(pOldBufTable[slot].fd,
-                pOldBufTable[slot].pageNum, newSlot)) ||
-                (rc = InitPageDesc(pOldBufTable[slot].fd,
-                pOldBufTable[slot].pageNum, newSlot)))
-            return (rc);
+        int numKept = firstSlot - ext.firstSlot;
+        if (numKept < ext.numSlots) {
+            size_t keep = (size_t)numKept * pageSize;
+            keep = (keep + sysPageSize - 1) / sysPageSize * sysPageSize;
+            if (keep < ext.length)
+                munmap(ext.pBase + keep, ext.length - keep);
+            ext.length = keep;
+            ext.numSlots = numKept;
+        }
+        break;
+    }
+}
 
-        // Put the slot back on the free list before returning the error
-        Unlink(newSlot);
-        InsertFree(newSlot);
+//
+// CompactArena
+//
+// Desc: Internal.  Copy all frames into a single new extent.  No page may
+//       be pinned, since the frames move.
+//
+void PF_BufferMgr::CompactArena()
+{
+    vector<PF_ArenaExtent> oldArena;
+    oldArena.swap(arena);
+
+    vector<char *> oldData(numPages);
+    for (int slot = 0; slot < numPages; slot++)
+        oldData[slot] = bufTable[slot].pData;
 
-        slot = next;
+    MapFrames(0, numPages);
+    vector<int> used;
+    GetUsedSlots(used);
+    for (size_t i = 0; i < used.size(); i++)
+        memcpy(bufTable[used[i]].pData, oldData[used[i]], pageSize);
+
+    for (size_t i = 0; i < oldArena.size(); i++)
+        munmap(oldArena[i].pBase, oldArena[i].length);
+}
+
+//
+// SlotOf
+//
+// Desc: Internal.  Find the slot whose frame starts at pData.
+// Ret:  the slot, or INVALID_SLOT if pData is not the start of a frame
+//
+int PF_BufferMgr::SlotOf(const char *pData) const
+{
+    for (size_t i = 0; i < arena.size(); i++) {
+        const PF_ArenaExtent &ext = arena[i];
+        if (pData < ext.pBase ||
+                pData >= ext.pBase + (size_t)ext.numSlots * pageSize)
+            continue;
+        size_t offset = pData - ext.pBase;
+        if (offset % pageSize)
+            return (INVALID_SLOT);
+        return (ext.firstSlot + (int)(offset / pageSize));
     }
+    return (INVALID_SLOT);
+}
 
-    // Finally, delete the old buffer table
-    delete [] pOldBufTable;
+//
+// SetReplacePolicy
+//
+// Desc: Switch to a different page replacement policy.  The buffer
+//       contents are kept.
+// In:   newPolicy - the policy to use from now on
+// Ret:  0 for success
+//
+RC PF_BufferMgr::SetReplacePolicy(PF_ReplacePolicy newPolicy)
+{
+    lock_guard<PF_PoolLatch> guard(bufLatch);
 
-    return 0;
+    if (newPolicy == policy)
+        return (0);
+
+    policy = newPolicy;
+    RebuildShards();
+
+    return (0);
+}
+
+//
+// RebuildShards
+//
+// Desc: Internal.  Deal out the slots to NumShards(numPages) shards.  Each
+//       resident page is linked into the used list of its slot's shard and
+//       handed to the shard's new replacer, oldest first (the old shards
+//       taken in turn); the other slots go on the free lists.  bufLatch
+//       must be held exclusive.
+//
+void PF_BufferMgr::RebuildShards()
+{
+    // Resident slots, oldest first
+    vector<int> resident, cursor(numShards);
+    for (int s = 0; s < numShards; s++)
+        cursor[s] = shards[s].last;
+    for (size_t numLeft = numShards; numLeft > 0; ) {
+        numLeft = 0;
+        for (int s = 0; s < numShards; s++)
+            if (cursor[s] != INVALID_SLOT) {
+                resident.push_back(cursor[s]);
+                cursor[s] = bufTable[cursor[s]].prev;
+                numLeft++;
+            }
+    }
+    vector<bool> bResident(numPages, false);
+    for (size_t i = 0; i < resident.size(); i++)
+        bResident[resident[i]] = true;
+
+    numShards = NumShards(numPages);
+    for (int s = 0; s < PF_BUFFER_PARTITIONS; s++) {
+        PF_BufShard &shard = shards[s];
+        delete shard.replacer;
+        shard.replacer = s < numShards ?
+            NewReplacer(policy, (numPages - s + numShards - 1) / numShards) :
+            NULL;
+        shard.first = shard.last = shard.free = INVALID_SLOT;
+    }
+
+    for (size_t i = 0; i < resident.size(); i++) {
+        int slot = resident[i];
+        LinkHead(slot);
+        ShardOf(slot).replacer->Admit(slot / numShards, bufTable[slot].fd,
+                                      bufTable[slot].pageNum);
+    }
+    numFree = 0;
+    for (int slot = numPages - 1; slot >= 0; slot--)
+        if (!bResident[slot])
+            InsertFree(slot);
+}
+
+//
+// NumShards
+//
+// Desc: Internal.  Number of shards for a buffer of numPages frames: one
+//       per PF_SHARD_PAGES frames, at most PF_BUFFER_PARTITIONS.  A small
+//       buffer is a single shard, replaced in exact policy order.
+//
+int PF_BufferMgr::NumShards(int numPages)
+{
+    int num = numPages / PF_SHARD_PAGES;
+    if (num > PF_BUFFER_PARTITIONS)
+        num = PF_BUFFER_PARTITIONS;
+    return (num > 1 ? num : 1);
+}
+
+//
+// GetUsedSlots
+//
+// Desc: Internal.  List the slots that hold pages, shard by shard, most
+//       recently loaded first.  bufLatch must be held exclusive.
+// Out:  slots - the slots
+//
+void PF_BufferMgr::GetUsedSlots(vector<int> &slots) const
+{
+    slots.clear();
+    for (int s = 0; s < numShards; s++)
+        for (int slot = shards[s].first; slot != INVALID_SLOT;
+                slot = bufTable[slot].next)
+            slots.push_back(slot);
+}
+
+//
+// Candidates
+//
+// Desc: Internal.  Ask the replacer of shard s for its candidates and
+//       turn its frame numbers into slots.  The latch of the shard, or
+//       bufLatch exclusive, must be held.
+// In:   s - shard
+//       maxSlots - most candidates wanted
+// Out:  slots - the candidates, next to be replaced first
+// Ret:  number of candidates
+//
+int PF_BufferMgr::Candidates(int s, int *slots, int maxSlots) const
+{
+    int numCand = shards[s].replacer->Candidates(slots, maxSlots);
+    for (int i = 0; i < numCand; i++)
+        slots[i] = slots[i] * numShards + s;
+    return (numCand);
+}
+
+//
+// NewReplacer
+//
+// Desc: Internal.  Create the replacer object for a policy.
+// In:   policy - replacement policy
+//       numPages - number of slots the replacer has to track
+// Ret:  the new replacer
+//
+PF_Replacer *PF_BufferMgr::NewReplacer(PF_ReplacePolicy policy, int numPages)
+{
+    switch (policy) {
+    case PF_2Q:
+        return new PF_2QReplacer(numPages);
+    case PF_LRU:
+    default:
+        return new PF_LRUReplacer(numPages);
+    }
 }
 
 
 //
 // InsertFree
 //
-// Desc: Internal.  Insert a slot at the head of the free list
+// Desc: Internal.  Insert a slot at the head of the free list of its
+//       shard, whose latch must be held
 // In:   slot - slot number to insert
 // Ret:  PF return code
 //
 RC PF_BufferMgr::InsertFree(int slot)
 {
-    bufTable[slot].next = free;
-    free = slot;
+    PF_BufShard &shard = ShardOf(slot);
+    bufTable[slot].next = shard.free;
+    shard.free = slot;
+    numFree++;
 
     // Return ok
     return (0);
@@ -702,26 +1992,29 @@ RC PF_BufferMgr::InsertFree(int slot)
 //
 // LinkHead
 //
-// Desc: Internal.  Insert a slot at the head of the used list, making
-//       it the most-recently used slot.
+// Desc: Internal.  Insert a slot at the head of the used list of its
+//       shard, making it the most-recently used slot.  The latch of the
+//       shard must be held.
 // In:   slot - slot number to insert
 // Ret:  PF return code
 //
 RC PF_BufferMgr::LinkHead(int slot)
 {
+    PF_BufShard &shard = ShardOf(slot);
+
     // Set next and prev pointers of slot entry
-    bufTable[slot].next = first;
+    bufTable[slot].next = shard.first;
     bufTable[slot].prev = INVALID_SLOT;
 
     // If list isn't empty, point old first back to slot
-    if (first != INVALID_SLOT)
-        bufTable[first].prev = slot;
+    if (shard.first != INVALID_SLOT)
+        bufTable[shard.first].prev = slot;
 
-    first = slot;
+    shard.first = slot;
 
     // if list was empty, set last to slot
-    if (last == INVALID_SLOT)
-        last = first;
+    if (shard.last == INVALID_SLOT)
+        shard.last = shard.first;
 
     // Return ok
     return (0);
@@ -730,8 +2023,9 @@ RC PF_BufferMgr::LinkHead(int slot)
 //
 // Unlink
 //
-// Desc: Internal.  Unlink the slot from the used list.  Assume that
-//       slot is valid.  Set prev and next pointers to INVALID_SLOT.
+// Desc: Internal.  Unlink the slot from the used list of its shard, whose
+//       latch must be held.  Assume that slot is valid.  Set prev and next
+//       pointers to INVALID_SLOT.
 //       The caller is responsible to either place the unlinked page into
 //       the free list or the used list.
 // In:   slot - slot number to unlink
@@ -739,13 +2033,15 @@ RC PF_BufferMgr::LinkHead(int slot)
 //
 RC PF_BufferMgr::Unlink(int slot)
 {
+    PF_BufShard &shard = ShardOf(slot);
+
     // If slot is at head of list, set first to next element
-    if (first == slot)
-        first = bufTable[slot].next;
+    if (shard.first == slot)
+        shard.first = bufTable[slot].next;
 
     // If slot is at end of list, set last to previous element
-    if (last == slot)
-        last = bufTable[slot].prev;
+    if (shard.last == slot)
+        shard.last = bufTable[slot].prev;
 
     // If slot not at end of list, point next back to previous
     if (bufTable[slot].next != INVALID_SLOT)
@@ -762,59 +2058,325 @@ RC PF_BufferMgr::Unlink(int slot)
     return (0);
 }
 
+//
+// ReplaceLink
+//
+// Desc: Internal.  Put newSlot in the place of slot in the used list of
+//       slot's shard, even if newSlot belongs to another shard (only
+//       until RebuildShards).  slot is left unlinked.  bufLatch must be
+//       held exclusive.
+// In:   slot - slot number currently on the used list
+//       newSlot - slot number that is not on any used list
+//
+void PF_BufferMgr::ReplaceLink(int slot, int newSlot)
+{
+    PF_BufShard &shard = ShardOf(slot);
+
+    bufTable[newSlot].next = bufTable[slot].next;
+    bufTable[newSlot].prev = bufTable[slot].prev;
+
+    if (bufTable[slot].next != INVALID_SLOT)
+        bufTable[bufTable[slot].next].prev = newSlot;
+    else
+        shard.last = newSlot;
+
+    if (bufTable[slot].prev != INVALID_SLOT)
+        bufTable[bufTable[slot].prev].next = newSlot;
+    else
+        shard.first = newSlot;
+
+    bufTable[slot].prev = bufTable[slot].next = INVALID_SLOT;
+}
+
 //
 // InternalAlloc
 //
 // Desc: Internal.  Allocate a buffer slot.  The slot is inserted at the
-//       head of the used list.  Here's how it chooses which slot to use:
-//       If there is something on the free list, then use it.
-//       Otherwise, choose a victim to replace.  If a victim cannot be
-//       chosen (because all the pages are pinned), then return an error.
+//       head of the used list of its shard.  Here's how it chooses which
+//       slot to use:
+//       If there is something on a free list, then use it, looking at
+//       the home shard first.
+//       Otherwise, replace a page of the home shard, or failing that of
+//       the other shards in turn (see Replace).
+//       If no page can be replaced because every page is pinned, being
+//       read ahead or being written by the flusher, wait for the reads
+//       and writes in progress (unless bMayWait is FALSE) and try again.
+//       If there are none, then return an error.
+//       bufLatch must be held shared and is released while waiting for
+//       the flusher.  No other latch may be held.
+// In:   home - shard to look in first
+//       bMayWait - FALSE to give up rather than wait
 // Out:  slot - set to newly-allocated slot
 // Ret:  PF_NOBUF if all pages are pinned, other PF return code otherwise
 //
-RC PF_BufferMgr::InternalAlloc(int &slot)
+RC PF_BufferMgr::InternalAlloc(int &slot, int home, int bMayWait)
 {
-    RC  rc;       // return code
+    RC rc;
 
-    // If the free list is not empty, choose a slot from the free list
-    if (free != INVALID_SLOT) {
-        slot = free;
-        free = bufTable[slot].next;
+    for (;;) {
+
+        // If a free list is not empty, choose a slot from it
+        for (int i = 0; numFree > 0 && i < numShards; i++) {
+            PF_BufShard &shard = shards[(home + i) % numShards];
+            lock_guard<mutex> shardLock(shard.latch);
+            if (shard.free != INVALID_SLOT) {
+                slot = shard.free;
+                shard.free = bufTable[slot].next;
+                numFree--;
+                return (LinkHead(slot));
+            }
+        }
+
+        for (int i = 0; i < numShards; i++)
+            if ((rc = Replace((home + i) % numShards, slot)) != PF_NOBUF)
+                return (rc);
+
+        if (!bMayWait || !WaitForFrames())
+            return (PF_NOBUF);
     }
-    else {
+}
 
-        // Choose the least-recently used page that is unpinned
-        for (slot = last; slot != INVALID_SLOT; slot = bufTable[slot].prev) {
-            if (bufTable[slot].pinCount == 0)
-                break;
+//
+// Replace
+//
+// Desc: Internal.  Replace a page of shard s.  Go through the candidates
+//       of the shard's replacer, in growing batches, and replace the
+//       first page that is not in use.  A page that was used since it
+//       was last looked at gets a second chance if the replacer wants (a
+//       KEEP_HOT page gets PF_HOT_USAGE).  A pinned page is moved away
+//       from the victim end, so that later batches and later misses do
+//       not look at it again until it comes back around.  Pages being
+//       read ahead or written by the flusher are passed over.
+//       A dirty victim is taken out of the shard and written out with
+//       only bufLatch (shared) held; the frame is fenced by bInIO, so
+//       GetPage waits for the page meanwhile.  If the write fails the
+//       page goes back into the shard, dirty.
+//       The slot is linked at the head of the shard's used list.
+//       bufLatch must be held shared.
+// In:   s - shard
+// Out:  slot - set to the slot of the replaced page
+// Ret:  PF_NOBUF if no page of the shard can be replaced, other PF
+//       return code otherwise
+//
+RC PF_BufferMgr::Replace(int s, int &slot)
+{
+    RC  rc;           // return code
+    int batch = 0;    // size of the current batch of candidates
+    int numCand = 0;  // candidates in the batch
+    int i = 0;        // next candidate to look at
+    PF_BufShard &shard = shards[s];
+    unique_lock<mutex> shardLock(shard.latch);
+
+    for (;;) {
+
+        // Get the next, larger batch once this one is used up.  When the
+        // replacer had no more to give, every page is in use.
+        if (i == numCand) {
+            if (batch > 0 && numCand < batch)
+                return (PF_NOBUF);
+            batch = batch ? 2 * batch : PF_VICTIM_BATCH;
+            shard.victims.resize(batch);
+            numCand = Candidates(s, shard.victims.data(), batch);
+            i = 0;
+            continue;
         }
 
-        // Return error if all buffers were pinned
-        if (slot == INVALID_SLOT)
-            return (PF_NOBUF);
+        slot = shard.victims[i++];
+        PF_BufPageDesc &desc = bufTable[slot];
+        if (desc.pinCount > 0) {
+            shard.replacer->Skip(slot / numShards);
+            continue;
+        }
 
-        // Write out the page if it is dirty
-        if (bufTable[slot].bDirty) {
-            if ((rc = WritePage(bufTable[slot].fd, bufTable[slot].pageNum,
-                    bufTable[slot].pData)))
-                return (rc);
+        // The page cannot be reused while the flusher is writing it
+        if (desc.bWriting)
+            continue;
+
+        // Another thread may pin the page until we hold its partition
+        // latch.  A page still being read (ahead) cannot be reused.
+        PF_BufPartition &part = Partition(desc.fd, desc.pageNum);
+        unique_lock<mutex> lock(part.latch);
+        if (desc.pinCount > 0) {
+            shard.replacer->Skip(slot / numShards);
+            continue;
+        }
+        if (desc.bInIO || desc.pPending)
+            continue;
+        int usage = desc.usage;
+        if (usage) {
+            desc.usage = usage - 1;
+            if (shard.replacer->Reference(slot / numShards, usage > TRUE))
+                continue;
+        }
 
-            bufTable[slot].bDirty = FALSE;
+        if (!desc.bDirty) {
+            // Remove page from the hash table and slot from the used list
+            if ((rc = part.hashTable.Delete(desc.fd, desc.pageNum)))
+                return (rc);
+            lock.unlock();
+            shard.replacer->Evict(slot / numShards);
+            if ((rc = Unlink(slot)) ||
+                    (rc = LinkHead(slot)))
+                return (rc);
+            return (0);
         }
 
-        // Remove page from the hash table and slot from the used buffer list
-        if ((rc = hashTable.Delete(bufTable[slot].fd, bufTable[slot].pageNum)) ||
-                (rc = Unlink(slot)))
+        // Write out the dirty page with no shard or partition latch held.
+        // Ask the flusher to run, it is evidently not keeping up.
+        desc.bDirty = FALSE;
+        desc.bInIO = TRUE;
+        lock.unlock();
+        shard.replacer->Evict(slot / numShards);
+        Unlink(slot);
+        shardLock.unlock();
+
+        dirtyEvictions++;
+        if (cleanTarget > 0)
+            flusherWake.notify_one();
+
+        rc = WritePage(desc.fd, desc.pageNum, desc.pData);
+
+        shardLock.lock();
+        lock.lock();
+        desc.bInIO = FALSE;
+        if (rc)
+            desc.bDirty = TRUE;
+        else
+            rc = part.hashTable.Delete(desc.fd, desc.pageNum);
+        lock.unlock();
+        part.ioDone.notify_all();
+
+        LinkHead(slot);
+        if (rc) {
+            shard.replacer->Admit(slot / numShards, desc.fd, desc.pageNum);
             return (rc);
+        }
+        return (0);
     }
+}
 
-    // Link slot at the head of the used list
-    if ((rc = LinkHead(slot)))
-        return (rc);
+//
+// WaitForFrames
+//
+// Desc: Internal.  Wait for the read-aheads and the flusher writes in
+//       progress, whose frames cannot be replaced meanwhile.  bufLatch
+//       must be held shared; it is released while waiting for the
+//       flusher.
+// Ret:  FALSE if there was nothing to wait for
+//
+bool PF_BufferMgr::WaitForFrames()
+{
+    bool bWaited;
+    {
+        lock_guard<mutex> reads(readLatch);
+        bWaited = !pendingReads.empty();
+        FinishAllReads();
+    }
 
-    // Return ok
-    return (0);
+    unique_lock<PF_PoolLatch::Shared> pool(sharedLatch, adopt_lock);
+    while (numWriting > 0) {
+        bWaited = true;
+        writeDone.wait(pool);
+    }
+    pool.release();
+    return (bWaited);
+}
+
+//
+// AllocFor
+//
+// Desc: Internal.  Allocate a buffer slot for pageNum of fd, which is
+//       fetched with hint.  Other than for a SEQUENTIAL_SCAN this is
+//       InternalAlloc, starting with the page's home shard.
+//       Once the scan ring of fd is full, a scan takes the oldest frame of
+//       the ring instead and reads into it, so that a large scan only
+//       replaces pages of its own.  A ring frame that is pinned, dirty,
+//       busy or was used by someone else since it was read drops out of
+//       the ring and stays in the buffer as an ordinary page.  The slot is
+//       linked at the head of the used list; the caller adds it to the
+//       ring again once the new page is in the hash table (see AddToRing).
+//       bufLatch must be held shared.
+// In:   fd - file descriptor of the page
+//       pageNum - page number
+//       hint - how the page will be used
+//       bMayWait - see InternalAlloc
+// Out:  slot - set to the allocated slot
+// Ret:  PF return code (see InternalAlloc)
+//
+RC PF_BufferMgr::AllocFor(int fd, PageNum pageNum, ClientHint hint,
+                          int &slot, int bMayWait)
+{
+    RC rc;
+
+    if (hint != SEQUENTIAL_SCAN)
+        return (InternalAlloc(slot, HomeShard(fd, pageNum), bMayWait));
+
+    {
+        lock_guard<mutex> ringLock(ringLatch);
+        deque<pair<int, PageNum> > &ring = scanRings[fd];
+        while ((int)ring.size() >= scanRingPages) {
+            int ringSlot = ring.front().first;
+            PageNum ringPage = ring.front().second;
+            ring.pop_front();
+
+            PF_BufPageDesc &desc = bufTable[ringSlot];
+            PF_BufShard &shard = ShardOf(ringSlot);
+            lock_guard<mutex> shardLock(shard.latch);
+            if (desc.bWriting)
+                continue;
+
+            // The frame may hold another page by now
+            int found;
+            PF_BufPartition &part = Partition(fd, ringPage);
+            unique_lock<mutex> lock(part.latch);
+            if (part.hashTable.Find(fd, ringPage, found) || found != ringSlot)
+                continue;
+            if (desc.pinCount > 0 || desc.bInIO || desc.pPending ||
+                    desc.bDirty || desc.usage)
+                continue;
+
+            if ((rc = part.hashTable.Delete(fd, ringPage)))
+                return (rc);
+            lock.unlock();
+            shard.replacer->Remove(ringSlot / numShards);
+            ringReuses++;
+
+            slot = ringSlot;
+            if ((rc = Unlink(slot)) ||
+                    (rc = LinkHead(slot)))
+                return (rc);
+            return (0);
+        }
+    }
+
+    return (InternalAlloc(slot, HomeShard(fd, pageNum), bMayWait));
+}
+
+//
+// AddToRing
+//
+// Desc: Internal.  Append slot, which now holds pageNum of fd, to the scan
+//       ring of fd.  bufLatch must be held shared.
+//
+void PF_BufferMgr::AddToRing(int fd, PageNum pageNum, int slot)
+{
+    lock_guard<mutex> ringLock(ringLatch);
+    scanRings[fd].push_back(make_pair(slot, pageNum));
+}
+
+//
+// RingSize
+//
+// Desc: Internal.  Number of frames in a scan ring for a buffer of
+//       numPages pages: PF_SCAN_RING_PAGES, but at most a quarter of the
+//       buffer.
+//
+int PF_BufferMgr::RingSize(int numPages)
+{
+    int size = numPages / 4;
+    if (size > PF_SCAN_RING_PAGES)
+        size = PF_SCAN_RING_PAGES;
+    return (size > 1 ? size : 1);
 }
 
 //
@@ -837,19 +2399,28 @@ RC PF_BufferMgr::ReadPage(int fd, PageNum pageNum, char *dest)
     WriteLog(psMessage);
 #endif
 
-#ifdef PF_STATS
-    pStatisticsMgr->Register(PF_READPAGE, STAT_ADDONE);
-#endif
+    PF_Count(PF_READPAGE);
 
-    // seek to the appropriate place (cast to long for PC's)
-    long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-    if (lseek(fd, offset, L_SET) < 0)
-        return (PF_UNIX);
+    PF_PageMap *pPageMap = PageMapOf(fd);
+    if (pPageMap)
+        return (ReadCompressed(pPageMap, fd, pageNum, dest));
 
-    // Read the data
-    int numBytes = read(fd, dest, pageSize);
-    if (numBytes < 0)
+    // Read the data at the page's offset
+    RC rc;
+    PF_IORequest req;
+    struct iovec iov = { dest, (size_t)pageSize };
+    req.op = PF_IORequest::READ;
+    req.fd = fd;
+    req.offset = pageNum * (off_t)pageSize + PF_FILE_HDR_SIZE;
+    req.iov.push_back(iov);
+    if ((rc = pIO->Execute(req)))
+        return (rc);
+
+    int numBytes = (int)req.result;
+    if (numBytes < 0) {
+        errno = -numBytes;
         return (PF_UNIX);
+    }
     else if (numBytes != pageSize)
         return (PF_INCOMPLETEREAD);
     else
@@ -875,30 +2446,196 @@ RC PF_BufferMgr::WritePage(int fd, PageNum pageNum, char *source)
     WriteLog(psMessage);
 #endif
 
-#ifdef PF_STATS
-    pStatisticsMgr->Register(PF_WRITEPAGE, STAT_ADDONE);
-#endif
+    PF_Count(PF_WRITEPAGE);
 
-    // seek to the appropriate place (cast to long for PC's)
-    long offset = pageNum * (long)pageSize + PF_FILE_HDR_SIZE;
-    if (lseek(fd, offset, L_SET) < 0)
-        return (PF_UNIX);
+    PF_PageMap *pPageMap = PageMapOf(fd);
+    if (pPageMap)
+        return (WriteCompressed(pPageMap, fd, pageNum, source));
+
+    // Write the data at the page's offset
+    RC rc;
+    PF_IORequest req;
+    struct iovec iov = { source, (size_t)pageSize };
+    req.op = PF_IORequest::WRITE;
+    req.fd = fd;
+    req.offset = pageNum * (off_t)pageSize + PF_FILE_HDR_SIZE;
+    req.iov.push_back(iov);
+    if ((rc = pIO->Execute(req)))
+        return (rc);
 
-    // Read the data
-    int numBytes = write(fd, source, pageSize);
-    if (numBytes < 0)
+    int numBytes = (int)req.result;
+    if (numBytes < 0) {
+        errno = -numBytes;
         return (PF_UNIX);
+    }
     else if (numBytes != pageSize)
         return (PF_INCOMPLETEWRITE);
     else
         return (0);
 }
 
+//
+// AttachPageMap
+//
+// Desc: From now on read and write the pages of fd through pPageMap.
+//       Called when a compressed file is opened, before any of its pages
+//       is in the buffer.
+//
+void PF_BufferMgr::AttachPageMap(int fd, PF_PageMap *pPageMap)
+{
+    lock_guard<mutex> guard(mapLatch);
+    pageMaps[fd] = pPageMap;
+}
+
+//
+// DetachPageMap
+//
+// Desc: Forget the page map of fd.  Called when the file is closed, once
+//       its pages have been flushed.
+//
+void PF_BufferMgr::DetachPageMap(int fd)
+{
+    lock_guard<mutex> guard(mapLatch);
+    pageMaps.erase(fd);
+}
+
+//
+// PageMapOf
+//
+// Desc: Internal.  Return the page map of fd, or NULL if the pages of fd
+//       are not compressed.  May be called with or without other latches.
+//
+PF_PageMap *PF_BufferMgr::PageMapOf(int fd) const
+{
+    lock_guard<mutex> guard(mapLatch);
+    map<int, PF_PageMap *>::const_iterator it = pageMaps.find(fd);
+    return (it == pageMaps.end() ? NULL : it->second);
+}
+
+//
+// ReadCompressed
+//
+// Desc: Internal.  Read a page of a compressed file: the units of its
+//       extent are read and decompressed into dest.  The length of the
+//       compressed data is taken from the page itself, since the map's
+//       may not have been saved since the page was written.
+// In:   pPageMap - page map of the file
+//       fd, pageNum - the page
+// Out:  dest - page contents
+// Ret:  PF_INCOMPLETEREAD if the page was never written, PF_BADCOMPRESSED
+//       or other PF return code
+//
+RC PF_BufferMgr::ReadCompressed(PF_PageMap *pPageMap, int fd,
+                                PageNum pageNum, char *dest)
+{
+    RC rc;
+    PF_PageExtent ext = pPageMap->Lookup(pageNum);
+    if (ext.length == 0)
+        return (PF_INCOMPLETEREAD);
+
+    // A page that did not compress is read in place
+    int numBytes = PF_PageMap::Units(ext.length) * PF_COMP_UNIT;
+    vector<char> buf(ext.length == pageSize ? 0 : numBytes);
+
+    PF_IORequest req;
+    struct iovec iov = { buf.empty() ? dest : buf.data(), (size_t)numBytes };
+    req.op = PF_IORequest::READ;
+    req.fd = fd;
+    req.offset = ext.start * (off_t)PF_COMP_UNIT + PF_FILE_HDR_SIZE;
+    req.iov.push_back(iov);
+    if ((rc = pIO->Execute(req)))
+        return (rc);
+
+    if (req.result < 0) {
+        errno = -req.result;
+        return (PF_UNIX);
+    }
+    if (req.result != numBytes)
+        return (PF_INCOMPLETEREAD);
+    if (buf.empty())
+        return (0);
+
+    const unsigned char *prefix = (const unsigned char *)buf.data();
+    int length = prefix[0] | prefix[1] << 8;
+    if (length > numBytes - PF_COMP_PREFIX ||
+            PF_Decompress(buf.data() + PF_COMP_PREFIX, length,
+                          dest, pageSize) != pageSize)
+        return (PF_BADCOMPRESSED);
+    return (0);
+}
+
+//
+// WriteCompressed
+//
+// Desc: Internal.  Write a page of a compressed file.  The page is stored
+//       as it is unless compressing it saves at least one unit; else the
+//       compressed data follows its length (see pf_compress.h).
+// In:   pPageMap - page map of the file
+//       fd, pageNum - the page
+//       source - page contents
+// Ret:  PF return code
+//
+RC PF_BufferMgr::WriteCompressed(PF_PageMap *pPageMap, int fd,
+                                 PageNum pageNum, const char *source)
+{
+    RC rc;
+    vector<char> buf(pageSize);
+    int length = PF_Compress(source, pageSize, buf.data() + PF_COMP_PREFIX,
+                             pageSize - PF_COMP_UNIT - PF_COMP_PREFIX);
+    buf[0] = (char)(length & 0xff);
+    buf[1] = (char)(length >> 8);
+    length += PF_COMP_PREFIX;
+    int numBytes = PF_PageMap::Units(length) * PF_COMP_UNIT;
+    if (length == PF_COMP_PREFIX)
+        length = numBytes = pageSize;
+    else
+        memset(buf.data() + length, 0, numBytes - length);
+
+    PF_PageExtent ext = pPageMap->Place(pageNum, length);
+
+    PF_IORequest req;
+    struct iovec iov = { length == pageSize ? (char *)source : buf.data(),
+                         (size_t)numBytes };
+    req.op = PF_IORequest::WRITE;
+    req.fd = fd;
+    req.offset = ext.start * (off_t)PF_COMP_UNIT + PF_FILE_HDR_SIZE;
+    req.iov.push_back(iov);
+    if ((rc = pIO->Execute(req)))
+        return (rc);
+
+    if (req.result < 0) {
+        errno = -req.result;
+        return (PF_UNIX);
+    }
+    if (req.result != numBytes)
+        return (PF_INCOMPLETEWRITE);
+
+    compPageBytes += pageSize;
+    compStoredBytes += numBytes;
+    return (0);
+}
+
+//
+// InBuffer
+//
+// Desc: Internal.  Is the page in the buffer?  Pages being read in count.
+// In:   fd - file descriptor
+//       pageNum - page number
+//
+bool PF_BufferMgr::InBuffer(int fd, PageNum pageNum) const
+{
+    int slot;
+    PF_BufPartition &part = Partition(fd, pageNum);
+    lock_guard<mutex> lock(part.latch);
+    return (part.hashTable.Find(fd, pageNum, slot) == 0);
+}
+
 //
 // InitPageDesc
 //
 // Desc: Internal.  Initialize PF_BufPageDesc to a newly-pinned page
-//       for a newly pinned page
+//       for a newly pinned page.  The latches of the slot's shard and of
+//       the page's partition must be held.
 // In:   fd - file descriptor
 //       pageNum - page number
 // Ret:  PF return code
@@ -910,6 +2647,12 @@ RC PF_BufferMgr::InitPageDesc(int fd, PageNum pageNum, int slot)
     bufTable[slot].pageNum  = pageNum;
     bufTable[slot].bDirty   = FALSE;
     bufTable[slot].pinCount = 1;
+    bufTable[slot].usage = FALSE;
+    bufTable[slot].bInIO = FALSE;
+    bufTable[slot].pPending = NULL;
+
+    // Tell the replacer about the new page
+    ShardOf(slot).replacer->Admit(slot / numShards, fd, pageNum);
 
     // Return ok
     return (0);
@@ -945,18 +2688,27 @@ RC PF_BufferMgr::GetBlockSize(int &length) const
 RC PF_BufferMgr::AllocateBlock(char *&buffer)
 {
     RC rc = OK_RC;
+    lock_guard<PF_PoolLatch::Shared> guard(sharedLatch);
 
     // Get an empty slot from the buffer pool
     int slot;
-    if ((rc = InternalAlloc(slot)) != OK_RC)
+    if ((rc = InternalAlloc(slot, 0)) != OK_RC)
         return rc;
 
-    // Create artificial page number (just needs to be unique for hash table)
-    PageNum pageNum = *(PageNum *)bufTable[slot].pData;
+    // Create artificial page number (just needs to be unique for hash
+    // table).  The slot number is unique among the memory blocks.
+    PageNum pageNum = slot;
 
     // Insert the page into the hash table, and initialize the page description entry
-    if ((rc = hashTable.Insert(MEMORY_FD, pageNum, slot) != OK_RC) ||
-            (rc = InitPageDesc(MEMORY_FD, pageNum, slot)) != OK_RC) {
+    PF_BufShard &shard = ShardOf(slot);
+    lock_guard<mutex> shardLock(shard.latch);
+    {
+        PF_BufPartition &part = Partition(MEMORY_FD, pageNum);
+        lock_guard<mutex> lock(part.latch);
+        if ((rc = part.hashTable.Insert(MEMORY_FD, pageNum, slot)) == OK_RC)
+            rc = InitPageDesc(MEMORY_FD, pageNum, slot);
+    }
+    if (rc != OK_RC) {
         // Put the slot back on the free list before returning the error
         Unlink(slot);
         InsertFree(slot);
@@ -977,5 +2729,31 @@ RC PF_BufferMgr::AllocateBlock(char *&buffer)
 //
 RC PF_BufferMgr::DisposeBlock(char* buffer)
 {
-    return UnpinPage(MEMORY_FD, *(PageNum *)buffer);
+    RC rc;
+    lock_guard<PF_PoolLatch::Shared> guard(sharedLatch);
+
+    // Find the slot that holds the block from its address; its slot number
+    // is the artificial page number.  The contents are of no further use,
+    // so the slot goes straight back to the free list.
+    int slot = SlotOf(buffer);
+    if (slot == INVALID_SLOT)
+        return (PF_PAGENOTINBUF);
+    PF_BufShard &shard = ShardOf(slot);
+    lock_guard<mutex> shardLock(shard.latch);
+    if (bufTable[slot].pinCount == 0 || bufTable[slot].fd != MEMORY_FD)
+        return (PF_PAGENOTINBUF);
+
+    {
+        PF_BufPartition &part = Partition(MEMORY_FD, slot);
+        lock_guard<mutex> lock(part.latch);
+        bufTable[slot].pinCount = 0;
+        if ((rc = part.hashTable.Delete(MEMORY_FD, slot)))
+            return (rc);
+    }
+    shard.replacer->Remove(slot / numShards);
+    if ((rc = Unlink(slot)) ||
+            (rc = InsertFree(slot)))
+        return (rc);
+
+    return OK_RC;
 }
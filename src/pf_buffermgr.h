@@ -11,12 +11,54 @@
 // a particular file.  Allows students to use main memory chunks that
 // are associated with (and limited by) the buffer.
 //
+// The choice of a victim page is delegated to a PF_Replacer; the used
+// list only tracks which slots are resident.  Frames are carved out of a
+// page-aligned arena.  A background thread writes dirty pages that are
+// close to being replaced; it releases bufLatch while its writes are in
+// progress and marks the frames bWriting.
+//
+// The buffer may be used by several threads.  The page table is split
+// into PF_BUFFER_PARTITIONS partitions with a latch each; a buffer hit,
+// UnpinPage and MarkDirty only take the latch of the page's partition.
+// The frames are dealt out to shards, one per PF_SHARD_PAGES frames up to
+// PF_BUFFER_PARTITIONS, each with its own latch, free list, used list and
+// replacer.  A miss holds bufLatch shared and the latch of one shard at a
+// time, so misses replace pages in parallel; a page is replaced in its
+// home shard unless a frame is free elsewhere or every page of the shard
+// is pinned.  Flushing, resizing and the other changes to the whole
+// buffer hold bufLatch exclusive.  The latches are taken in the order
+// bufLatch, readLatch, ringLatch, shard, partition.  Pages are read in,
+// and dirty victims written out, with bufLatch held shared at most;
+// other threads asking for such a page wait on the partition's ioDone.
+// A frame has no latch of its own: only the threads that pinned it use
+// its contents, and it changes hands under the latches of its shard and
+// of its page's partition.
+//
+// GetPage takes a ClientHint.  The pages of a SEQUENTIAL_SCAN are read
+// into a small ring of frames per file that is recycled instead of
+// replacing other pages; KEEP_HOT pages get more than one second chance.
+// Pages can be kept resident (pinned on behalf of a file) up to half of
+// the buffer.  The size of the pages is set per database (SetPageSize).
+// The pages of files with a PF_PageMap are compressed on the way to disk
+// and decompressed on the way back, one page per I/O.
+//
 
 #ifndef PF_BUFFERMGR_H
 #define PF_BUFFERMGR_H
 
 #include "pf_internal.h"
 #include "pf_hashtable.h"
+#include "pf_replacer.h"
+#include "pf_io.h"
+#include "pf_compress.h"
+#include "pf_trace.h"
+#include <set>
+#include <map>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 //
 // Defines
@@ -28,17 +70,122 @@
 // next.
 #define INVALID_SLOT  (-1)
 
+//
+// PF_PendingRead - a read-ahead that may still be in progress
+//
+// The frames are already in the hash table and unpinned, but their
+// contents may not be used until the read has been finished.
+//
+struct PF_PendingRead {
+    PF_IORequest     req;   // the vectored read
+    std::vector<int> slots; // frames being read into, in page order
+};
+
+//
+// PF_ArenaExtent - a mapping that holds the frames of consecutive slots
+//
+// Normally all frames live in a single extent.  A buffer that grows while
+// pages are pinned (clients hold pointers into the frames) gets another
+// extent for the new slots; the extents are merged by the next resize
+// made while no page is pinned.
+//
+struct PF_ArenaExtent {
+    char   *pBase;      // start of the mapping, frame of firstSlot
+    size_t length;      // bytes mapped
+    int    firstSlot;   // first slot whose frame is in this extent
+    int    numSlots;    // number of frames in this extent
+};
+
 //
 // PF_BufPageDesc - struct containing data about a page in the buffer
 //
+// pinCount, usage, bInIO and pPending change, and bDirty is cleared, only
+// with the latch of the page's partition held; fd and pageNum change with
+// that latch and the latch of the slot's shard.  next and prev are
+// protected by the shard's latch, bWriting by bufLatch (exclusive).
+//
 struct PF_BufPageDesc {
     char       *pData;      // page contents
     int        next;        // next in the linked list of buffer pages
     int        prev;        // prev in the linked list of buffer pages
-    int        bDirty;      // TRUE if page is dirty
-    short int  pinCount;    // pin count
+    std::atomic<int> bDirty;      // TRUE if page is dirty
+    std::atomic<int> pinCount;    // pin count
+    std::atomic<int> usage;       // second chances left: TRUE if used since
+                                  // last a replacement candidate,
+                                  // PF_HOT_USAGE for KEEP_HOT pages
     PageNum    pageNum;     // page number for this page
     int        fd;          // OS file descriptor of this page
+    int        bInIO;       // TRUE while the page is read in or written
+                            // out for replacement; GetPage waits
+    PF_PendingRead *pPending; // read-ahead in progress, or NULL
+    int        bWriting;    // TRUE while the flusher is writing the page
+
+    PF_BufPageDesc &operator= (const PF_BufPageDesc &desc);
+};
+
+//
+// PF_BufPartition - one partition of the page table
+//
+struct PF_BufPartition {
+    std::mutex              latch;      // protects hashTable
+    PF_HashTable            hashTable;  // pages of this partition
+    std::condition_variable ioDone;     // a page of this partition was read
+
+    PF_BufPartition () : hashTable(PF_HASH_TBL_SIZE) {}
+};
+
+//
+// PF_BufShard - one shard of the frames
+//
+// Slot s belongs to shard s % numShards.  The replacer of a shard numbers
+// its frames s / numShards.
+//
+struct PF_BufShard {
+    std::mutex       latch;     // protects the fields below
+    int              first;     // most recently loaded slot
+    int              last;      // least recently loaded slot
+    int              free;      // head of free list
+    PF_Replacer      *replacer; // orders the pages of the shard
+    std::vector<int> victims;   // candidates, Replace
+
+    PF_BufShard () : first(INVALID_SLOT), last(INVALID_SLOT),
+                     free(INVALID_SLOT), replacer(NULL) {}
+};
+
+//
+// PF_PoolLatch - the buffer pool latch, held shared or exclusive
+//
+// A thread waiting to hold the latch exclusive keeps new threads from
+// holding it shared, so that a steady stream of misses cannot hold off
+// a flush for ever.  Not recursive.  The latch is held exclusive through
+// lock and unlock, shared through the Shared view of it, so that both
+// work with the standard lock guards.  While no thread wants it
+// exclusive, holding it shared only takes an atomic increment.
+//
+class PF_PoolLatch {
+public:
+    PF_PoolLatch () : numShared(0), bExclusive(false), numWaiting(0) {}
+
+    void lock          ();
+    void unlock        ();
+    void lock_shared   ();
+    void unlock_shared ();
+
+    class Shared {
+    public:
+        explicit Shared (PF_PoolLatch &pool) : pool(pool) {}
+        void lock   () { pool.lock_shared(); }
+        void unlock () { pool.unlock_shared(); }
+    private:
+        PF_PoolLatch &pool;
+    };
+
+private:
+    std::mutex              latch;      // taken to wait for changed
+    std::condition_variable changed;    // the latch was released
+    std::atomic<int>        numShared;  // threads holding it shared
+    std::atomic<bool>       bExclusive; // a thread holds it exclusive
+    std::atomic<int>        numWaiting; // threads waiting for exclusive
 };
 
 //
@@ -53,12 +200,17 @@ public:
 
     // Read pageNum into buffer, point *ppBuffer to location
     RC  GetPage      (int fd, PageNum pageNum, char **ppBuffer,
-                      int bMultiplePins = TRUE);
+                      int bMultiplePins = TRUE, ClientHint hint = NO_HINT);
     // Allocate a new page in the buffer, point *ppBuffer to its location
     RC  AllocatePage (int fd, PageNum pageNum, char **ppBuffer);
 
     RC  MarkDirty    (int fd, PageNum pageNum);  // Mark page dirty
     RC  UnpinPage    (int fd, PageNum pageNum);  // Unpin page from the buffer
+
+    // Pin a page until ReleaseResident, if less than half of the buffer
+    // is kept resident
+    RC  KeepResident (int fd, PageNum pageNum);
+    RC  ReleaseResident(int fd, PageNum pageNum);
     RC  FlushPages   (int fd);                   // Flush pages for file
 
     // Force a page to the disk, but do not remove from the buffer pool
@@ -73,6 +225,52 @@ public:
     // Attempts to resize the buffer to the new size
     RC ResizeBuffer  (int iNewSize);
 
+    // Switch to pages of a different size, dropping all pages
+    RC SetPageSize   (int pageSize);
+    int GetPageSize  ();
+
+    // Pages of fd in the buffer, next to be replaced first (pages that
+    // only a sequential scan has used are left out)
+    void GetResidentPages(int fd, std::vector<PageNum> &pages);
+    // Read the given pages of fd ahead, in runs of consecutive pages
+    void WarmUp        (int fd, std::vector<PageNum> pages);
+    int  GetNumPages   ();
+
+    // Store the pages of fd compressed, at the extents of pPageMap, until
+    // DetachPageMap (after its pages have been flushed)
+    void AttachPageMap(int fd, PF_PageMap *pPageMap);
+    void DetachPageMap(int fd);
+
+    // Switch to a different page replacement policy
+    RC SetReplacePolicy(PF_ReplacePolicy policy);
+
+    // Read up to numPages pages starting at pageNum into the buffer
+    // without pinning them
+    RC ReadAhead     (int fd, PageNum pageNum, int numPages,
+                      ClientHint hint = NO_HINT);
+
+    // Limit on the number of pages read ahead in one request
+    RC SetReadAhead  (int maxPages);
+    int GetReadAhead () const { return readAheadPages.load(); }
+
+    // Write a trace of the pages requested (see pf_trace.h)
+    RC StartTrace    (const char *fileName);
+    RC StopTrace     ();
+
+    // Bytes of disk space reserved at a time when a file grows
+    RC SetExtendChunk(int numBytes);
+    int GetExtendChunk() const { return extendBytes.load(); }
+
+    // Number of frames a sequential scan of one file recycles
+    int GetScanRing  () const { return scanRingPages.load(); }
+
+    // Percentage of the frames next in line for replacement that the
+    // background flusher keeps clean (0 stops it)
+    RC SetCleanTarget(int percent);
+
+    // Ask for the arena to be backed by huge pages
+    RC SetHugePages  (int bHugePages);
+
     // Three Methods for manipulating raw memory buffers.  These memory
     // locations are handled by the buffer manager, but are not
     // associated with a particular file.  These should be used if you
@@ -90,24 +288,139 @@ private:
     RC  InsertFree   (int slot);                 // Insert slot at head of free
     RC  LinkHead     (int slot);                 // Insert slot at head of used
     RC  Unlink       (int slot);                 // Unlink slot
-    RC  InternalAlloc(int &slot);                // Get a slot to use
+    void ReplaceLink (int slot, int newSlot);    // newSlot takes slot's place
+
+    // Get a slot to use, looking in shard home first.  Unless bMayWait is
+    // FALSE, waits for read-aheads and flusher writes when every frame is
+    // pinned or busy.
+    RC  InternalAlloc(int &slot, int home, int bMayWait = TRUE);
+    // Replace a page of shard s
+    RC  Replace      (int s, int &slot);
+    // Wait for the read-aheads and flusher writes in progress
+    bool WaitForFrames ();
+
+    // Get a slot for pageNum of fd fetched with hint; a SEQUENTIAL_SCAN
+    // reuses a frame of the file's scan ring when the ring is full
+    RC  AllocFor     (int fd, PageNum pageNum, ClientHint hint, int &slot,
+                      int bMayWait = TRUE);
+    // Remember that slot holds a page read by a sequential scan
+    void AddToRing   (int fd, PageNum pageNum, int slot);
+    // Frames in a scan ring for a buffer of numPages pages
+    static int RingSize (int numPages);
 
     // Read a page
     RC  ReadPage     (int fd, PageNum pageNum, char *dest);
 
+    // Wait for a read-ahead and drop the pages it could not read
+    void FinishRead  (PF_PendingRead *pRead);
+    void FinishAllReads();
+
     // Write a page
     RC  WritePage    (int fd, PageNum pageNum, char *source);
+    // Write pages in file order, coalescing adjacent pages
+    RC  WritePages   (std::vector<int> &slots, int bPinnedToo = FALSE);
+
+    // Page map of fd if its pages are compressed, else NULL
+    PF_PageMap *PageMapOf (int fd) const;
+    // Transfer a page of a compressed file
+    RC  ReadCompressed (PF_PageMap *pPageMap, int fd, PageNum pageNum,
+                        char *dest);
+    RC  WriteCompressed(PF_PageMap *pPageMap, int fd, PageNum pageNum,
+                        const char *source);
 
     // Init the page desc entry
     RC  InitPageDesc (int fd, PageNum pageNum, int slot);
 
+    // Page table partition of a page
+    PF_BufPartition &Partition (int fd, PageNum pageNum) const
+    {
+        return parts[(PF_HashTable::Mix(fd, pageNum) >> 16) %
+                     PF_BUFFER_PARTITIONS];
+    }
+    // Shard of a slot, and the shard a page is first replaced in
+    PF_BufShard &ShardOf (int slot) const
+    {
+        return shards[slot % numShards];
+    }
+    int HomeShard (int fd, PageNum pageNum) const
+    {
+        return ((PF_HashTable::Mix(fd, pageNum) >> 16) % numShards);
+    }
+    // Slots holding pages, shard by shard, most recently loaded first
+    void GetUsedSlots  (std::vector<int> &slots) const;
+    // Replacement candidates of shard s, as slots
+    int  Candidates    (int s, int *slots, int maxSlots) const;
+    // Is the page in the buffer (or being read into it)?
+    bool InBuffer      (int fd, PageNum pageNum) const;
+
+    // Wait until no read-ahead or flusher write is in progress
+    void Quiesce       ();
+
+    // Create a replacer for the given policy and buffer size
+    static PF_Replacer *NewReplacer(PF_ReplacePolicy policy, int numPages);
+    // Number of shards for a buffer of numPages frames
+    static int NumShards (int numPages);
+    // Deal out the slots to the shards for the current buffer size and
+    // rebuild their lists and replacers from the resident pages
+    void RebuildShards ();
+
+    // Wait until the flusher is done with all frames
+    void WaitAllWrites ();
+
+    // Body of the background flusher thread
+    void FlushDaemon   ();
+
+    // Page arena
+    void MapFrames     (int firstSlot, int numSlots);
+    void UnmapFrames   (int firstSlot);           // release slots >= first
+    void CompactArena  ();                        // move into one extent
+    int  SlotOf        (const char *pData) const; // slot of a frame
+
     PF_BufPageDesc *bufTable;                     // info on buffer pages
-    PF_HashTable   hashTable;                     // Hash table object
+    PF_BufPartition *parts;                       // page table partitions
     int            numPages;                      // # of pages in the buffer
     int            pageSize;                      // Size of pages in the buffer
-    int            first;                         // MRU page slot
-    int            last;                          // LRU page slot
-    int            free;                          // head of free list
+    PF_BufShard    *shards;                       // PF_BUFFER_PARTITIONS shards
+    int            numShards;                     // shards in use
+    std::atomic<int> numFree;                     // slots on the free lists
+    PF_ReplacePolicy policy;                      // replacement policy
+    std::atomic<int> readAheadPages;              // read-ahead limit
+    std::atomic<int> extendBytes;                 // file growth chunk
+    std::atomic<int> scanRingPages;               // size of a scan ring
+    std::map<int, std::deque<std::pair<int, PageNum> > >
+                   scanRings;                     // per fd: (slot, page) read
+                                                  // by scans, oldest first
+    std::mutex     ringLatch;                     // protects scanRings
+    std::atomic<long long> ringReuses;            // frames reused by scans
+    std::atomic<int> numResident;                 // pages kept resident
+    PF_IOService   *pIO;                          // does the file I/O
+    std::set<PF_PendingRead *> pendingReads;      // read-aheads in progress
+    std::mutex     readLatch;                     // protects pendingReads and
+                                                  // pIO's Submit and Wait
+    std::vector<PF_ArenaExtent> arena;            // memory of the frames
+    int            bHugePages;                    // advise huge pages
+
+    PF_PoolLatch   bufLatch;                      // protects everything above
+                                                  // (the pool latch)
+    PF_PoolLatch::Shared sharedLatch;             // bufLatch held shared
+    std::condition_variable_any writeDone;        // a flusher round finished
+    std::condition_variable_any flusherWake;      // flusher has work to do
+    std::thread    flusher;                       // background flusher
+    PF_IOService   *pFlushIO;                     // the flusher's own I/O
+    int            cleanTarget;                   // percent, 0 = no flusher
+    int            bStopFlusher;                  // tells the flusher to exit
+    int            numWriting;                    // frames being written
+    long long      flushRounds;                   // rounds that wrote pages
+    long long      flushedPages;                  // pages written by flusher
+    std::atomic<long long> dirtyEvictions;        // victims written in GetPage
+
+    std::map<int, PF_PageMap *> pageMaps;         // compressed files by fd
+    mutable std::mutex mapLatch;                  // protects pageMaps; taken
+                                                  // last, held briefly
+    std::atomic<long long> compPageBytes;         // compressed pages written,
+    std::atomic<long long> compStoredBytes;       // and the bytes they took
+
+    PF_Tracer      tracer;                        // access trace, if on
 };
 
 #endif
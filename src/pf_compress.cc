@@ -0,0 +1,402 @@
+//
+// File:        pf_compress.cc
+// Description: Page codec and PF_PageMap implementation
+//
+
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include "pf_compress.h"
+
+using namespace std;
+
+static inline uint32_t Read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return (v);
+}
+
+static inline int Hash(uint32_t v)
+{
+    return (int)((v * 2654435761u) >> (32 - PF_LZ_HASH_BITS));
+}
+
+//
+// PutSequence
+//
+// Desc: Append a sequence of litLen literals and a match of matchLen bytes
+//       at offset back (no match if matchLen is 0) to op.
+// Ret:  The end of the output, or NULL if it does not fit before oend
+//
+static unsigned char *PutSequence(unsigned char *op, unsigned char *oend,
+                                  const unsigned char *lit, int litLen,
+                                  int offset, int matchLen)
+{
+    int extraLit = litLen - 15;
+    int extraMatch = matchLen ? matchLen - PF_LZ_MIN_MATCH - 15 : -1;
+
+    // Token, length bytes, literals and offset, computed before writing
+    long need = 1 + litLen + (matchLen ? 2 : 0) +
+        (extraLit >= 0 ? extraLit / 255 + 1 : 0) +
+        (extraMatch >= 0 ? extraMatch / 255 + 1 : 0);
+    if (need > oend - op)
+        return (NULL);
+
+    *op++ = (unsigned char)(((extraLit >= 0 ? 15 : litLen) << 4) |
+        (matchLen ? (extraMatch >= 0 ? 15 : matchLen - PF_LZ_MIN_MATCH) : 0));
+    for (; extraLit >= 255; extraLit -= 255)
+        *op++ = 255;
+    if (extraLit >= 0)
+        *op++ = (unsigned char)extraLit;
+
+    memcpy(op, lit, litLen);
+    op += litLen;
+
+    if (matchLen) {
+        *op++ = (unsigned char)(offset & 0xff);
+        *op++ = (unsigned char)(offset >> 8);
+        for (; extraMatch >= 255; extraMatch -= 255)
+            *op++ = 255;
+        if (extraMatch >= 0)
+            *op++ = (unsigned char)extraMatch;
+    }
+    return (op);
+}
+
+//
+// PF_Compress
+//
+// Desc: Compress a page.  Matches are found through a hash table of the
+//       last position at which each 4-byte sequence was seen; runs of
+//       the same byte become matches at offset 1.
+// In:   src, srcLen - the data
+//       dstLen - room in dst
+// Out:  dst - compressed data
+// Ret:  compressed length, 0 if more than dstLen bytes would be needed
+//
+int PF_Compress(const char *src, int srcLen, char *dst, int dstLen)
+{
+    const unsigned char *base = (const unsigned char *)src;
+    const unsigned char *ip = base, *anchor = base;
+    const unsigned char *iend = base + srcLen;
+    unsigned char *op = (unsigned char *)dst;
+    unsigned char *oend = op + dstLen;
+    int table[1 << PF_LZ_HASH_BITS];
+
+    for (int i = 0; i < (1 << PF_LZ_HASH_BITS); i++)
+        table[i] = -1;
+
+    while (ip + PF_LZ_MIN_MATCH <= iend) {
+        uint32_t seq = Read32(ip);
+        int h = Hash(seq);
+        int cand = table[h];
+        table[h] = (int)(ip - base);
+
+        if (cand < 0 || ip - base - cand > 0xffff ||
+                Read32(base + cand) != seq) {
+            ip++;
+            continue;
+        }
+
+        const unsigned char *match = base + cand;
+        int matchLen = PF_LZ_MIN_MATCH;
+        while (ip + matchLen < iend && ip[matchLen] == match[matchLen])
+            matchLen++;
+
+        op = PutSequence(op, oend, anchor, (int)(ip - anchor),
+                         (int)(ip - match), matchLen);
+        if (op == NULL)
+            return (0);
+        ip += matchLen;
+        anchor = ip;
+    }
+
+    op = PutSequence(op, oend, anchor, (int)(iend - anchor), 0, 0);
+    if (op == NULL)
+        return (0);
+    return ((int)(op - (unsigned char *)dst));
+}
+
+//
+// GetLength
+//
+// Desc: Add the length bytes that follow a nibble of 15 to len.
+// Ret:  The input after them, or NULL if the input ends first
+//
+static const unsigned char *GetLength(const unsigned char *ip,
+                                      const unsigned char *iend, int &len)
+{
+    unsigned char b;
+    do {
+        if (ip >= iend)
+            return (NULL);
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return (ip);
+}
+
+//
+// PF_Decompress
+//
+// Desc: Undo PF_Compress.  Every length and offset is checked, so that
+//       corrupt data cannot write outside dst.
+// In:   src, srcLen - compressed data
+//       dstLen - room in dst
+// Out:  dst - the data
+// Ret:  length of the data, -1 if src is corrupt
+//
+int PF_Decompress(const char *src, int srcLen, char *dst, int dstLen)
+{
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + srcLen;
+    unsigned char *out = (unsigned char *)dst;
+    unsigned char *op = out;
+    unsigned char *oend = out + dstLen;
+
+    while (ip < iend) {
+        int token = *ip++;
+
+        int litLen = token >> 4;
+        if (litLen == 15 && (ip = GetLength(ip, iend, litLen)) == NULL)
+            return (-1);
+        if (litLen > iend - ip || litLen > oend - op)
+            return (-1);
+        memcpy(op, ip, litLen);
+        op += litLen;
+        ip += litLen;
+
+        // The last sequence has no match
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return (-1);
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op - out)
+            return (-1);
+
+        int matchLen = token & 15;
+        if (matchLen == 15 && (ip = GetLength(ip, iend, matchLen)) == NULL)
+            return (-1);
+        matchLen += PF_LZ_MIN_MATCH;
+        if (matchLen > oend - op)
+            return (-1);
+
+        // The source may overlap what is being written (offset < matchLen)
+        const unsigned char *match = op - offset;
+        if (offset >= matchLen)
+            memcpy(op, match, matchLen);
+        else
+            for (int i = 0; i < matchLen; i++)
+                op[i] = match[i];
+        op += matchLen;
+    }
+
+    return ((int)(op - out));
+}
+
+//
+// PF_PageMap
+//
+// Desc: Constructor.  The map is empty until Load.
+// In:   fileName - name of the paged file
+//       pageSize - bytes in a page of the file
+//
+PF_PageMap::PF_PageMap(const char *fileName, int _pageSize)
+{
+    mapName = string(fileName) + PF_PAGEMAP_SUFFIX;
+    pageSize = _pageSize;
+    endUnit = 0;
+    bChanged = FALSE;
+}
+
+//
+// Load
+//
+// Desc: Read the map saved by Save and work out the free units.  A file
+//       whose map was never saved has no pages stored yet.
+// Ret:  PF_UNIX if the map cannot be read
+//
+RC PF_PageMap::Load()
+{
+    lock_guard<mutex> guard(latch);
+
+    extents.clear();
+    freeUnits.clear();
+    pendingUnits.clear();
+    endUnit = 0;
+    bChanged = FALSE;
+
+    int fd = open(mapName.c_str(), O_RDONLY);
+    if (fd < 0)
+        return (errno == ENOENT ? 0 : PF_UNIX);
+
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < 0) {
+        close(fd);
+        return (PF_UNIX);
+    }
+    extents.resize(size / sizeof(PF_PageExtent));
+    ssize_t numBytes = pread(fd, extents.data(),
+                             extents.size() * sizeof(PF_PageExtent), 0);
+    close(fd);
+    if (numBytes != (ssize_t)(extents.size() * sizeof(PF_PageExtent))) {
+        extents.clear();
+        return (numBytes < 0 ? PF_UNIX : PF_HDRREAD);
+    }
+
+    // The gaps between the extents are free
+    vector<PF_PageExtent> used;
+    for (size_t i = 0; i < extents.size(); i++)
+        if (extents[i].length > 0)
+            used.push_back(extents[i]);
+    sort(used.begin(), used.end(),
+         [](const PF_PageExtent &a, const PF_PageExtent &b) {
+             return a.start < b.start;
+         });
+    for (size_t i = 0; i < used.size(); i++) {
+        if (used[i].start > endUnit)
+            freeUnits[endUnit] = used[i].start - endUnit;
+        endUnit = max(endUnit, used[i].start + Units(used[i].length));
+    }
+
+    return (0);
+}
+
+//
+// Save
+//
+// Desc: Write the map next to the paged file, if it has changed.  Once it
+//       is written, the units given up since the last Save become free.
+// Ret:  PF_UNIX or PF_HDRWRITE on failure
+//
+RC PF_PageMap::Save()
+{
+    lock_guard<mutex> guard(latch);
+
+    if (!bChanged)
+        return (0);
+
+    int fd = open(mapName.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+                  CREATION_MASK);
+    if (fd < 0)
+        return (PF_UNIX);
+    ssize_t numBytes = write(fd, extents.data(),
+                             extents.size() * sizeof(PF_PageExtent));
+    if (close(fd) < 0 || numBytes < 0)
+        return (PF_UNIX);
+    if (numBytes != (ssize_t)(extents.size() * sizeof(PF_PageExtent)))
+        return (PF_HDRWRITE);
+
+    bChanged = FALSE;
+    for (size_t i = 0; i < pendingUnits.size(); i++)
+        Release(pendingUnits[i].first, pendingUnits[i].second);
+    pendingUnits.clear();
+    return (0);
+}
+
+//
+// Lookup
+//
+// Desc: Return the extent of a page
+//
+PF_PageExtent PF_PageMap::Lookup(PageNum pageNum)
+{
+    lock_guard<mutex> guard(latch);
+
+    if (pageNum < 0 || pageNum >= (PageNum)extents.size()) {
+        PF_PageExtent none = { 0, 0 };
+        return (none);
+    }
+    return (extents[pageNum]);
+}
+
+//
+// Place
+//
+// Desc: Find room for length bytes of a page.  The page keeps its extent
+//       if that is large enough (handing back what it no longer needs);
+//       otherwise it moves to the first gap that fits or to the end.  The
+//       units it gives up are free after the next Save.  A page stored
+//       uncompressed always moves once it compresses, since the saved map
+//       would not tell to decompress it.
+// In:   pageNum - the page
+//       length - bytes to store, at most the page size
+// Ret:  the page's new extent
+//
+PF_PageExtent PF_PageMap::Place(PageNum pageNum, int length)
+{
+    lock_guard<mutex> guard(latch);
+
+    if (pageNum >= (PageNum)extents.size()) {
+        PF_PageExtent none = { 0, 0 };
+        extents.resize(pageNum + 1, none);
+    }
+    PF_PageExtent &ext = extents[pageNum];
+    int numUnits = Units(length);
+    int oldUnits = Units(ext.length);
+    bChanged = TRUE;
+
+    if (ext.length > 0 && numUnits <= oldUnits &&
+            (ext.length == pageSize) == (length == pageSize)) {
+        if (numUnits < oldUnits)
+            pendingUnits.push_back(make_pair(ext.start + numUnits,
+                                             oldUnits - numUnits));
+        ext.length = length;
+        return (ext);
+    }
+
+    if (ext.length > 0)
+        pendingUnits.push_back(make_pair(ext.start, oldUnits));
+
+    map<int, int>::iterator it = freeUnits.begin();
+    while (it != freeUnits.end() && it->second < numUnits)
+        ++it;
+    if (it != freeUnits.end()) {
+        ext.start = it->first;
+        if (it->second > numUnits)
+            freeUnits[it->first + numUnits] = it->second - numUnits;
+        freeUnits.erase(it);
+    }
+    else {
+        ext.start = endUnit;
+        endUnit += numUnits;
+    }
+    ext.length = length;
+    return (ext);
+}
+
+//
+// Release
+//
+// Desc: Internal.  Make units free, merging them with free neighbours.
+//       Free units at the end of the file are given back to endUnit.
+//       The latch must be held.
+//
+void PF_PageMap::Release(int start, int numUnits)
+{
+    map<int, int>::iterator next = freeUnits.lower_bound(start);
+    if (next != freeUnits.end() && start + numUnits == next->first) {
+        numUnits += next->second;
+        freeUnits.erase(next++);
+    }
+    if (next != freeUnits.begin()) {
+        map<int, int>::iterator prev = next;
+        --prev;
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            numUnits += prev->second;
+            freeUnits.erase(prev);
+        }
+    }
+
+    if (start + numUnits == endUnit)
+        endUnit = start;
+    else
+        freeUnits[start] = numUnits;
+}
@@ -0,0 +1,114 @@
+//
+// File:        pf_compress.h
+// Description: Compressed page storage for the PF component
+//
+// The pages of a file created with PF_Manager::CreateFile(name, TRUE) are
+// compressed by the buffer manager when it writes them out and
+// decompressed when it reads them in; clients see ordinary pages.
+//
+// The codec is a byte-oriented LZ77 in the manner of LZ4: a sequence of
+// literals followed by a copy of at least PF_LZ_MIN_MATCH bytes from up to
+// 64K back.  Each sequence starts with a token whose high nibble is the
+// number of literals and whose low nibble is the match length less
+// PF_LZ_MIN_MATCH; a nibble of 15 is followed by bytes adding to it until
+// one is below 255.  The literals come next, then the match offset in two
+// bytes (least significant first).  The last sequence has literals only.
+//
+// A stored page takes a whole number of PF_COMP_UNIT units after the file
+// header.  A PF_PageMap records which units hold each page; it is kept in
+// a file next to the paged file (fileName + PF_PAGEMAP_SUFFIX) and saved
+// when the file is flushed.
+//
+// A compressed page starts with the length of its compressed data in
+// PF_COMP_PREFIX bytes (least significant first), so that it can be read
+// back through a saved map that has not caught up with it: a page
+// rewritten in place never takes more units than before.  A page that did
+// not compress is stored as it is, and a compressed page never takes the
+// place of such a page.
+//
+
+#ifndef PF_COMPRESS_H
+#define PF_COMPRESS_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "pf_internal.h"
+
+//
+// Constants
+//
+const int PF_COMP_UNIT = 512;           // allocation unit of stored pages
+const int PF_COMP_PREFIX = 2;           // length in front of a compressed page
+const int PF_LZ_MIN_MATCH = 4;          // shortest match the codec emits
+const int PF_LZ_HASH_BITS = 12;         // log2 of the match finder's table
+#define PF_PAGEMAP_SUFFIX ".pmap"       // page map file, next to the file
+
+//
+// Compress srcLen bytes of src into dst.  Returns the compressed length,
+// or 0 if it would take more than dstLen bytes.
+//
+int PF_Compress  (const char *src, int srcLen, char *dst, int dstLen);
+
+//
+// Decompress srcLen bytes of src into dst, which has room for dstLen
+// bytes.  Returns the decompressed length, or -1 if src is corrupt.
+//
+int PF_Decompress(const char *src, int srcLen, char *dst, int dstLen);
+
+//
+// PF_PageExtent - where a page of a compressed file is kept
+//
+struct PF_PageExtent {
+    int start;          // first unit, counted from the end of the header
+    int length;         // bytes stored, prefix included: the page size if
+                        // the page did not compress, 0 if the page was
+                        // never written
+};
+
+//
+// PF_PageMap - the extents of the pages of one compressed file
+//
+// Units are allocated first fit among the gaps left by pages whose
+// compressed size changed, and else at the end of the file.  A page that
+// still fits its extent stays where it is, unless it was stored
+// uncompressed and no longer is.  Units a page gives up become
+// free only after the next Save: until then the saved map may still point
+// at them, and after a crash the page would be read from another page's
+// bytes.  The buffer manager may write
+// pages of the file from several threads; the map has its own latch.
+//
+class PF_PageMap {
+public:
+    PF_PageMap  (const char *fileName, int pageSize);
+
+    RC   Load   ();                         // read the saved map, if any
+    RC   Save   ();                         // write the map if it changed
+
+    // Extent of a page (length 0 if the page has none)
+    PF_PageExtent Lookup(PageNum pageNum);
+    // Extent for length bytes of a page; its old extent is released
+    PF_PageExtent Place (PageNum pageNum, int length);
+
+    int  PageSize() const { return pageSize; }
+
+    // Units needed for length bytes
+    static int Units (int length)
+        { return (length + PF_COMP_UNIT - 1) / PF_COMP_UNIT; }
+
+private:
+    void Release (int start, int numUnits); // units become free
+
+    std::string mapName;                    // file holding the map
+    int         pageSize;                   // bytes in a page of the file
+    std::vector<PF_PageExtent> extents;     // indexed by page number
+    std::map<int, int> freeUnits;           // free start unit -> count
+    std::vector<std::pair<int, int> > pendingUnits; // given up since the
+                                            // last Save: start, count
+    int         endUnit;                    // first unit past all extents
+    int         bChanged;                   // map differs from its file
+    std::mutex  latch;                      // protects everything above
+};
+
+#endif
@@ -25,6 +25,9 @@ static char *PF_WarnMsg[] = {
     (char*)"page already unpinned",
     (char*)"end of file",
     (char*)"attempting to resize the buffer too small",
+    (char*)"file is opened read-only",
+    (char*)"too many pages kept resident in the buffer",
+    (char*)"page size not supported or different from the buffer's",
     (char*)"invalid filename"
 };
 
@@ -38,7 +41,8 @@ static char *PF_ErrorMsg[] = {
     (char*)"new page to be allocated already in buffer",
     (char*)"hash table entry not found",
     (char*)"page already in hash table",
-    (char*)"invalid file name"
+    (char*)"invalid file name",
+    (char*)"compressed page in file is corrupt"
 };
 
 //
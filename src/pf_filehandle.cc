@@ -6,9 +6,12 @@
 //
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
+#include "pf_compress.h"
 
 //
 // PF_FileHandle
@@ -28,6 +31,11 @@ PF_FileHandle::PF_FileHandle()
     // Initialize local variables
     bFileOpen = FALSE;
     pBufferMgr = NULL;
+    freeHint = 0;
+    pMap = NULL;
+    pPageMap = NULL;
+    raLast = raEnd = -1;
+    raWindow = 0;
 }
 
 //
@@ -56,6 +64,12 @@ PF_FileHandle::PF_FileHandle(const PF_FileHandle &fileHandle)
     this->bFileOpen   = fileHandle.bFileOpen;
     this->bHdrChanged = fileHandle.bHdrChanged;
     this->unixfd      = fileHandle.unixfd;
+    this->freeHint    = fileHandle.freeHint;
+    this->pMap        = fileHandle.pMap;
+        this->pPageMap    = fileHandle.pPageMap;
+    this->raLast      = fileHandle.raLast;
+    this->raEnd       = fileHandle.raEnd;
+    this->raWindow    = fileHandle.raWindow;
 }
 
 //
@@ -78,6 +92,12 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
         this->bFileOpen   = fileHandle.bFileOpen;
         this->bHdrChanged = fileHandle.bHdrChanged;
         this->unixfd      = fileHandle.unixfd;
+        this->freeHint    = fileHandle.freeHint;
+        this->pMap        = fileHandle.pMap;
+        this->pPageMap    = fileHandle.pPageMap;
+        this->raLast      = fileHandle.raLast;
+        this->raEnd       = fileHandle.raEnd;
+        this->raWindow    = fileHandle.raWindow;
     }
 
     // Return a reference to this
@@ -89,13 +109,15 @@ PF_FileHandle& PF_FileHandle::operator= (const PF_FileHandle &fileHandle)
 //
 // Desc: Get the first page in a file
 //       The file handle must refer to an open file
+// In:   hint - how the page will be used (see GetThisPage)
 // Out:  pageHandle - becomes a handle to the first page of the file
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetFirstPage(PF_PageHandle &pageHandle,
+                               ClientHint hint) const
 {
-    return (GetNextPage((PageNum)-1, pageHandle));
+    return (GetNextPage((PageNum)-1, pageHandle, hint));
 }
 
 //
@@ -117,13 +139,20 @@ RC PF_FileHandle::GetLastPage(PF_PageHandle &pageHandle) const
 //
 // Desc: Get the next (valid) page after current
 //       The file handle must refer to an open file
+//       Pages marked free in the header bitmap are skipped without
+//       being read.
+//       Successive calls that each continue from the page returned by
+//       the previous call are treated as a sequential scan, and the
+//       pages ahead of the scan are read into the buffer in advance.
 // In:   current - get the next valid page after this page number
 //       current can refer to a page that has been disposed
+//       hint - how the page will be used (see GetThisPage)
 // Out:  pageHandle - becomes a handle to the next page of the file
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF_EOF, or another PF return code
 //
-RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle,
+                              ClientHint hint) const
 {
     int rc;               // return code
 
@@ -135,12 +164,23 @@ RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
     if (current != -1 &&  !IsValidPageNum(current))
         return (PF_INVALIDPAGE);
 
+    ReadAhead(current, hint);
+
     // Scan the file until a valid used page is found
     for (current++; current < hdr.numPages; current++) {
 
+        // Skip a whole byte of free pages at once
+        if (current % 8 == 0 && current / 8 < PF_FREEMAP_BYTES &&
+                hdr.freeMap[current / 8] == 0xFF) {
+            current += 7;
+            continue;
+        }
+
         // If this is a valid (used) page, we're done
-        if (!(rc = GetThisPage(current, pageHandle)))
+        if (!(rc = GetThisPage(current, pageHandle, hint))) {
+            raLast = current;
             return (0);
+        }
 
         // If unexpected error, return it
         if (rc != PF_INVALIDPAGE)
@@ -151,6 +191,63 @@ RC PF_FileHandle::GetNextPage(PageNum current, PF_PageHandle &pageHandle) const
     return (PF_EOF);
 }
 
+//
+// ReadAhead
+//
+// Desc: Internal.  Called by GetNextPage before fetching the page after
+//       current.  If the scan continues where the last GetNextPage left
+//       off, the pages ahead are read into the buffer with one request
+//       once the scan gets within half a window of the pages already
+//       read.  The window starts at PF_READAHEAD_MIN pages and doubles
+//       on each request up to the buffer manager's limit.  Any other
+//       access pattern resets the window.
+//       A SEQUENTIAL_SCAN reads ahead at most half of its scan ring, so
+//       that the pages read ahead are not recycled before they are used.
+// In:   current - page the scan continues from
+//       hint - passed on to the buffer manager
+//
+void PF_FileHandle::ReadAhead(PageNum current, ClientHint hint) const
+{
+    int maxPages = pBufferMgr->GetReadAhead();
+    if (hint == SEQUENTIAL_SCAN && maxPages > pBufferMgr->GetScanRing() / 2)
+        maxPages = pBufferMgr->GetScanRing() / 2;
+
+    if (maxPages <= 0 || current == -1 || current != raLast) {
+        raWindow = 0;
+        raEnd = current + 1;
+        return;
+    }
+
+    PageNum next = current + 1;
+    if (next < raEnd - raWindow / 2)
+        return;
+
+    raWindow = raWindow ? 2 * raWindow : PF_READAHEAD_MIN;
+    if (raWindow > maxPages)
+        raWindow = maxPages;
+
+    PageNum start = raEnd > next ? raEnd : next;
+    int numPages = hdr.numPages - start;
+    if (numPages > raWindow)
+        numPages = raWindow;
+    if (numPages <= 0)
+        return;
+
+    // Read-ahead is only a hint; errors show up when the page is fetched.
+    // For a mapped file the kernel is asked to do it.
+    if (pMap) {
+        long sysPageSize = sysconf(_SC_PAGESIZE);
+        size_t offset = PF_FILE_HDR_SIZE + (size_t)start * hdr.pageSize;
+        size_t aligned = offset - offset % sysPageSize;
+        madvise(pMap->pData + aligned,
+                offset - aligned + (size_t)numPages * hdr.pageSize,
+                MADV_WILLNEED);
+    }
+    else
+        pBufferMgr->ReadAhead(unixfd, start, numPages, hint);
+    raEnd = start + numPages;
+}
+
 //
 // GetPrevPage
 //
@@ -195,13 +292,19 @@ RC PF_FileHandle::GetPrevPage(PageNum current, PF_PageHandle &pageHandle) const
 //
 // Desc: Get a specific page in a file
 //       The file handle must refer to an open file
+//       A page that the header bitmap marks free is not read.
 // In:   pageNum - the number of the page to get
+//       hint - how the page will be used: pages of a SEQUENTIAL_SCAN
+//              are read into a small ring of recycled frames and do not
+//              count as uses of pages already in the buffer, KEEP_HOT
+//              pages stay in the buffer longer than other pages
 // Out:  pageHandle - becomes a handle to the this page of the file
 //                    this function modifies local var's in pageHandle
 //       The referenced page is pinned in the buffer pool.
 // Ret:  PF return code
 //
-RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
+RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle,
+                              ClientHint hint) const
 {
     int  rc;               // return code
     char *pPageBuf;        // address of page in buffer pool
@@ -211,11 +314,14 @@ RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
         return (PF_CLOSEDFILE);
 
     // Validate page number
-    if (!IsValidPageNum(pageNum))
+    if (!IsValidPageNum(pageNum) || IsFree(pageNum))
         return (PF_INVALIDPAGE);
 
+    if (pMap)
+        return (GetMappedPage(pageNum, pageHandle));
+
     // Get this page from the buffer manager
-    if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf)))
+    if ((rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf, TRUE, hint)))
         return (rc);
 
     // If the page is valid, then set pageHandle to this page and return ok
@@ -236,11 +342,40 @@ RC PF_FileHandle::GetThisPage(PageNum pageNum, PF_PageHandle &pageHandle) const
     return (PF_INVALIDPAGE);
 }
 
+//
+// GetMappedPage
+//
+// Desc: Internal.  GetThisPage for a file opened with PF_MMAP.  The page
+//       handle points straight into the mapping; the pin is only counted.
+// In:   pageNum - a valid page number
+// Out:  pageHandle - becomes a handle to the page
+// Ret:  PF_INVALIDPAGE if the page is free, 0 otherwise
+//
+RC PF_FileHandle::GetMappedPage(PageNum pageNum,
+        PF_PageHandle &pageHandle) const
+{
+    char *pPageBuf = pMap->pData + PF_FILE_HDR_SIZE +
+        (size_t)pageNum * hdr.pageSize;
+
+    if (((PF_PageHdr*)pPageBuf)->nextFree != PF_PAGE_USED)
+        return (PF_INVALIDPAGE);
+
+    if (pMap->pinCount[pageNum].fetch_add(1) == 0)
+        pMap->numPinned.fetch_add(1);
+
+    pageHandle.pageNum = pageNum;
+    pageHandle.pPageData = pPageBuf + sizeof(PF_PageHdr);
+    return (0);
+}
+
 //
 // AllocatePage
 //
 // Desc: Allocate a new page in the file (may get a page which was
 //       previously disposed)
+//       The lowest page marked free in the header bitmap is used first,
+//       then the linked free list, and only then is the file extended
+//       (disk space is reserved a chunk at a time, see ExtendFile).
 //       The file handle must refer to an open file
 // Out:  pageHandle - becomes a handle to the newly-allocated page
 //                    this function modifies local var's in pageHandle
@@ -256,8 +391,25 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
     if (!bFileOpen)
         return (PF_CLOSEDFILE);
 
+    // A mapped file cannot be changed
+    if (pMap)
+        return (PF_READONLY);
+
+    // If the bitmap knows a free page...
+    if ((pageNum = LowestFree()) != PF_PAGE_LIST_END) {
+
+        // Its old contents are not needed, so only read it if it is
+        // still in the buffer
+        rc = pBufferMgr->AllocatePage(unixfd, pageNum, &pPageBuf);
+        if (rc == PF_PAGEINBUF)
+            rc = pBufferMgr->GetPage(unixfd, pageNum, &pPageBuf);
+        if (rc)
+            return (rc);
+
+        SetFree(pageNum, FALSE);
+    }
     // If the free list isn't empty...
-    if (hdr.firstFree != PF_PAGE_LIST_END) {
+    else if (hdr.firstFree != PF_PAGE_LIST_END) {
         pageNum = hdr.firstFree;
 
         // Get the first free page into the buffer
@@ -274,6 +426,10 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
         // The free list is empty...
         pageNum = hdr.numPages;
 
+        // Past the preallocated tail, reserve the next chunk
+        if (pageNum >= hdr.allocPages)
+            ExtendFile(pageNum);
+
         // Allocate a new page in the file
         if ((rc = pBufferMgr->AllocatePage(unixfd,
                 pageNum,
@@ -291,7 +447,8 @@ RC PF_FileHandle::AllocatePage(PF_PageHandle &pageHandle)
     ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_USED;
 
     // Zero out the page data
-    memset(pPageBuf + sizeof(PF_PageHdr), 0, PF_PAGE_SIZE);
+    memset(pPageBuf + sizeof(PF_PageHdr), 0,
+           hdr.pageSize - sizeof(PF_PageHdr));
 
     // Mark the page dirty because we changed the next pointer
     if ((rc = MarkDirty(pageNum)))
@@ -328,6 +485,14 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
     if (!IsValidPageNum(pageNum))
         return (PF_INVALIDPAGE);
 
+    // A mapped file cannot be changed
+    if (pMap)
+        return (PF_READONLY);
+
+    // A page marked free in the bitmap need not be read
+    if (IsFree(pageNum))
+        return (PF_PAGEFREE);
+
     // Get the page (but don't re-pin it if it's already pinned)
     if ((rc = pBufferMgr->GetPage(unixfd,
             pageNum,
@@ -346,9 +511,16 @@ RC PF_FileHandle::DisposePage(PageNum pageNum)
         return (PF_PAGEFREE);
     }
 
-    // Put this page onto the free list
-    ((PF_PageHdr *)pPageBuf)->nextFree = hdr.firstFree;
-    hdr.firstFree = pageNum;
+    // Mark the page free in the bitmap if it covers the page, otherwise
+    // put this page onto the free list
+    if (pageNum / 8 < PF_FREEMAP_BYTES) {
+        ((PF_PageHdr *)pPageBuf)->nextFree = PF_PAGE_LIST_END;
+        SetFree(pageNum, TRUE);
+    }
+    else {
+        ((PF_PageHdr *)pPageBuf)->nextFree = hdr.firstFree;
+        hdr.firstFree = pageNum;
+    }
     bHdrChanged = TRUE;
 
     // Mark the page dirty because we changed the next pointer
@@ -383,6 +555,10 @@ RC PF_FileHandle::MarkDirty(PageNum pageNum) const
     if (!IsValidPageNum(pageNum))
         return (PF_INVALIDPAGE);
 
+    // A mapped file cannot be changed
+    if (pMap)
+        return (PF_READONLY);
+
     // Tell the buffer manager to mark the page dirty
     return (pBufferMgr->MarkDirty(unixfd, pageNum));
 }
@@ -408,10 +584,76 @@ RC PF_FileHandle::UnpinPage(PageNum pageNum) const
     if (!IsValidPageNum(pageNum))
         return (PF_INVALIDPAGE);
 
+    // Pages of a mapped file are only counted
+    if (pMap) {
+        std::atomic<short> &pinCount = pMap->pinCount[pageNum];
+        short count = pinCount.load();
+        do {
+            if (count == 0)
+                return (PF_PAGEUNPINNED);
+        } while (!pinCount.compare_exchange_weak(count, count - 1));
+        if (count == 1)
+            pMap->numPinned.fetch_sub(1);
+        return (0);
+    }
+
     // Tell the buffer manager to unpin the page
     return (pBufferMgr->UnpinPage(unixfd, pageNum));
 }
 
+//
+// KeepResident
+//
+// Desc: Keep a page pinned in the buffer pool until ReleaseResident is
+//       called for it, e.g. the upper levels of an index.  Each call pins
+//       the page once more.  Pages kept resident by all files together
+//       may use at most half of the buffer.
+//       The file handle must refer to an open file.
+// In:   pageNum - number of the page to keep
+// Ret:  PF_TOOMANYRESIDENT if half of the buffer is resident already,
+//       or another PF return code
+//
+RC PF_FileHandle::KeepResident(PageNum pageNum) const
+{
+    // File must be open
+    if (!bFileOpen)
+        return (PF_CLOSEDFILE);
+
+    // Validate page number
+    if (!IsValidPageNum(pageNum) || IsFree(pageNum))
+        return (PF_INVALIDPAGE);
+
+    // A mapped file never leaves memory
+    if (pMap)
+        return (0);
+
+    return (pBufferMgr->KeepResident(unixfd, pageNum));
+}
+
+//
+// ReleaseResident
+//
+// Desc: Undo one KeepResident of a page
+//       The file handle must refer to an open file.
+// In:   pageNum - number of the page
+// Ret:  PF return code
+//
+RC PF_FileHandle::ReleaseResident(PageNum pageNum) const
+{
+    // File must be open
+    if (!bFileOpen)
+        return (PF_CLOSEDFILE);
+
+    // Validate page number
+    if (!IsValidPageNum(pageNum))
+        return (PF_INVALIDPAGE);
+
+    if (pMap)
+        return (0);
+
+    return (pBufferMgr->ReleaseResident(unixfd, pageNum));
+}
+
 //
 // FlushPages
 //
@@ -426,21 +668,17 @@ RC PF_FileHandle::FlushPages() const
     if (!bFileOpen)
         return (PF_CLOSEDFILE);
 
+    // A mapped file has nothing to write, but pinned pages are reported
+    if (pMap)
+        return (pMap->numPinned ? PF_PAGEPINNED : 0);
+
     // If the file header has changed, write it back to the file
     if (bHdrChanged) {
 
-        // First seek to the appropriate place
-        if (lseek(unixfd, 0, L_SET) < 0)
-            return (PF_UNIX);
-
         // Write header
-        int numBytes = write(unixfd,
-                (char *)&hdr,
-                sizeof(PF_FileHdr));
-        if (numBytes < 0)
-            return (PF_UNIX);
-        if (numBytes != sizeof(PF_FileHdr))
-            return (PF_HDRWRITE);
+        RC rc;
+        if ((rc = WriteHdr()))
+            return (rc);
 
         // This function is declared const, but we need to change the
         // bHdrChanged variable.  Cast away the constness
@@ -449,7 +687,15 @@ RC PF_FileHandle::FlushPages() const
     }
 
     // Tell Buffer Manager to flush pages
-    return (pBufferMgr->FlushPages(unixfd));
+    RC rc = pBufferMgr->FlushPages(unixfd);
+
+    // The pages written may have moved
+    if (pPageMap) {
+        RC rcMap = pPageMap->Save();
+        if (!rc)
+            rc = rcMap;
+    }
+    return (rc);
 }
 
 //
@@ -468,21 +714,17 @@ RC PF_FileHandle::ForcePages(PageNum pageNum) const
     if (!bFileOpen)
         return (PF_CLOSEDFILE);
 
+    // A mapped file is never dirty
+    if (pMap)
+        return (0);
+
     // If the file header has changed, write it back to the file
     if (bHdrChanged) {
 
-        // First seek to the appropriate place
-        if (lseek(unixfd, 0, L_SET) < 0)
-            return (PF_UNIX);
-
         // Write header
-        int numBytes = write(unixfd,
-                (char *)&hdr,
-                sizeof(PF_FileHdr));
-        if (numBytes < 0)
-            return (PF_UNIX);
-        if (numBytes != sizeof(PF_FileHdr))
-            return (PF_HDRWRITE);
+        RC rc;
+        if ((rc = WriteHdr()))
+            return (rc);
 
         // This function is declared const, but we need to change the
         // bHdrChanged variable.  Cast away the constness
@@ -491,10 +733,172 @@ RC PF_FileHandle::ForcePages(PageNum pageNum) const
     }
 
     // Tell Buffer Manager to Force the page
-    return (pBufferMgr->ForcePages(unixfd, pageNum));
+    RC rc;
+    if ((rc = pBufferMgr->ForcePages(unixfd, pageNum)))
+        return (rc);
+
+    // The pages written may have moved
+    return (pPageMap ? pPageMap->Save() : 0);
 }
 
 
+//
+// GetDataSize
+//
+// Desc: Return the space for client data in each page of the file, i.e.
+//       PF_PAGE_SIZE for a file with pages of the default size
+//       The file handle must refer to an open file.
+// Out:  dataSize - number of bytes
+// Ret:  PF_CLOSEDFILE or 0
+//
+RC PF_FileHandle::GetDataSize(int &dataSize) const
+{
+    // File must be open
+    if (!bFileOpen)
+        return (PF_CLOSEDFILE);
+
+    dataSize = hdr.pageSize - sizeof(PF_PageHdr);
+    return (0);
+}
+
+//
+// ReadHdr
+//
+// Desc: Internal.  Read the file header.  The header is transferred as a
+//       whole page through an aligned buffer, so that this also works
+//       for files opened with O_DIRECT.
+// Ret:  PF_HDRREAD, PF_NOMEM or PF_UNIX on failure
+//
+RC PF_FileHandle::ReadHdr()
+{
+    char *pBuf;
+    if (posix_memalign((void **)&pBuf, PF_FILE_HDR_SIZE, PF_FILE_HDR_SIZE))
+        return (PF_NOMEM);
+
+    RC rc = 0;
+    int numBytes = pread(unixfd, pBuf, PF_FILE_HDR_SIZE, 0);
+    if (numBytes < 0)
+        rc = PF_UNIX;
+    else if (numBytes != PF_FILE_HDR_SIZE)
+        rc = PF_HDRREAD;
+    else
+        memcpy(&hdr, pBuf, sizeof(PF_FileHdr));
+
+    ::free(pBuf);
+    return (rc);
+}
+
+//
+// WriteHdr
+//
+// Desc: Internal.  Write the file header, see ReadHdr.
+// Ret:  PF_HDRWRITE, PF_NOMEM or PF_UNIX on failure
+//
+RC PF_FileHandle::WriteHdr() const
+{
+    char *pBuf;
+    if (posix_memalign((void **)&pBuf, PF_FILE_HDR_SIZE, PF_FILE_HDR_SIZE))
+        return (PF_NOMEM);
+    memset(pBuf, 0, PF_FILE_HDR_SIZE);
+    memcpy(pBuf, &hdr, sizeof(PF_FileHdr));
+
+    RC rc = 0;
+    int numBytes = pwrite(unixfd, pBuf, PF_FILE_HDR_SIZE, 0);
+    if (numBytes < 0)
+        rc = PF_UNIX;
+    else if (numBytes != PF_FILE_HDR_SIZE)
+        rc = PF_HDRWRITE;
+
+    ::free(pBuf);
+    return (rc);
+}
+
+//
+// IsFree
+//
+// Desc: Internal.  Return TRUE if the header bitmap marks pageNum free.
+//       FALSE means the page is used or not covered by the bitmap.
+// In:   pageNum - a valid page number
+//
+int PF_FileHandle::IsFree(PageNum pageNum) const
+{
+    return (pageNum / 8 < PF_FREEMAP_BYTES &&
+            (hdr.freeMap[pageNum / 8] & (1 << (pageNum % 8))) != 0);
+}
+
+//
+// SetFree
+//
+// Desc: Internal.  Set or clear the free bit of a page covered by the
+//       header bitmap, and keep freeHint at or below the lowest free bit.
+// In:   pageNum - page number less than 8 * PF_FREEMAP_BYTES
+//       bFree - TRUE to mark the page free, FALSE to mark it used
+//
+void PF_FileHandle::SetFree(PageNum pageNum, int bFree)
+{
+    if (bFree) {
+        hdr.freeMap[pageNum / 8] |= (unsigned char)(1 << (pageNum % 8));
+        if (pageNum / 8 < freeHint)
+            freeHint = pageNum / 8;
+    }
+    else
+        hdr.freeMap[pageNum / 8] &= (unsigned char)~(1 << (pageNum % 8));
+    bHdrChanged = TRUE;
+}
+
+//
+// LowestFree
+//
+// Desc: Internal.  Find the lowest page the header bitmap marks free.
+//       The search starts at freeHint and moves it past the bytes that
+//       have no free bit, so repeated allocation costs O(1) amortized.
+// Ret:  the page number, or PF_PAGE_LIST_END if there is none
+//
+PageNum PF_FileHandle::LowestFree()
+{
+    int numBytes = (hdr.numPages + 7) / 8;
+    if (numBytes > PF_FREEMAP_BYTES)
+        numBytes = PF_FREEMAP_BYTES;
+
+    for (; freeHint < numBytes; freeHint++) {
+        unsigned char bits = hdr.freeMap[freeHint];
+        if (bits)
+            return (freeHint * 8 + __builtin_ctz(bits));
+    }
+    return (PF_PAGE_LIST_END);
+}
+
+//
+// ExtendFile
+//
+// Desc: Internal.  Reserve disk space for pageNum and the pages after it,
+//       a chunk at a time (see PF_Manager::SetExtendChunk), so that the
+//       file does not grow by one page with every page appended.  This is
+//       only an optimization: if the file system cannot reserve the space,
+//       new pages are written past the end of the file as before.
+// In:   pageNum - first page past the preallocated tail
+//
+void PF_FileHandle::ExtendFile(PageNum pageNum)
+{
+    // The pages of a compressed file are not stored by page number
+    if (hdr.flags & PF_FILE_COMPRESSED)
+        return;
+
+    int numPages = pBufferMgr->GetExtendChunk() / hdr.pageSize;
+    if (numPages <= 1)
+        return;
+
+    off_t offset = PF_FILE_HDR_SIZE + (off_t)pageNum * hdr.pageSize;
+    off_t length = (off_t)numPages * hdr.pageSize;
+#ifdef __linux__
+    // Unlike posix_fallocate, never falls back to writing zeros
+    if (fallocate(unixfd, 0, offset, length) == 0)
+#else
+    if (posix_fallocate(unixfd, offset, length) == 0)
+#endif
+        hdr.allocPages = pageNum + numPages;
+}
+
 //
 // IsValidPageNum
 //
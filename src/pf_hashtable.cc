@@ -8,24 +8,38 @@
 #include "pf_internal.h"
 #include "pf_hashtable.h"
 
+//
+// CapacityFor
+//
+// Desc: Smallest power of two that keeps numEntries entries at a load
+//       factor of at most one half.
+//
+static unsigned int CapacityFor(int numEntries)
+{
+    unsigned int capacity = 16;
+    while (capacity < 2 * (unsigned int)numEntries)
+        capacity <<= 1;
+    return (capacity);
+}
+
 //
 // PF_HashTable
 //
 // Desc: Constructor for PF_HashTable object, which allows search, insert,
 //       and delete of hash table entries.
-// In:   numBuckets - number of hash table buckets
+// In:   numEntries - number of entries the table should hold without
+//                    growing (normally the number of buffer pages)
 //
-PF_HashTable::PF_HashTable(int _numBuckets)
+PF_HashTable::PF_HashTable(int _numEntries)
 {
-    // Initialize numBuckets local variable from parameter
-    this->numBuckets = _numBuckets;
-
-    // Allocate memory for hash table
-    hashTable = new PF_HashEntry* [numBuckets];
-
-    // Initialize all buckets to empty
-    for (int i = 0; i < numBuckets; i++)
-        hashTable[i] = NULL;
+    capacity = CapacityFor(_numEntries);
+    mask = capacity - 1;
+    numEntries = 0;
+
+    // Allocate memory for hash table and mark all entries empty
+    hashTable = new PF_HashEntry[capacity];
+    for (unsigned int i = 0; i < capacity; i++)
+        hashTable[i].slot = PF_HASH_EMPTY;
 }
 
 //
@@ -35,22 +49,26 @@ PF_HashTable::PF_HashTable(int _numBuckets)
 //
 PF_HashTable::~PF_HashTable()
 {
-    // Clear out all buckets
-    for (int i = 0; i < numBuckets; i++) {
-
-        // Delete all entries in the bucket
-        PF_HashEntry *entry = hashTable[i];
-        while (entry != NULL) {
-            PF_HashEntry *next = entry->next;
-            delete entry;
-            entry = next;
-        }
-    }
-
-    // Finally delete the hash table
     delete[] hashTable;
 }
 
+//
+// Probe
+//
+// Desc: Internal.  Follow the probe sequence of (fd, pageNum) until either
+//       its entry or an empty entry is found.  The table is never full,
+//       so this always terminates.
+// Ret:  index of the entry
+//
+unsigned int PF_HashTable::Probe(int fd, PageNum pageNum) const
+{
+    unsigned int i = Hash(fd, pageNum);
+    while (hashTable[i].slot != PF_HASH_EMPTY &&
+            (hashTable[i].fd != fd || hashTable[i].pageNum != pageNum))
+        i = (i + 1) & mask;
+    return (i);
+}
+
 //
 // Find
 //
@@ -60,34 +78,24 @@ PF_HashTable::~PF_HashTable()
 // Out:  slot - set to slot associated with fd and pageNum
 // Ret:  PF return code
 //
-RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
+RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot) const
 {
-    // Get which bucket it should be in
-    int bucket = Hash(fd, pageNum);
-
-    if (bucket<0)
-         return (PF_HASHNOTFOUND);
-
-    // Go through the linked list of this bucket
-    for (PF_HashEntry *entry = hashTable[bucket];
-             entry != NULL;
-             entry = entry->next) {
-        if (entry->fd == fd && entry->pageNum == pageNum) {
-
-            // Found it
-            slot = entry->slot;
-            return (0);
-        }
-    }
+    unsigned int i = Probe(fd, pageNum);
 
     // Didn't find it
-    return (PF_HASHNOTFOUND);
+    if (hashTable[i].slot == PF_HASH_EMPTY)
+        return (PF_HASHNOTFOUND);
+
+    // Found it
+    slot = hashTable[i].slot;
+    return (0);
 }
 
 //
 // Insert
 //
-// Desc: Insert a hash table entry
+// Desc: Insert a hash table entry.  The table is grown first if the new
+//       entry would make it more than half full.
 // In:   fd - file descriptor
 //       pagenum - page number
 //       slot - slot associated with fd and pageNum
@@ -95,31 +103,23 @@ RC PF_HashTable::Find(int fd, PageNum pageNum, int &slot)
 //
 RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 {
-    // Get which bucket it should be in
-    int bucket = Hash(fd, pageNum);
-
-    // Check entry doesn't already exist in the bucket
-    PF_HashEntry *entry;
-    for (entry = hashTable[bucket];
-            entry != NULL;
-            entry = entry->next) {
-        if (entry->fd == fd && entry->pageNum == pageNum)
-            return (PF_HASHPAGEEXIST);
-    }
+    RC rc;
 
-    // Allocate memory for new hash entry
-    if ((entry = new PF_HashEntry) == NULL)
-        return (PF_NOMEM);
+    // Check entry doesn't already exist
+    unsigned int i = Probe(fd, pageNum);
+    if (hashTable[i].slot != PF_HASH_EMPTY)
+        return (PF_HASHPAGEEXIST);
+
+    if (2 * (unsigned int)(numEntries + 1) > capacity) {
+        if ((rc = Rehash(capacity << 1)))
+            return (rc);
+        i = Probe(fd, pageNum);
+    }
 
-    // Insert entry at head of list for this bucket
-    entry->fd = fd;
-    entry->pageNum = pageNum;
-    entry->slot = slot;
-    entry->next = hashTable[bucket];
-    entry->prev = NULL;
-    if (hashTable[bucket] != NULL)
-        hashTable[bucket]->prev = entry;
-    hashTable[bucket] = entry;
+    hashTable[i].fd = fd;
+    hashTable[i].pageNum = pageNum;
+    hashTable[i].slot = slot;
+    numEntries++;
 
     // Return ok
     return (0);
@@ -128,40 +128,90 @@ RC PF_HashTable::Insert(int fd, PageNum pageNum, int slot)
 //
 // Delete
 //
-// Desc: Delete a hash table entry
+// Desc: Delete a hash table entry.  Entries further along the probe
+//       sequence are shifted back into the hole, so no tombstones are
+//       needed and lookups never slow down after many deletions.
 // In:   fd - file descriptor
 //       pagenum - page number
 // Ret:  PF return code
 //
 RC PF_HashTable::Delete(int fd, PageNum pageNum)
 {
-    // Get which bucket it should be in
-    int bucket = Hash(fd, pageNum);
-
-    // Find the entry is in this bucket
-    PF_HashEntry *entry;
-    for (entry = hashTable[bucket];
-            entry != NULL;
-            entry = entry->next) {
-        if (entry->fd == fd && entry->pageNum == pageNum)
-            break;
-    }
+    unsigned int hole = Probe(fd, pageNum);
 
     // Did we find hash entry?
-    if (entry == NULL)
+    if (hashTable[hole].slot == PF_HASH_EMPTY)
         return (PF_HASHNOTFOUND);
 
-    // Remove this entry
-    if (entry == hashTable[bucket])
-        hashTable[bucket] = entry->next;
-    if (entry->prev != NULL)
-        entry->prev->next = entry->next;
-    if (entry->next != NULL)
-        entry->next->prev = entry->prev;
-    delete entry;
+    unsigned int i = hole;
+    for (;;) {
+        i = (i + 1) & mask;
+        if (hashTable[i].slot == PF_HASH_EMPTY)
+            break;
+
+        // The entry at i may move into the hole only if its home bucket
+        // does not lie cyclically in (hole, i]
+        unsigned int home = Hash(hashTable[i].fd, hashTable[i].pageNum);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            hashTable[hole] = hashTable[i];
+            hole = i;
+        }
+    }
+    hashTable[hole].slot = PF_HASH_EMPTY;
+    numEntries--;
 
-    // Return ook
+    // Return ok
     return (0);
 }
 
+//
+// Resize
+//
+// Desc: Make room for numEntries entries.  Called when the buffer pool is
+//       resized.  The table never shrinks below what its current entries
+//       need.
+// In:   numEntries - expected number of entries
+// Ret:  PF return code
+//
+RC PF_HashTable::Resize(int _numEntries)
+{
+    if (_numEntries < numEntries)
+        _numEntries = numEntries;
+
+    unsigned int newCapacity = CapacityFor(_numEntries);
+    if (newCapacity == capacity)
+        return (0);
+
+    return (Rehash(newCapacity));
+}
 
+//
+// Rehash
+//
+// Desc: Internal.  Move all entries into a table of newCapacity entries.
+// In:   newCapacity - a power of two
+// Ret:  PF return code
+//
+RC PF_HashTable::Rehash(unsigned int newCapacity)
+{
+    PF_HashEntry *oldTable = hashTable;
+    unsigned int oldCapacity = capacity;
+
+    if ((hashTable = new PF_HashEntry[newCapacity]) == NULL) {
+        hashTable = oldTable;
+        return (PF_NOMEM);
+    }
+    capacity = newCapacity;
+    mask = capacity - 1;
+    for (unsigned int i = 0; i < capacity; i++)
+        hashTable[i].slot = PF_HASH_EMPTY;
+
+    for (unsigned int i = 0; i < oldCapacity; i++)
+        if (oldTable[i].slot != PF_HASH_EMPTY)
+            hashTable[Probe(oldTable[i].fd, oldTable[i].pageNum)] = oldTable[i];
+
+    delete[] oldTable;
+
+    // Return ok
+    return (0);
+}
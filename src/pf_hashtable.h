@@ -4,6 +4,10 @@
 // Authors:     Hugo Rivero (rivero@cs.stanford.edu)
 //              Dallan Quass (quass@cs.stanford.edu)
 //
+// The table uses open addressing with linear probing over a flat array
+// of entries, and grows so that it is never more than half full.  Lookups touch one or two cache lines instead of walking a chain
+// of separately allocated nodes.
+//
 
 #ifndef PF_HASHTABLE_H
 #define PF_HASHTABLE_H
@@ -11,35 +15,68 @@
 #include "pf_internal.h"
 
 //
-// HashEntry - Hash table bucket entries
+// HashEntry - Hash table entries
+//
+// An entry whose slot is PF_HASH_EMPTY is unused.  (fd cannot be used as
+// the marker since memory blocks use a negative fd.)
 //
 struct PF_HashEntry {
-        PF_HashEntry *next;   // next hash table element or NULL
-        PF_HashEntry *prev;   // prev hash table element or NULL
         int          fd;      // file descriptor
         PageNum      pageNum; // page number
         int          slot;    // slot of this page in the buffer
 };
 
+#define PF_HASH_EMPTY (-1)
+
 //
 // PF_HashTable - allow search, insertion, and deletion of hash table entries
 //
 class PF_HashTable {
 public:
-        PF_HashTable (int numBuckets);           // Constructor
+        PF_HashTable (int numEntries);           // Constructor - room for
+                                                 // numEntries entries
         ~PF_HashTable();                         // Destructor
-        RC  Find     (int fd, PageNum pageNum, int &slot);
+        RC  Find     (int fd, PageNum pageNum, int &slot) const;
                                                  // Set slot to the hash table
                                                  // entry for fd and pageNum
         RC  Insert   (int fd, PageNum pageNum, int slot);
                                                  // Insert a hash table entry
         RC  Delete   (int fd, PageNum pageNum);  // Delete a hash table entry
 
+        RC  Resize   (int numEntries);           // Make room for numEntries
+
+        // Mix all bits of the (fd, pageNum) pair so that consecutive pages
+        // of a file spread over the whole table.  The buffer manager also
+        // uses the high bits to pick a partition.
+        static unsigned int Mix (int fd, PageNum pageNum)
+        {
+            unsigned long long h = ((unsigned long long)(unsigned int)fd << 32)
+                | (unsigned int)pageNum;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ULL;
+            h ^= h >> 33;
+            return (unsigned int)h;
+        }
+
 private:
-        int Hash     (int fd, PageNum pageNum) const
-            { return ((fd + pageNum) % numBuckets); }   // Hash function
-        int numBuckets;                               // Number of hash table buckets
-        PF_HashEntry **hashTable;                     // Hash table
+        // Hash function
+        unsigned int Hash (int fd, PageNum pageNum) const
+        {
+            return Mix(fd, pageNum) & mask;
+        }
+
+        // Index of the entry for (fd, pageNum), or of the empty entry that
+        // ends its probe sequence
+        unsigned int Probe (int fd, PageNum pageNum) const;
+
+        RC  Rehash   (unsigned int newCapacity);
+
+        unsigned int capacity;                        // Number of entries (2^k)
+        unsigned int mask;                            // capacity - 1
+        int          numEntries;                      // Entries in use
+        PF_HashEntry *hashTable;                      // Hash table
 };
 
 #endif
@@ -9,19 +9,35 @@
 #ifndef PF_INTERNAL_H
 #define PF_INTERNAL_H
 
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 #include "pf.h"
 
 //
 // Constants and defines
 //
 const int PF_BUFFER_SIZE = 40;     // Number of pages in the buffer
-const int PF_HASH_TBL_SIZE = 20;   // Size of hash table
+const int PF_HASH_TBL_SIZE = 20;   // Default entries in a hash table
+const int PF_READAHEAD_PAGES = 32; // Default max pages read ahead
+const int PF_READAHEAD_MIN = 4;    // First read-ahead window
+const int PF_IO_QUEUE_DEPTH = 64;  // io_uring submission queue entries
+const int PF_IO_THREADS = 4;       // I/O threads when io_uring is not used
+const int PF_FLUSH_INTERVAL_MS = 100; // Background flusher period
+const int PF_HUGE_PAGE_SIZE = 2 * 1024 * 1024; // Arena alignment for huge pages
+const int PF_BUFFER_PARTITIONS = 16; // Page table partitions (latches)
+const int PF_SHARD_PAGES = 64;     // Fewest frames in a shard of the buffer
+const int PF_VICTIM_BATCH = 8;     // First batch of replacement candidates
+const int PF_SCAN_RING_PAGES = 16; // Frames recycled by a sequential scan
+const int PF_HOT_USAGE = 2;        // Second chances of a KEEP_HOT page
+const int PF_EXTEND_BYTES = 1 << 20; // Default chunk by which files grow
+const int PF_MAX_EXTEND_BYTES = 64 << 20; // Largest chunk
 
 #define CREATION_MASK      0600    // r/w privileges to owner only
 #define PF_PAGE_LIST_END  -1       // end of list of free pages
 #define PF_PAGE_USED      -2       // page is being used
+#define PF_FILE_COMPRESSED 1       // PF_FileHdr flag: pages are compressed
 
 // L_SET is used to indicate the "whence" argument of the lseek call
 // defined in "/usr/include/unistd.h".  A value of 0 indicates to
@@ -40,7 +56,24 @@ struct PF_PageHdr {
                         //  - PF_PAGE_USED if the page is not free
 };
 
-// Justify the file header to the length of one page
-const int PF_FILE_HDR_SIZE = PF_PAGE_SIZE + sizeof(PF_PageHdr);
+//
+// PF_FileMap: a file opened with PF_MMAP
+//
+// Shared by all copies of the file handle, like the file descriptor.  Pin
+// counts are kept only so that unpinning and closing behave as they do
+// for buffered files.  They are atomic since several threads may pin and
+// unpin pages through the same handle.
+//
+struct PF_FileMap {
+    char   *pData;                  // start of the mapping (file header)
+    size_t length;                  // bytes mapped
+    std::vector<std::atomic<short>> pinCount;   // pin count of each page
+    std::atomic<int> numPinned;     // pages with a nonzero pin count
+};
+
+// Justify the file header to the length of the smallest page
+const int PF_FILE_HDR_SIZE = PF_MIN_PAGE_BYTES;
+static_assert(sizeof(PF_FileHdr) == PF_FILE_HDR_SIZE, "PF_FileHdr layout changed");
+static_assert(sizeof(PF_PageHdr) == sizeof(int), "PF_PageHdr layout changed");
 
 #endif
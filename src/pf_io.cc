@@ -0,0 +1,390 @@
+//
+// File:        pf_io.cc
+// Description: PF_IOService implementations (thread pool and io_uring)
+//
+
+#include <cerrno>
+#include <unistd.h>
+#include <chrono>
+#include "pf_io.h"
+#include "pf_statistics.h"
+
+#ifdef PF_HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+//
+// Create
+//
+// Desc: Create the I/O service used by the buffer manager: io_uring if it
+//       was compiled in and the kernel supports it, else a thread pool.
+// Ret:  the new service
+//
+PF_IOService *PF_IOService::Create()
+{
+#ifdef PF_HAVE_IO_URING
+    PF_UringIO *pUring = new PF_UringIO(PF_IO_QUEUE_DEPTH);
+    if (pUring->IsOpen())
+        return (pUring);
+    delete pUring;
+#endif
+    return (new PF_ThreadPoolIO(PF_IO_THREADS));
+}
+
+//
+// Started, Completed
+//
+// Desc: Time a request for the latency histograms
+//
+static long long NowNanos()
+{
+    return (chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void Started(PF_IORequest &req)
+{
+    req.startNanos = NowNanos();
+}
+
+static void Completed(PF_IORequest &req)
+{
+    PF_RecordLatency(req.op == PF_IORequest::READ ? PF_READLATENCY
+                                                  : PF_WRITELATENCY,
+                     NowNanos() - req.startNanos);
+}
+
+//
+// DoIO
+//
+// Desc: Carry out a request synchronously with preadv/pwritev.
+//
+static void DoIO(PF_IORequest &req)
+{
+    ssize_t n;
+    do {
+        if (req.op == PF_IORequest::READ)
+            n = preadv(req.fd, req.iov.data(), (int)req.iov.size(), req.offset);
+        else
+            n = pwritev(req.fd, req.iov.data(), (int)req.iov.size(), req.offset);
+    } while (n < 0 && errno == EINTR);
+
+    req.result = n < 0 ? -errno : n;
+}
+
+//
+// Execute
+//
+// Desc: Carry out the request synchronously.  A single request gains
+//       nothing from a trip through the workers or the ring, and doing it
+//       in the calling thread lets any number of threads read pages at
+//       the same time.
+// Ret:  0; the outcome is in req.result
+//
+RC PF_IOService::Execute(PF_IORequest &req)
+{
+    Started(req);
+    DoIO(req);
+    Completed(req);
+    req.bDone = TRUE;
+    return (0);
+}
+
+//------------------------------------------------------------------------------
+// PF_ThreadPoolIO
+//------------------------------------------------------------------------------
+
+PF_ThreadPoolIO::PF_ThreadPoolIO(int numThreads)
+{
+    bStop = false;
+    for (int i = 0; i < numThreads; i++)
+        threads.push_back(thread(&PF_ThreadPoolIO::Worker, this));
+}
+
+//
+// ~PF_ThreadPoolIO
+//
+// Desc: Destructor.  Requests already submitted are still carried out.
+//
+PF_ThreadPoolIO::~PF_ThreadPoolIO()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        bStop = true;
+    }
+    workReady.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+RC PF_ThreadPoolIO::Submit(PF_IORequest &req)
+{
+    req.bDone = FALSE;
+    Started(req);
+    {
+        lock_guard<std::mutex> lock(mutex);
+        queue.push_back(&req);
+    }
+    workReady.notify_one();
+    return (0);
+}
+
+void PF_ThreadPoolIO::Wait(PF_IORequest &req)
+{
+    unique_lock<std::mutex> lock(mutex);
+    while (!req.bDone)
+        workDone.wait(lock);
+}
+
+void PF_ThreadPoolIO::Worker()
+{
+    unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        while (queue.empty() && !bStop)
+            workReady.wait(lock);
+        if (queue.empty())
+            return;
+
+        PF_IORequest *pReq = queue.front();
+        queue.pop_front();
+
+        lock.unlock();
+        DoIO(*pReq);
+        Completed(*pReq);
+        lock.lock();
+
+        pReq->bDone = TRUE;
+        workDone.notify_all();
+    }
+}
+
+#ifdef PF_HAVE_IO_URING
+
+//------------------------------------------------------------------------------
+// PF_UringIO
+//
+// The ring is used directly through the io_uring_setup and io_uring_enter
+// system calls, so liburing is not needed.
+//------------------------------------------------------------------------------
+
+//
+// PF_UringIO
+//
+// Desc: Constructor.  Sets up a ring with the given number of submission
+//       entries.  If that fails IsOpen() returns false.
+//
+PF_UringIO::PF_UringIO(unsigned entries)
+{
+    struct io_uring_params params;
+
+    sqRing = cqRing = MAP_FAILED;
+    sqes = (struct io_uring_sqe *)MAP_FAILED;
+
+    memset(&params, 0, sizeof(params));
+    ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ringFd < 0)
+        return;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (cqRingSize > sqRingSize)
+            sqRingSize = cqRingSize;
+        cqRingSize = sqRingSize;
+    }
+
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        cqRing = sqRing;
+    else
+        cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe *)mmap(NULL, sqesSize,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ringFd, IORING_OFF_SQES);
+
+    if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+        Close();
+        return;
+    }
+
+    char *sq = (char *)sqRing;
+    sqHead    = (unsigned *)(sq + params.sq_off.head);
+    sqTail    = (unsigned *)(sq + params.sq_off.tail);
+    sqMask    = (unsigned *)(sq + params.sq_off.ring_mask);
+    sqEntries = (unsigned *)(sq + params.sq_off.ring_entries);
+    sqArray   = (unsigned *)(sq + params.sq_off.array);
+
+    char *cq = (char *)cqRing;
+    cqHead    = (unsigned *)(cq + params.cq_off.head);
+    cqTail    = (unsigned *)(cq + params.cq_off.tail);
+    cqMask    = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes      = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    cqEntries = params.cq_entries;
+}
+
+//
+// ~PF_UringIO
+//
+// Desc: Destructor.  Waits for the requests in flight, then tears down
+//       the ring.
+//
+PF_UringIO::~PF_UringIO()
+{
+    while (!inFlight.empty())
+        Reap(true);
+
+    Close();
+}
+
+void PF_UringIO::Close()
+{
+    if (sqes != MAP_FAILED)
+        munmap(sqes, sqesSize);
+    if (cqRing != MAP_FAILED && cqRing != sqRing)
+        munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+        munmap(sqRing, sqRingSize);
+    if (ringFd >= 0)
+        close(ringFd);
+
+    ringFd = -1;
+    sqRing = cqRing = MAP_FAILED;
+    sqes = (struct io_uring_sqe *)MAP_FAILED;
+}
+
+//
+// Submit
+//
+// Desc: Queue the request and hand it to the kernel.  If the ring is
+//       full, completions are collected first.  Once the ring has failed
+//       (see Fail) requests are carried out right away instead.
+// Ret:  PF_UNIX if the kernel rejects the submission
+//
+RC PF_UringIO::Submit(PF_IORequest &req)
+{
+    req.bDone = FALSE;
+
+    // Never have more requests in flight than the completion queue holds
+    while (IsOpen() && (inFlight.size() >= cqEntries ||
+            *sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= *sqEntries))
+        Reap(true);
+    if (!IsOpen())
+        return (Execute(req));
+    Started(req);
+
+    unsigned tail = *sqTail;
+    unsigned index = tail & *sqMask;
+    struct io_uring_sqe *sqe = &sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req.op == PF_IORequest::READ ? IORING_OP_READV
+                                               : IORING_OP_WRITEV;
+    sqe->fd = req.fd;
+    sqe->off = (unsigned long long)req.offset;
+    sqe->addr = (unsigned long long)(unsigned long)req.iov.data();
+    sqe->len = (unsigned)req.iov.size();
+    sqe->user_data = (unsigned long long)(unsigned long)&req;
+
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    int n;
+    do {
+        n = (int)syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, NULL, 0);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        // Take the entry back; the kernel has not consumed it
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        return (PF_UNIX);
+    }
+
+    inFlight.push_back(&req);
+    return (0);
+}
+
+//
+// Wait
+//
+// Desc: Collect completions until req is done
+//
+void PF_UringIO::Wait(PF_IORequest &req)
+{
+    while (!req.bDone)
+        Reap(true);
+}
+
+//
+// Reap
+//
+// Desc: Internal.  Mark every request on the completion queue done.  If
+//       bBlock is set and nothing has completed yet, wait for at least
+//       one completion.  If the kernel cannot be asked for completions
+//       the ring is given up (see Fail).
+// Ret:  -errno if waiting failed, otherwise 0
+//
+int PF_UringIO::Reap(bool bBlock)
+{
+    if (!IsOpen())
+        return (-EBADF);
+
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+    while (head == tail && bBlock) {
+        if (syscall(__NR_io_uring_enter, ringFd, 0, 1,
+                    IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+                errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            int err = -errno;
+            Fail(err);
+            return (err);
+        }
+        tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    }
+
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+        PF_IORequest *pReq = (PF_IORequest *)(unsigned long)cqe->user_data;
+        pReq->result = cqe->res;
+        Completed(*pReq);
+        pReq->bDone = TRUE;
+
+        // There are at most PF_IO_QUEUE_DEPTH requests in flight
+        for (size_t i = 0; i < inFlight.size(); i++)
+            if (inFlight[i] == pReq) {
+                inFlight[i] = inFlight.back();
+                inFlight.pop_back();
+                break;
+            }
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return (0);
+}
+
+//
+// Fail
+//
+// Desc: Internal.  Close the ring, so that the kernel cancels the requests
+//       it still holds and lets go of their buffers, then complete those
+//       requests with err.  Later requests are carried out synchronously.
+//
+void PF_UringIO::Fail(int err)
+{
+    Close();
+
+    for (size_t i = 0; i < inFlight.size(); i++) {
+        inFlight[i]->result = err;
+        Completed(*inFlight[i]);
+        inFlight[i]->bDone = TRUE;
+    }
+    inFlight.clear();
+}
+
+#endif
@@ -0,0 +1,146 @@
+//
+// File:        pf_io.h
+// Description: PF_IOService class interface
+//
+// The buffer manager does its file I/O through a PF_IOService.  A request
+// is submitted and later completed; any number of requests may be in
+// flight at once, so a read-ahead can proceed while the caller keeps
+// working on pages that are already in the buffer.
+//
+// Two implementations are provided.  PF_UringIO uses Linux io_uring and
+// is compiled in when PF_HAVE_IO_URING is defined (the CMake build checks
+// for <linux/io_uring.h>).  PF_ThreadPoolIO hands requests to a small
+// pool of threads that call preadv/pwritev, and is used when io_uring is
+// not compiled in or the kernel refuses to set up a ring.
+//
+// A PF_IOService is driven by a single thread (the buffer manager's);
+// only the work itself happens elsewhere.
+//
+// Every request is timed from submission to completion for the latency
+// histograms of pf_statistics.h.
+//
+
+#ifndef PF_IO_H
+#define PF_IO_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef PF_HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+#include "pf_internal.h"
+
+//
+// PF_IORequest - one vectored read or write at a file offset
+//
+// The caller owns the request and the buffers it points to, and must keep
+// them alive until the request has completed.
+//
+struct PF_IORequest {
+    enum Op { READ, WRITE };
+
+    Op      op;
+    int     fd;
+    off_t   offset;
+    std::vector<struct iovec> iov;
+
+    ssize_t result;             // bytes transferred, or -errno
+    int     bDone;              // set once the request has completed
+    long long startNanos;       // when it was submitted, for the statistics
+
+    PF_IORequest () : op(READ), fd(-1), offset(0), result(0), bDone(FALSE),
+                      startNanos(0) {}
+};
+
+//
+// PF_IOService - submit and complete I/O requests
+//
+class PF_IOService {
+public:
+    virtual ~PF_IOService () {}
+
+    // Start the request.  Returns PF_UNIX if it cannot be queued.
+    virtual RC   Submit (PF_IORequest &req) = 0;
+
+    // Block until the request has completed
+    virtual void Wait   (PF_IORequest &req) = 0;
+
+    // Carry out the request in the calling thread and return when it has
+    // completed.  Unlike Submit and Wait this may be called from several
+    // threads at once.
+    RC           Execute(PF_IORequest &req);
+
+    virtual const char *Name() const = 0;
+
+    // Create the best service available on this system
+    static PF_IOService *Create ();
+};
+
+//
+// PF_ThreadPoolIO - requests are carried out by worker threads
+//
+class PF_ThreadPoolIO : public PF_IOService {
+public:
+    PF_ThreadPoolIO  (int numThreads);
+    ~PF_ThreadPoolIO ();
+
+    RC   Submit (PF_IORequest &req);
+    void Wait   (PF_IORequest &req);
+
+    const char *Name() const { return "threads"; }
+
+private:
+    void Worker ();
+
+    std::vector<std::thread>  threads;
+    std::deque<PF_IORequest *> queue;             // submitted, not started
+    std::mutex                mutex;
+    std::condition_variable   workReady;          // queue not empty or stop
+    std::condition_variable   workDone;           // some request completed
+    bool                      bStop;
+};
+
+#ifdef PF_HAVE_IO_URING
+
+//
+// PF_UringIO - requests go through an io_uring submission queue
+//
+class PF_UringIO : public PF_IOService {
+public:
+    PF_UringIO  (unsigned entries);
+    ~PF_UringIO ();
+
+    bool IsOpen () const { return ringFd >= 0; }
+
+    RC   Submit (PF_IORequest &req);
+    void Wait   (PF_IORequest &req);
+
+    const char *Name() const { return "io_uring"; }
+
+private:
+    int  Reap   (bool bBlock);                    // collect completions
+    void Fail   (int err);                        // give up on the ring
+    void Close  ();                               // unmap and close ring
+
+    int       ringFd;
+    std::vector<PF_IORequest *> inFlight;         // submitted, not reaped
+    unsigned  cqEntries;
+
+    void      *sqRing, *cqRing;                   // mapped rings
+    size_t    sqRingSize, cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t    sqesSize;
+
+    unsigned  *sqHead, *sqTail, *sqMask, *sqEntries, *sqArray;
+    unsigned  *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe *cqes;
+};
+
+#endif
+
+#endif
@@ -6,12 +6,16 @@
 //
 
 #include <cstdio>
+#include <cerrno>
+#include <algorithm>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include "pf_internal.h"
 #include "pf_buffermgr.h"
+#include "pf_compress.h"
 
 //
 // PF_Manager
@@ -25,6 +29,7 @@ PF_Manager::PF_Manager()
 {
     // Create Buffer Manager
     pBufferMgr = new PF_BufferMgr(PF_BUFFER_SIZE);
+    bDirectIO = FALSE;
 }
 
 //
@@ -43,11 +48,14 @@ PF_Manager::~PF_Manager()
 //
 // CreateFile
 //
-// Desc: Create a new PF file named fileName
+// Desc: Create a new PF file named fileName.  The pages of a compressed
+//       file are compressed whenever they are written to disk, and take
+//       up only the PF_COMP_UNIT units they need (see pf_compress.h).
 // In:   fileName - name of file to create
+//       bCompress - TRUE to store the pages compressed
 // Ret:  PF return code
 //
-RC PF_Manager::CreateFile (const char *fileName)
+RC PF_Manager::CreateFile (const char *fileName, int bCompress)
 {
     int fd;     // unix file descriptor
     int numBytes;       // return code form write syscall
@@ -71,6 +79,9 @@ RC PF_Manager::CreateFile (const char *fileName)
     PF_FileHdr *hdr = (PF_FileHdr*)hdrBuf;
     hdr->firstFree = PF_PAGE_LIST_END;
     hdr->numPages = 0;
+    hdr->allocPages = 0;
+    hdr->flags = bCompress ? PF_FILE_COMPRESSED : 0;
+    hdr->pageSize = pBufferMgr->GetPageSize();
 
     // Write header to file
     if((numBytes = write(fd, hdrBuf, PF_FILE_HDR_SIZE))
@@ -108,6 +119,16 @@ RC PF_Manager::DestroyFile (const char *fileName)
     if (unlink(fileName) < 0)
         return (PF_UNIX);
 
+    // and the page map of a compressed file
+    unlink((std::string(fileName) + PF_PAGEMAP_SUFFIX).c_str());
+
+    // Its pages are not worth reading in again
+    std::string name(fileName);
+    warmPages.erase(std::remove_if(warmPages.begin(), warmPages.end(),
+        [&name](const std::pair<std::string, PageNum> &entry) {
+            return entry.first == name;
+        }), warmPages.end());
+
     // Return ok
     return (0);
 }
@@ -122,14 +143,23 @@ RC PF_Manager::DestroyFile (const char *fileName)
 //       circumstances, crash the PF layer. Note that even if only one instance
 //       of a file is for writing, problems may occur because some writes may
 //       not be seen by a reader of another instance of the file.
+//       With mode PF_MMAP the file is opened read-only and mapped into
+//       memory; its pages are then not read through the buffer.
+//       Otherwise the file is opened with O_DIRECT if SetDirectIO asked
+//       for it and the file system allows it, and its pages must have the
+//       size of the buffer's pages.  Compressed files are never mapped
+//       nor read with O_DIRECT; the buffer manager is given their page
+//       map.
 // In:   fileName - name of file to open
+//       mode - PF_READWRITE (default) or PF_MMAP
 // Out:  fileHandle - refer to the open file
 //                    this function modifies local var's in fileHandle
 //       to point to the file data in the file table, and to point to the
 //       buffer manager object
-// Ret:  PF_FILEOPEN or other PF return code
+// Ret:  PF_FILEOPEN, PF_BADPAGESIZE or other PF return code
 //
-RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
+RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle,
+        PF_OpenMode mode)
 {
     int rc;                   // return code
 
@@ -138,30 +168,99 @@ RC PF_Manager::OpenFile (const char *fileName, PF_FileHandle &fileHandle)
         return (PF_FILEOPEN);
 
     // Open the file
-    if ((fileHandle.unixfd = open(fileName,
+    fileHandle.unixfd = -1;
+#ifdef O_DIRECT
+    if (bDirectIO && mode != PF_MMAP)
+        fileHandle.unixfd = open(fileName, O_RDWR | O_DIRECT);
+#endif
+    if (fileHandle.unixfd < 0 && (fileHandle.unixfd = open(fileName,
 #ifdef PC
             O_BINARY |
 #endif
-            O_RDWR)) < 0)
+            (mode == PF_MMAP ? O_RDONLY : O_RDWR))) < 0)
         return (PF_UNIX);
 
     // Read the file header
-    {
-        int numBytes = read(fileHandle.unixfd, (char *)&fileHandle.hdr,
-                sizeof(PF_FileHdr));
-        if (numBytes != sizeof(PF_FileHdr)) {
-            rc = (numBytes < 0) ? PF_UNIX : PF_HDRREAD;
+    if ((rc = fileHandle.ReadHdr()))
+        goto err;
+
+    // Set file header to be not changed
+    fileHandle.bHdrChanged = FALSE;
+
+    // Files that do not record their page size have 4K pages
+    if (fileHandle.hdr.pageSize == 0)
+        fileHandle.hdr.pageSize = PF_MIN_PAGE_BYTES;
+
+    // Nor do they record a preallocated tail
+    if (fileHandle.hdr.allocPages < fileHandle.hdr.numPages)
+        fileHandle.hdr.allocPages = fileHandle.hdr.numPages;
+
+    // Compressed pages are read through the buffer, at unaligned offsets
+    if (fileHandle.hdr.flags & PF_FILE_COMPRESSED) {
+        if (mode == PF_MMAP) {
+            mode = PF_READWRITE;
+            close(fileHandle.unixfd);
+            if ((fileHandle.unixfd = open(fileName, O_RDWR)) < 0)
+                return (PF_UNIX);
+        }
+#ifdef O_DIRECT
+        fcntl(fileHandle.unixfd, F_SETFL,
+              fcntl(fileHandle.unixfd, F_GETFL) & ~O_DIRECT);
+#endif
+    }
+    if (mode != PF_MMAP &&
+            fileHandle.hdr.pageSize != pBufferMgr->GetPageSize()) {
+        rc = PF_BADPAGESIZE;
+        goto err;
+    }
+
+    // Map the pages if asked to
+    fileHandle.pMap = NULL;
+    if (mode == PF_MMAP) {
+        PF_FileMap *pMap = new PF_FileMap;
+        pMap->length = PF_FILE_HDR_SIZE +
+            (size_t)fileHandle.hdr.numPages * fileHandle.hdr.pageSize;
+        pMap->pData = (char *)mmap(NULL, pMap->length, PROT_READ,
+                                   MAP_SHARED, fileHandle.unixfd, 0);
+        if (pMap->pData == (char *)MAP_FAILED) {
+            delete pMap;
+            rc = PF_UNIX;
             goto err;
         }
+        pMap->pinCount = std::vector<std::atomic<short>>(fileHandle.hdr.numPages);
+        pMap->numPinned = 0;
+        fileHandle.pMap = pMap;
     }
 
-    // Set file header to be not changed
-    fileHandle.bHdrChanged = FALSE;
+    // Load the page map of a compressed file
+    fileHandle.pPageMap = NULL;
+    if (fileHandle.hdr.flags & PF_FILE_COMPRESSED) {
+        PF_PageMap *pPageMap =
+            new PF_PageMap(fileName, fileHandle.hdr.pageSize);
+        if ((rc = pPageMap->Load())) {
+            delete pPageMap;
+            goto err;
+        }
+        pBufferMgr->AttachPageMap(fileHandle.unixfd, pPageMap);
+        fileHandle.pPageMap = pPageMap;
+    }
+
+    // Any free page may be the lowest
+    fileHandle.freeHint = 0;
+
+    // No sequential access seen yet
+    fileHandle.raLast = fileHandle.raEnd = -1;
+    fileHandle.raWindow = 0;
 
     // Set local variables in file handle object to refer to open file
     fileHandle.pBufferMgr = pBufferMgr;
     fileHandle.bFileOpen = TRUE;
 
+    // Read in the pages remembered from before, the first time
+    fileNames[fileHandle.unixfd] = fileName;
+    if (!fileHandle.pMap)
+        StartWarmUp(fileName, fileHandle.unixfd);
+
     // Return ok
     return 0;
 
@@ -194,11 +293,29 @@ RC PF_Manager::CloseFile(PF_FileHandle &fileHandle)
     if (!fileHandle.bFileOpen)
         return (PF_CLOSEDFILE);
 
-    // Flush all buffers for this file and write out the header
+    // Remember the pages in the buffer, then flush all buffers for this
+    // file and write out the header
+    if (!fileHandle.pMap)
+        RecordWarmUp(fileHandle.unixfd);
     if ((rc = fileHandle.FlushPages()))
         return (rc);
 
+    // Remove the mapping
+    if (fileHandle.pMap) {
+        munmap(fileHandle.pMap->pData, fileHandle.pMap->length);
+        delete fileHandle.pMap;
+        fileHandle.pMap = NULL;
+    }
+
+    // The buffer holds no more pages of the file; drop its page map
+    if (fileHandle.pPageMap) {
+        pBufferMgr->DetachPageMap(fileHandle.unixfd);
+        delete fileHandle.pPageMap;
+        fileHandle.pPageMap = NULL;
+    }
+
     // Close the file
+    fileNames.erase(fileHandle.unixfd);
     if (close(fileHandle.unixfd) < 0)
         return (PF_UNIX);
     fileHandle.bFileOpen = FALSE;
@@ -258,6 +375,300 @@ RC PF_Manager::ResizeBuffer(int iNewSize)
     return pBufferMgr->ResizeBuffer(iNewSize);
 }
 
+//
+// SetHugePages
+//
+// Desc: Ask for the buffer pool memory to be backed by huge pages.  This
+//       is advice to the kernel (transparent huge pages).
+// In:   bHugePages - TRUE or FALSE
+// Ret:  Returns the result of PF_BufferMgr::SetHugePages
+//
+RC PF_Manager::SetHugePages(int bHugePages)
+{
+    return pBufferMgr->SetHugePages(bHugePages);
+}
+
+//
+// SetDirectIO
+//
+// Desc: Open files with O_DIRECT from now on, bypassing the OS page cache
+//       so that pages are not cached twice.  Files that are already open
+//       are not affected.  If the file system refuses O_DIRECT the file
+//       is opened normally.
+// In:   bDirectIO - TRUE or FALSE
+// Ret:  0
+//
+RC PF_Manager::SetDirectIO(int bDirectIO)
+{
+    this->bDirectIO = bDirectIO;
+    return (0);
+}
+
+//
+// SaveWarmUp
+//
+// Desc: Write the list of remembered pages (see RecordWarmUp), least
+//       recently used first, one "fileName pageNum" per line.  Pages of
+//       files that are still open are not in it.
+// In:   listName - file to write the list to
+// Ret:  PF_UNIX on failure
+//
+RC PF_Manager::SaveWarmUp(const char *listName)
+{
+    FILE *fp = fopen(listName, "w");
+    if (fp == NULL)
+        return (PF_UNIX);
+
+    for (size_t i = 0; i < warmPages.size(); i++)
+        fprintf(fp, "%s %d\n", warmPages[i].first.c_str(), warmPages[i].second);
+
+    if (fclose(fp) != 0)
+        return (PF_UNIX);
+    return (0);
+}
+
+//
+// LoadWarmUp
+//
+// Desc: Read a list written by SaveWarmUp, keeping the most recently used
+//       pages that fit in the buffer.  The pages of each file are read
+//       ahead the first time the file is opened from now on.  A missing
+//       list is an empty one.
+// In:   listName - file to read the list from
+// Ret:  PF_UNIX if the list cannot be read
+//
+RC PF_Manager::LoadWarmUp(const char *listName)
+{
+    warmPages.clear();
+    warmedFiles.clear();
+
+    FILE *fp = fopen(listName, "r");
+    if (fp == NULL)
+        return (errno == ENOENT ? 0 : PF_UNIX);
+
+    char    name[MAXSTRINGLEN + 1];
+    PageNum pageNum;
+    while (fscanf(fp, "%255s %d", name, &pageNum) == 2)
+        warmPages.push_back(std::make_pair(std::string(name), pageNum));
+    fclose(fp);
+
+    size_t maxPages = pBufferMgr->GetNumPages();
+    if (warmPages.size() > maxPages)
+        warmPages.erase(warmPages.begin(),
+                        warmPages.end() - maxPages);
+    return (0);
+}
+
+//
+// RecordWarmUp
+//
+// Desc: Internal.  Replace the remembered pages of a file by the pages it
+//       has in the buffer as it is being closed; they become the most
+//       recently used.  No more pages than fit in the buffer are kept.
+// In:   fd - the file being closed
+//
+void PF_Manager::RecordWarmUp(int fd)
+{
+    std::map<int, std::string>::iterator it = fileNames.find(fd);
+    if (it == fileNames.end())
+        return;
+    const std::string &name = it->second;
+
+    std::vector<PageNum> pages;
+    pBufferMgr->GetResidentPages(fd, pages);
+
+    warmPages.erase(std::remove_if(warmPages.begin(), warmPages.end(),
+        [&name](const std::pair<std::string, PageNum> &entry) {
+            return entry.first == name;
+        }), warmPages.end());
+    for (size_t i = 0; i < pages.size(); i++)
+        warmPages.push_back(std::make_pair(name, pages[i]));
+
+    size_t maxPages = pBufferMgr->GetNumPages();
+    if (warmPages.size() > maxPages)
+        warmPages.erase(warmPages.begin(),
+                        warmPages.end() - maxPages);
+}
+
+//
+// StartWarmUp
+//
+// Desc: Internal.  The first time a file is opened after LoadWarmUp, read
+//       its remembered pages ahead.  Only the first open is warmed up:
+//       the list describes the buffer before the restart.
+// In:   fileName - name of the file being opened
+//       fd - its descriptor
+//
+void PF_Manager::StartWarmUp(const char *fileName, int fd)
+{
+    if (!warmedFiles.insert(fileName).second)
+        return;
+
+    std::vector<PageNum> pages;
+    for (size_t i = 0; i < warmPages.size(); i++)
+        if (warmPages[i].first == fileName)
+            pages.push_back(warmPages[i].second);
+    if (!pages.empty())
+        pBufferMgr->WarmUp(fd, pages);
+}
+
+//
+// SetPageSize
+//
+// Desc: Choose the size of the pages of the files created from now on.
+//       Only files with pages of this size can be opened (other than with
+//       PF_MMAP), since the buffer holds pages of one size.  The buffer
+//       keeps its number of pages; its contents are written out and
+//       dropped.  Typically called once a database has been chosen.
+// In:   pageSize - a power of two from PF_MIN_PAGE_BYTES to
+//                  PF_MAX_PAGE_BYTES
+// Ret:  PF_BADPAGESIZE, PF_PAGEPINNED if a page is pinned in the buffer,
+//       or other PF return code
+//
+RC PF_Manager::SetPageSize(int pageSize)
+{
+    if (pageSize < PF_MIN_PAGE_BYTES || pageSize > PF_MAX_PAGE_BYTES ||
+            (pageSize & (pageSize - 1)))
+        return (PF_BADPAGESIZE);
+
+    return pBufferMgr->SetPageSize(pageSize);
+}
+
+//
+// GetPageSize
+//
+// Desc: Return the size of the pages in the buffer, see SetPageSize
+// Out:  pageSize - bytes per page, page header included
+// Ret:  0
+//
+RC PF_Manager::GetPageSize(int &pageSize) const
+{
+    pageSize = pBufferMgr->GetPageSize();
+    return (0);
+}
+
+//
+// GetDataSize
+//
+// Desc: Return the space for client data in pages of the current size,
+//       i.e. PF_PAGE_SIZE for pages of the default size
+// Out:  dataSize - number of bytes
+// Ret:  0
+//
+RC PF_Manager::GetDataSize(int &dataSize) const
+{
+    dataSize = pBufferMgr->GetPageSize() - sizeof(PF_PageHdr);
+    return (0);
+}
+
+//
+// GetFilePageSize
+//
+// Desc: Read the page size from the header of a file that is not open,
+//       e.g. to call SetPageSize before opening the file
+// In:   fileName - name of the file
+// Out:  pageSize - bytes per page, page header included
+// Ret:  PF_HDRREAD or PF_UNIX on failure
+//
+RC PF_Manager::GetFilePageSize(const char *fileName, int &pageSize) const
+{
+    int        fd;
+    PF_FileHdr hdr;
+
+    if ((fd = open(fileName, O_RDONLY)) < 0)
+        return (PF_UNIX);
+
+    int numBytes = pread(fd, &hdr, sizeof(PF_FileHdr), 0);
+    close(fd);
+    if (numBytes < 0)
+        return (PF_UNIX);
+    if (numBytes != sizeof(PF_FileHdr))
+        return (PF_HDRREAD);
+
+    pageSize = hdr.pageSize ? hdr.pageSize : PF_MIN_PAGE_BYTES;
+    return (0);
+}
+
+//
+// SetReplacePolicy
+//
+// Desc: Select the policy used to choose which page to replace when the
+//       buffer is full.  Pages already in the buffer stay there.
+// In:   policy - PF_LRU or PF_2Q
+// Ret:  Returns the result of PF_BufferMgr::SetReplacePolicy
+//
+RC PF_Manager::SetReplacePolicy(PF_ReplacePolicy policy)
+{
+    return pBufferMgr->SetReplacePolicy(policy);
+}
+
+//
+// SetReadAhead
+//
+// Desc: Set the largest number of pages that a sequential scan through
+//       PF_FileHandle::GetNextPage reads ahead in one request.
+// In:   maxPages - page limit, 0 to disable read-ahead
+// Ret:  Returns the result of PF_BufferMgr::SetReadAhead
+//
+RC PF_Manager::SetReadAhead(int maxPages)
+{
+    return pBufferMgr->SetReadAhead(maxPages);
+}
+
+//
+// SetCleanTarget
+//
+// Desc: Start or stop writing dirty pages in the background.  A thread
+//       writes the dirty unpinned pages among the next percent% of the
+//       buffer to be replaced, so that GetPage rarely has to write a page
+//       before it can reuse its frame.
+// In:   percent - 0 to 100, 0 to stop background writes
+// Ret:  Returns the result of PF_BufferMgr::SetCleanTarget
+//
+RC PF_Manager::SetCleanTarget(int percent)
+{
+    return pBufferMgr->SetCleanTarget(percent);
+}
+
+//
+// SetExtendChunk
+//
+// Desc: Set how much disk space is reserved at once when a file runs out
+//       of pages.  Fewer, larger extensions keep bulk loads from growing
+//       the file (and the file system's block maps) one page at a time.
+// In:   numBytes - 0 to PF_MAX_EXTEND_BYTES, 0 to grow files page by page
+// Ret:  Returns the result of PF_BufferMgr::SetExtendChunk
+//
+RC PF_Manager::SetExtendChunk(int numBytes)
+{
+    return pBufferMgr->SetExtendChunk(numBytes);
+}
+
+//
+// StartTrace
+//
+// Desc: Record every page requested from the buffer, allocated in it or
+//       marked dirty, and every file whose pages are dropped, in a trace
+//       file that pf_replay can replay against other buffer sizes
+// In:   fileName - trace file, replaced if it exists
+// Ret:  Returns the result of PF_BufferMgr::StartTrace
+//
+RC PF_Manager::StartTrace(const char *fileName)
+{
+    return pBufferMgr->StartTrace(fileName);
+}
+
+//
+// StopTrace
+//
+// Desc: Finish the trace file
+// Ret:  Returns the result of PF_BufferMgr::StopTrace
+//
+RC PF_Manager::StopTrace()
+{
+    return pBufferMgr->StopTrace();
+}
+
 //------------------------------------------------------------------------------
 // Three Methods for manipulating raw memory buffers.  These memory
 // locations are handled by the buffer manager, but are not
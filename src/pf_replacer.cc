@@ -0,0 +1,299 @@
+//
+// File:        pf_replacer.cc
+// Description: PF_Replacer implementations (LRU and 2Q)
+//
+
+#include "pf_replacer.h"
+#include "pf_buffermgr.h"
+
+//------------------------------------------------------------------------------
+// PF_SlotList
+//------------------------------------------------------------------------------
+
+PF_SlotList::PF_SlotList()
+{
+    next = prev = NULL;
+    onList = NULL;
+    head = tail = INVALID_SLOT;
+    size = 0;
+}
+
+PF_SlotList::~PF_SlotList()
+{
+    delete [] next;
+    delete [] prev;
+    delete [] onList;
+}
+
+//
+// Init
+//
+// Desc: Allocate the link arrays for numSlots slots.  The list is empty.
+//
+void PF_SlotList::Init(int numSlots)
+{
+    next = new int[numSlots];
+    prev = new int[numSlots];
+    onList = new bool[numSlots];
+    for (int i = 0; i < numSlots; i++) {
+        next[i] = prev[i] = INVALID_SLOT;
+        onList[i] = false;
+    }
+    head = tail = INVALID_SLOT;
+    size = 0;
+}
+
+//
+// PushHead
+//
+// Desc: Insert slot at the head of the list.  The slot must not already
+//       be on the list.
+//
+void PF_SlotList::PushHead(int slot)
+{
+    next[slot] = head;
+    prev[slot] = INVALID_SLOT;
+    if (head != INVALID_SLOT)
+        prev[head] = slot;
+    head = slot;
+    if (tail == INVALID_SLOT)
+        tail = slot;
+    onList[slot] = true;
+    size++;
+}
+
+//
+// Erase
+//
+// Desc: Remove slot from the list.  Does nothing if it is not on the list.
+//
+void PF_SlotList::Erase(int slot)
+{
+    if (!onList[slot])
+        return;
+
+    if (head == slot)
+        head = next[slot];
+    if (tail == slot)
+        tail = prev[slot];
+    if (next[slot] != INVALID_SLOT)
+        prev[next[slot]] = prev[slot];
+    if (prev[slot] != INVALID_SLOT)
+        next[prev[slot]] = next[slot];
+
+    next[slot] = prev[slot] = INVALID_SLOT;
+    onList[slot] = false;
+    size--;
+}
+
+//------------------------------------------------------------------------------
+// PF_LRUReplacer
+//------------------------------------------------------------------------------
+
+PF_LRUReplacer::PF_LRUReplacer(int numPages)
+{
+    lru.Init(numPages);
+}
+
+PF_LRUReplacer::~PF_LRUReplacer()
+{
+}
+
+void PF_LRUReplacer::Admit(int slot, int fd, PageNum pageNum)
+{
+    lru.PushHead(slot);
+}
+
+bool PF_LRUReplacer::Reference(int slot, bool bHot)
+{
+    lru.Erase(slot);
+    lru.PushHead(slot);
+    return (true);
+}
+
+void PF_LRUReplacer::Evict(int slot)
+{
+    lru.Erase(slot);
+}
+
+void PF_LRUReplacer::Remove(int slot)
+{
+    lru.Erase(slot);
+}
+
+void PF_LRUReplacer::Skip(int slot)
+{
+    lru.Erase(slot);
+    lru.PushHead(slot);
+}
+
+int PF_LRUReplacer::Candidates(int *slots, int max) const
+{
+    int n = 0;
+    for (int slot = lru.Tail(); slot != INVALID_SLOT && n < max;
+            slot = lru.Prev(slot))
+        slots[n++] = slot;
+    return (n);
+}
+
+//------------------------------------------------------------------------------
+// PF_2QReplacer
+//------------------------------------------------------------------------------
+
+//
+// PF_2QReplacer
+//
+// Desc: Constructor.  Uses the sizes suggested by the 2Q paper: A1in holds
+//       a quarter of the pool and A1out remembers half a pool's worth of
+//       page ids.
+// In:   numPages - the number of pages in the buffer
+//
+PF_2QReplacer::PF_2QReplacer(int numPages)
+{
+    a1in.Init(numPages);
+    am.Init(numPages);
+    queue = new Queue[numPages];
+    keys = new long long[numPages];
+    for (int i = 0; i < numPages; i++)
+        queue[i] = Q_NONE;
+
+    numA1in = 0;
+    kin = numPages / 4 > 0 ? numPages / 4 : 1;
+    kout = numPages / 2 > 0 ? numPages / 2 : 1;
+    seq = 0;
+}
+
+PF_2QReplacer::~PF_2QReplacer()
+{
+    delete [] queue;
+    delete [] keys;
+}
+
+//
+// Admit
+//
+// Desc: A page was read into slot.  It goes straight to Am if it was
+//       recently evicted from A1in, otherwise it starts out in A1in.
+//
+void PF_2QReplacer::Admit(int slot, int fd, PageNum pageNum)
+{
+    keys[slot] = Key(fd, pageNum);
+
+    std::unordered_map<long long, long long>::iterator it =
+        a1out.find(keys[slot]);
+    if (it != a1out.end()) {
+        a1out.erase(it);
+        queue[slot] = Q_AM;
+        am.PushHead(slot);
+    }
+    else {
+        queue[slot] = Q_A1IN;
+        a1in.PushHead(slot);
+        numA1in++;
+    }
+}
+
+//
+// Reference
+//
+// Desc: A page of Am that was used goes back to the head of Am.  Uses of
+//       a page while it is in A1in are considered correlated and do not
+//       keep it, unless the page is to be kept hot: it moves to Am then.
+//
+bool PF_2QReplacer::Reference(int slot, bool bHot)
+{
+    if (queue[slot] == Q_A1IN && bHot) {
+        a1in.Erase(slot);
+        numA1in--;
+        queue[slot] = Q_AM;
+    }
+    else if (queue[slot] == Q_AM)
+        am.Erase(slot);
+    else
+        return (false);
+    am.PushHead(slot);
+    return (true);
+}
+
+//
+// Evict
+//
+// Desc: Pages replaced from A1in are remembered in A1out.
+//
+void PF_2QReplacer::Evict(int slot)
+{
+    if (queue[slot] == Q_A1IN)
+        RememberA1(keys[slot]);
+    Forget(slot);
+}
+
+void PF_2QReplacer::Remove(int slot)
+{
+    Forget(slot);
+}
+
+//
+// Skip
+//
+// Desc: A pinned page goes to the head of the queue it is in; it is not
+//       promoted to Am.
+//
+void PF_2QReplacer::Skip(int slot)
+{
+    if (queue[slot] == Q_A1IN) {
+        a1in.Erase(slot);
+        a1in.PushHead(slot);
+    }
+    else if (queue[slot] == Q_AM) {
+        am.Erase(slot);
+        am.PushHead(slot);
+    }
+}
+
+//
+// Candidates
+//
+// Desc: Replace from A1in while it is over its target size, then the LRU
+//       pages of Am, then the rest of A1in.
+//
+int PF_2QReplacer::Candidates(int *slots, int max) const
+{
+    int n = 0;
+    int slot = a1in.Tail();
+
+    for (int excess = numA1in - kin; slot != INVALID_SLOT && n < max &&
+            excess > 0; slot = a1in.Prev(slot), excess--)
+        slots[n++] = slot;
+    for (int s = am.Tail(); s != INVALID_SLOT && n < max; s = am.Prev(s))
+        slots[n++] = s;
+    for (; slot != INVALID_SLOT && n < max; slot = a1in.Prev(slot))
+        slots[n++] = slot;
+
+    return (n);
+}
+
+void PF_2QReplacer::Forget(int slot)
+{
+    if (queue[slot] == Q_A1IN) {
+        a1in.Erase(slot);
+        numA1in--;
+    }
+    else if (queue[slot] == Q_AM)
+        am.Erase(slot);
+    queue[slot] = Q_NONE;
+}
+
+void PF_2QReplacer::RememberA1(long long key)
+{
+    a1out[key] = ++seq;
+    a1outFifo.push_back(std::make_pair(key, seq));
+
+    // Trim A1out to kout entries, oldest first
+    while ((int)a1outFifo.size() > kout) {
+        std::unordered_map<long long, long long>::iterator it =
+            a1out.find(a1outFifo.front().first);
+        if (it != a1out.end() && it->second == a1outFifo.front().second)
+            a1out.erase(it);
+        a1outFifo.pop_front();
+    }
+}
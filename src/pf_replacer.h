@@ -0,0 +1,160 @@
+//
+// File:        pf_replacer.h
+// Description: PF_Replacer class interface
+//
+// The buffer manager delegates the choice of a victim frame to a
+// PF_Replacer.  A replacer tracks every resident frame and only orders
+// them; whether a frame can actually be replaced (it is not pinned or
+// being read) is decided by the buffer manager.
+//
+// Pinning a page does not go through the replacer, so that a buffer hit
+// only needs the latch of its page table partition.  A hit sets the
+// frame's reference bit instead, and the replacer looks at the
+// bit when the frame comes up as a candidate (second chance).
+//
+
+#ifndef PF_REPLACER_H
+#define PF_REPLACER_H
+
+#include <deque>
+#include <unordered_map>
+#include "pf_internal.h"
+
+//
+// PF_Replacer - replacement policy interface used by PF_BufferMgr
+//
+// The buffer manager reports the following events for each slot:
+//   Admit     - a page was just brought into the slot
+//   Reference - the page was used since it was last a candidate; bHot if
+//               the client asked for it to be kept (KEEP_HOT).  Returns
+//               true if the policy keeps the page for that reason (it has
+//               then moved away from the victim end).
+//   Evict     - the page was replaced
+//   Remove    - the page left the pool without being replaced
+//   Skip      - the page came up as a candidate but is pinned.  It moves
+//               away from the victim end of its queue, so that the next
+//               candidates do not start with the same pinned pages.
+//
+// All calls are made with the buffer manager's pool latch held.
+//
+class PF_Replacer {
+public:
+    virtual ~PF_Replacer () {}
+
+    virtual void Admit     (int slot, int fd, PageNum pageNum) = 0;
+    virtual bool Reference (int slot, bool bHot) = 0;
+    virtual void Evict     (int slot) = 0;
+    virtual void Remove    (int slot) = 0;
+    virtual void Skip      (int slot) = 0;
+
+    // Fill slots with up to max slots in the order they should be
+    // considered for replacement.  Returns the count.
+    virtual int  Candidates (int *slots, int max) const = 0;
+
+    virtual const char *Name() const = 0;
+};
+
+//
+// PF_SlotList - intrusive doubly-linked list of slots
+//
+// Every slot is on at most one list at a time.  The links are kept in
+// arrays indexed by slot so that no allocation is needed while the buffer
+// manager runs.
+//
+class PF_SlotList {
+public:
+    PF_SlotList  ();
+    ~PF_SlotList ();
+
+    void Init       (int numSlots);
+
+    void PushHead   (int slot);
+    void Erase      (int slot);
+    int  Tail       () const { return tail; }
+    int  Prev       (int slot) const { return prev[slot]; }
+    int  Size       () const { return size; }
+    bool Contains   (int slot) const { return onList[slot]; }
+
+private:
+    int  *next;
+    int  *prev;
+    bool *onList;
+    int  head;
+    int  tail;
+    int  size;
+};
+
+//
+// PF_LRUReplacer - classic least-recently-used replacement
+//
+// Pages are ordered by the time they were loaded or, if they were used
+// again, by the time they were last found to have been used (CLOCK-style
+// approximation of LRU).
+//
+class PF_LRUReplacer : public PF_Replacer {
+public:
+    PF_LRUReplacer  (int numPages);
+    ~PF_LRUReplacer ();
+
+    void Admit     (int slot, int fd, PageNum pageNum);
+    bool Reference (int slot, bool bHot);
+    void Evict     (int slot);
+    void Remove    (int slot);
+    void Skip      (int slot);
+    int  Candidates (int *slots, int max) const;
+
+    const char *Name() const { return "LRU"; }
+
+private:
+    PF_SlotList lru;                              // resident, MRU at head
+};
+
+//
+// PF_2QReplacer - scan-resistant "2Q" replacement (Johnson & Shasha)
+//
+// Pages referenced for the first time go to the A1in queue, which holds at
+// most about a quarter of the pool.  Pages evicted from A1in are remembered
+// (by id only) in the A1out ghost queue.  A page that is requested again
+// while its id is still in A1out is considered hot and goes to the Am
+// queue, which is managed as LRU.  A sequential scan therefore only cycles
+// through A1in and never pushes hot pages out of Am.
+//
+class PF_2QReplacer : public PF_Replacer {
+public:
+    PF_2QReplacer  (int numPages);
+    ~PF_2QReplacer ();
+
+    void Admit     (int slot, int fd, PageNum pageNum);
+    bool Reference (int slot, bool bHot);
+    void Evict     (int slot);
+    void Remove    (int slot);
+    void Skip      (int slot);
+    int  Candidates (int *slots, int max) const;
+
+    const char *Name() const { return "2Q"; }
+
+private:
+    enum Queue { Q_NONE, Q_A1IN, Q_AM };
+
+    static long long Key(int fd, PageNum pageNum)
+        { return ((long long)fd << 32) | (unsigned int)pageNum; }
+
+    void Forget     (int slot);                   // drop slot from its queue
+    void RememberA1 (long long key);              // push key onto A1out
+
+    PF_SlotList a1in;                             // pages of A1in
+    PF_SlotList am;                               // pages of Am
+    Queue       *queue;                           // queue of each slot
+    long long   *keys;                            // page id of each slot
+    int         numA1in;                          // resident pages in A1in
+    int         kin;                              // target size of A1in
+    int         kout;                             // size of A1out
+
+    // A1out ghost queue.  Each id is tagged with a sequence number so that
+    // a stale FIFO entry never removes a newer entry for the same page.
+    std::deque<std::pair<long long, long long> > a1outFifo;
+    std::unordered_map<long long, long long>     a1out;
+    long long   seq;
+};
+
+#endif
@@ -0,0 +1,288 @@
+//
+// File:        pf_replay.cpp
+// Description: Replay a buffer access trace against simulated buffers
+//
+// Usage: pf_replay traceFile [numPages ...]
+//
+// The trace is written by the buffer manager (PF_Manager::StartTrace, or
+// "set buffer_trace" in redbase).  Every buffer size given, by default
+// sizes doubling from PF_BUFFER_SIZE/2 until every page of the trace fits,
+// is simulated under each replacement policy.  The hit ratio of GetPage
+// and the number of dirty pages written on replacement are printed for
+// each, so that the size of the buffer can be chosen from the curve.
+//
+// The simulation uses the replacers of the buffer manager and gives pages
+// their second chance the way PF_BufferMgr::InternalAlloc does.  Pages
+// are never pinned in the simulation, and read-ahead is not simulated.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "pf_internal.h"
+#include "pf_replacer.h"
+#include "pf_trace.h"
+
+using namespace std;
+
+//
+// SimBuffer - the frames of a simulated buffer
+//
+class SimBuffer {
+public:
+    SimBuffer  (PF_ReplacePolicy policy, int numPages);
+    ~SimBuffer ();
+
+    void Replay (const PF_TraceRecord &rec);
+
+    long long numGets;              // GetPage requests
+    long long numHits;              //   found in the buffer
+    long long numWrites;            // dirty pages replaced
+
+private:
+    struct Frame {
+        int     fd;
+        PageNum pageNum;
+        bool    bUsed;              // referenced since last a candidate
+        bool    bDirty;
+    };
+
+    static long long Key(int fd, PageNum pageNum)
+        { return ((long long)fd << 32) | (unsigned int)pageNum; }
+
+    int  Access (int fd, PageNum pageNum, bool bNew);
+    int  Victim ();
+    void Drop   (int fd);
+
+    PF_Replacer *replacer;
+    std::vector<Frame> frames;
+    std::vector<int> freeSlots;
+    std::vector<int> victims;
+    std::unordered_map<long long, int> slots;       // page -> slot
+};
+
+SimBuffer::SimBuffer(PF_ReplacePolicy policy, int numPages)
+    : numGets(0), numHits(0), numWrites(0), frames(numPages)
+{
+    if (policy == PF_2Q)
+        replacer = new PF_2QReplacer(numPages);
+    else
+        replacer = new PF_LRUReplacer(numPages);
+    for (int slot = numPages - 1; slot >= 0; slot--)
+        freeSlots.push_back(slot);
+}
+
+SimBuffer::~SimBuffer()
+{
+    delete replacer;
+}
+
+void SimBuffer::Replay(const PF_TraceRecord &rec)
+{
+    int slot;
+
+    switch (rec.Op()) {
+    case PF_TRACE_GET:
+        numGets++;
+        Access(rec.fd, rec.pageNum, false);
+        break;
+    case PF_TRACE_ALLOC:
+        slot = Access(rec.fd, rec.pageNum, true);
+        frames[slot].bDirty = true;
+        break;
+    case PF_TRACE_DIRTY:
+        if (slots.count(Key(rec.fd, rec.pageNum)))
+            frames[slots[Key(rec.fd, rec.pageNum)]].bDirty = true;
+        break;
+    case PF_TRACE_DROP:
+        Drop(rec.fd);
+        break;
+    }
+}
+
+//
+// Access
+//
+// Find the page in the buffer or bring it in.  Returns its slot.
+//
+int SimBuffer::Access(int fd, PageNum pageNum, bool bNew)
+{
+    unordered_map<long long, int>::iterator it = slots.find(Key(fd, pageNum));
+    if (it != slots.end()) {
+        if (!bNew)
+            numHits++;
+        frames[it->second].bUsed = true;
+        return (it->second);
+    }
+
+    int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    else
+        slot = Victim();
+
+    Frame &frame = frames[slot];
+    frame.fd = fd;
+    frame.pageNum = pageNum;
+    frame.bUsed = false;
+    frame.bDirty = false;
+    slots[Key(fd, pageNum)] = slot;
+    replacer->Admit(slot, fd, pageNum);
+    return (slot);
+}
+
+//
+// Victim
+//
+// Replace a page.  A page used since it was last a candidate gets a
+// second chance if the replacer wants, as in InternalAlloc.
+//
+int SimBuffer::Victim()
+{
+    for (;;) {
+        victims.resize(PF_VICTIM_BATCH);
+        int numCand = replacer->Candidates(victims.data(), PF_VICTIM_BATCH);
+        for (int i = 0; i < numCand; i++) {
+            int slot = victims[i];
+            Frame &frame = frames[slot];
+            if (frame.bUsed) {
+                frame.bUsed = false;
+                if (replacer->Reference(slot, false))
+                    continue;
+            }
+            if (frame.bDirty)
+                numWrites++;
+            slots.erase(Key(frame.fd, frame.pageNum));
+            replacer->Evict(slot);
+            return (slot);
+        }
+    }
+}
+
+//
+// Drop
+//
+// The pages of fd (of every file if fd is -1) leave the buffer
+//
+void SimBuffer::Drop(int fd)
+{
+    for (int slot = 0; slot < (int)frames.size(); slot++) {
+        unordered_map<long long, int>::iterator it =
+            slots.find(Key(frames[slot].fd, frames[slot].pageNum));
+        if (it == slots.end() || it->second != slot ||
+                (fd != -1 && frames[slot].fd != fd))
+            continue;
+        slots.erase(it);
+        replacer->Remove(slot);
+        freeSlots.push_back(slot);
+    }
+}
+
+//
+// ReadTrace
+//
+// Read the whole trace into memory
+//
+static bool ReadTrace(const char *fileName, PF_TraceHdr &hdr,
+                      vector<PF_TraceRecord> &records)
+{
+    FILE *fp = fopen(fileName, "rb");
+    if (fp == NULL) {
+        perror(fileName);
+        return (false);
+    }
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            memcmp(hdr.magic, PF_TRACE_MAGIC, sizeof(hdr.magic)) != 0) {
+        cerr << fileName << " is not a buffer trace\n";
+        fclose(fp);
+        return (false);
+    }
+
+    PF_TraceRecord rec;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1)
+        records.push_back(rec);
+    fclose(fp);
+    return (true);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " traceFile [numPages ...]\n";
+        exit(1);
+    }
+
+    PF_TraceHdr hdr;
+    vector<PF_TraceRecord> records;
+    if (!ReadTrace(argv[1], hdr, records))
+        exit(1);
+
+    // Distinct pages, counted per file descriptor
+    long long numGets = 0, numDirty = 0;
+    unordered_set<long long> pages;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (records[i].Op() == PF_TRACE_GET)
+            numGets++;
+        else if (records[i].Op() == PF_TRACE_DIRTY)
+            numDirty++;
+        if (records[i].Op() != PF_TRACE_DROP)
+            pages.insert(((long long)records[i].fd << 32) |
+                         (unsigned int)records[i].pageNum);
+    }
+
+    cout << records.size() << " records over "
+        << (records.empty() ? 0 : records.back().Micros() / 1000)
+        << " ms: " << numGets << " GetPage, " << numDirty
+        << " MarkDirty, " << pages.size() << " distinct pages.\n";
+    cout << "Captured with " << hdr.numPages << " pages of "
+        << hdr.pageSize << " bytes.\n";
+
+    vector<int> sizes;
+    for (int i = 2; i < argc; i++) {
+        int numPages = atoi(argv[i]);
+        if (numPages <= 0) {
+            cerr << argv[i] << " is not a number of pages\n";
+            exit(1);
+        }
+        sizes.push_back(numPages);
+    }
+    if (sizes.empty()) {
+        int numPages = PF_BUFFER_SIZE / 2;
+        do {
+            sizes.push_back(numPages);
+            numPages *= 2;
+        } while (sizes.back() < (long long)pages.size());
+    }
+
+    const PF_ReplacePolicy policies[] = { PF_LRU, PF_2Q };
+    const char *names[] = { "LRU", "2Q" };
+    const int numPolicies = 2;
+
+    cout << setw(10) << "pages" << setw(10) << "MB";
+    for (int p = 0; p < numPolicies; p++)
+        cout << setw(9) << names[p] << " hit%" << setw(9) << "writes";
+    cout << "\n";
+
+    for (size_t s = 0; s < sizes.size(); s++) {
+        cout << setw(10) << sizes[s] << setw(10) << fixed << setprecision(1)
+            << (double)sizes[s] * hdr.pageSize / (1024 * 1024);
+        for (int p = 0; p < numPolicies; p++) {
+            SimBuffer sim(policies[p], sizes[s]);
+            for (size_t i = 0; i < records.size(); i++)
+                sim.Replay(records[i]);
+            cout << setw(14) << setprecision(2)
+                << (sim.numGets ? 100.0 * sim.numHits / sim.numGets : 0.0)
+                << setw(9) << sim.numWrites;
+        }
+        cout << "\n";
+    }
+
+    return (0);
+}
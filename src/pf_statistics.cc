@@ -7,57 +7,146 @@
 
 // Code written by Andre Bergholz, who was the TA for 2000
 
-//
-// This file only makes sense when the PF Statistics layer is defined
-//
-#ifdef PF_STATS
+// The statistics are kept in always-on counters and latency histograms
+// (see pf_statistics.h).
 
 #include <iostream>
-#include "pf.h"
-#include "statistics.h"
+#include "pf_statistics.h"
 
 using namespace std;
 
-// This is defined within pf_buffermgr.cc
-extern StatisticsMgr *pStatisticsMgr;
+PF_StatShard pfStatShards[PF_STAT_SHARDS];
 
-void PF_Statistics()
+static atomic<int> nextShard(0);
+
+// A latency histogram
+struct PF_LatencyHist {
+    atomic<long long> bucket[PF_LATENCY_BUCKETS];
+    atomic<long long> totalNanos;
+};
+
+static PF_LatencyHist latencies[PF_NUM_LATENCIES];
+
+static const char *latencyNames[PF_NUM_LATENCIES] = { "Reads", "Writes" };
+
+//
+// PF_NewStatShard
+//
+// Desc: Hand out the shards in turn to the threads that count
+//
+int PF_NewStatShard()
+{
+    return (nextShard++ % PF_STAT_SHARDS);
+}
+
+//
+// PF_GetCounter
+//
+// Desc: Sum the shards of a counter
+//
+long long PF_GetCounter(PF_Counter counter)
+{
+    long long sum = 0;
+    for (int i = 0; i < PF_STAT_SHARDS; i++)
+        sum += pfStatShards[i].value[counter].load(memory_order_relaxed);
+    return (sum);
+}
+
+//
+// PF_RecordLatency
+//
+// Desc: Add a request to a histogram.  Bucket 0 holds requests that took
+//       under a microsecond, bucket i those that took from 2^(i-1) up to
+//       2^i microseconds, and the last bucket everything longer.
+//
+void PF_RecordLatency(PF_Latency which, long long nanos)
+{
+    unsigned long long micros = nanos > 0 ? nanos / 1000 : 0;
+    int b = micros ? 64 - __builtin_clzll(micros) : 0;
+    if (b >= PF_LATENCY_BUCKETS)
+        b = PF_LATENCY_BUCKETS - 1;
+
+    latencies[which].bucket[b].fetch_add(1, memory_order_relaxed);
+    latencies[which].totalNanos.fetch_add(nanos, memory_order_relaxed);
+}
+
+//
+// PF_PrintLatency
+//
+// Desc: Print the number of requests timed, their mean latency and the
+//       bucket bound that 99% of them stay under
+//
+void PF_PrintLatency(PF_Latency which)
 {
-    // First get all the statistics, must remember to delete memory returned
-    int *piGP = pStatisticsMgr->Get(PF_GETPAGE);
-    int *piPF = pStatisticsMgr->Get(PF_PAGEFOUND);
-    int *piPNF = pStatisticsMgr->Get(PF_PAGENOTFOUND);
-    int *piRP = pStatisticsMgr->Get(PF_READPAGE);
-    int *piWP = pStatisticsMgr->Get(PF_WRITEPAGE);
-    int *piFP = pStatisticsMgr->Get(PF_FLUSHPAGES);
+    long long counts[PF_LATENCY_BUCKETS];
+    long long numRequests = 0;
+    for (int b = 0; b < PF_LATENCY_BUCKETS; b++) {
+        counts[b] = latencies[which].bucket[b].load(memory_order_relaxed);
+        numRequests += counts[b];
+    }
 
+    cout << latencyNames[which] << ": " << numRequests << " requests";
+    if (numRequests > 0) {
+        long long seen = 0;
+        int b = 0;
+        while ((seen += counts[b]) * 100 < numRequests * 99)
+            b++;
+        cout << ", mean "
+            << latencies[which].totalNanos.load(memory_order_relaxed) /
+               numRequests / 1000
+            << " us, 99% under ";
+        if (b == PF_LATENCY_BUCKETS - 1)
+            cout << "(more than " << (1LL << (b - 1)) << ")";
+        else
+            cout << (1LL << b);
+        cout << " us";
+    }
+    cout << ".\n";
+}
+
+void PF_Statistics()
+{
     cout << "PF Layer Statistics\n";
     cout << "-------------------\n";
 
-    cout << "Total number of calls to GetPage Routine: ";
-    if (piGP) cout << *piGP; else cout << "None";
-    cout << "\n  Number found: ";
-    if (piPF) cout << *piPF; else cout << "None";
-    cout << "\n  Number not found: ";
-    if (piPNF) cout << *piPNF; else cout << "None";
+    cout << "Total number of calls to GetPage Routine: "
+        << PF_GetCounter(PF_GETPAGE);
+    cout << "\n  Number found: " << PF_GetCounter(PF_PAGEFOUND);
+    cout << "\n  Number not found: " << PF_GetCounter(PF_PAGENOTFOUND);
     cout << "\n-------------------\n";
 
-    cout << "Number of read requests: ";
-    if (piRP) cout << *piRP; else cout << "None";
-    cout << "\nNumber of write requests: ";
-    if (piWP) cout << *piWP; else cout << "None";
+    cout << "Number of read requests: " << PF_GetCounter(PF_READPAGE);
+    cout << "\n  Pages read ahead: " << PF_GetCounter(PF_READAHEAD);
+    cout << "\nNumber of write requests: " << PF_GetCounter(PF_WRITEPAGE);
     cout << "\n-------------------\n";
-    cout << "Number of flushes: ";
-    if (piFP) cout << *piFP; else cout << "None";
+    cout << "Number of flushes: " << PF_GetCounter(PF_FLUSHPAGES);
     cout << "\n-------------------\n";
 
-    // Must delete the memory returned from StatisticsMgr::Get
-    delete piGP;
-    delete piPF;
-    delete piPNF;
-    delete piRP;
-    delete piWP;
-    delete piFP;
+    // The histograms, without the empty buckets
+    for (int l = 0; l < PF_NUM_LATENCIES; l++) {
+        PF_PrintLatency((PF_Latency)l);
+        for (int b = 0; b < PF_LATENCY_BUCKETS; b++) {
+            long long n = latencies[l].bucket[b].load(memory_order_relaxed);
+            if (n == 0)
+                continue;
+            if (b == PF_LATENCY_BUCKETS - 1)
+                cout << "  longer: ";
+            else
+                cout << "  under " << (1LL << b) << " us: ";
+            cout << n << "\n";
+        }
+    }
+    cout << "-------------------\n";
 }
 
-#endif
+void PF_ResetStatistics()
+{
+    for (int i = 0; i < PF_STAT_SHARDS; i++)
+        for (int c = 0; c < PF_NUM_COUNTERS; c++)
+            pfStatShards[i].value[c].store(0, memory_order_relaxed);
+    for (int l = 0; l < PF_NUM_LATENCIES; l++) {
+        for (int b = 0; b < PF_LATENCY_BUCKETS; b++)
+            latencies[l].bucket[b].store(0, memory_order_relaxed);
+        latencies[l].totalNanos.store(0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,76 @@
+//
+// File:        pf_statistics.h
+// Description: Counters and I/O latency histograms of the PF component
+//
+// Each counter is named by a PF_Counter fixed at compile time.  It is
+// kept in PF_STAT_SHARDS relaxed atomics, one per cache line: a thread
+// adds to the shard it was given when it first counted, and reading the
+// counter sums the shards.  Counting is thus a single uncontended add and
+// is always on.
+//
+// The I/O service records how long every read and write request took in
+// a histogram with power-of-two buckets.
+//
+// PRINT IO shows everything (PF_Statistics), RESET IO starts again from
+// zero (PF_ResetStatistics) and PRINT BUFFER shows a summary.
+//
+
+#ifndef PF_STATISTICS_H
+#define PF_STATISTICS_H
+
+#include <atomic>
+
+//
+// PF_Counter - what is counted
+//
+enum PF_Counter {
+    PF_GETPAGE,             // calls to GetPage
+    PF_PAGEFOUND,           //   the page was in the buffer
+    PF_PAGENOTFOUND,        //   the page was read in
+    PF_READPAGE,            // pages read one at a time
+    PF_WRITEPAGE,           // pages written
+    PF_FLUSHPAGES,          // calls to FlushPages
+    PF_READAHEAD,           // pages read ahead
+    PF_NUM_COUNTERS
+};
+
+//
+// PF_Latency - which requests are timed
+//
+enum PF_Latency {
+    PF_READLATENCY,
+    PF_WRITELATENCY,
+    PF_NUM_LATENCIES
+};
+
+const int PF_STAT_SHARDS = 16;          // copies of each counter
+const int PF_LATENCY_BUCKETS = 24;      // bucket i: under 2^i microseconds
+
+struct alignas(64) PF_StatShard {
+    std::atomic<long long> value[PF_NUM_COUNTERS];
+};
+
+extern PF_StatShard pfStatShards[PF_STAT_SHARDS];
+
+// Shard for a thread that has not counted yet
+int  PF_NewStatShard    ();
+
+// Add n to a counter
+inline void PF_Count(PF_Counter counter, long long n = 1)
+{
+    static thread_local int shard = PF_NewStatShard();
+    pfStatShards[shard].value[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+long long PF_GetCounter (PF_Counter counter);
+
+// Note that a request took nanos nanoseconds
+void PF_RecordLatency   (PF_Latency which, long long nanos);
+
+// One line about the requests timed: number, mean and 99th percentile
+void PF_PrintLatency    (PF_Latency which);
+
+void PF_Statistics      ();             // print counters and histograms
+void PF_ResetStatistics ();             // set them all to zero
+
+#endif
@@ -6,30 +6,29 @@
 //
 // 1997: Added call to confirm the statistics from the buffer mgr
 //
+// Also tests the page codec and files with compressed pages.
+//
 
 #include <cstdio>
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
 #include <cstring>
 #include <unistd.h>
+#include <sys/stat.h>
 #include "pf.h"
 #include "pf_internal.h"
 #include "pf_hashtable.h"
+#include "pf_compress.h"
+#include "pf_trace.h"
 
 using namespace std;
 
-// The PF_STATS indicates that we will be tracking statistics for the PF
-// Layer.  The Manager is defined within pf_buffermgr.cc.  Here we must
-// place the initializer and then the final call to printout the statistics
-// once main has finished
-#ifdef PF_STATS
-#include "statistics.h"
-
-// This is defined within pf_buffermgr.cc
-extern StatisticsMgr *pStatisticsMgr;
-
-// This method is defined within pf_statistics.cc.  It is called at the end
-// to display the final statistics, or by the debugger to monitor progress.
-extern void PF_Statistics();
+// The statistics of the PF layer are always kept (pf_statistics.h).  Here
+// we call PF_Statistics at the end to display the final numbers, and
+// check them.
+#include "pf_statistics.h"
 
 //
 // PF_ConfirmStatistics
@@ -42,61 +41,51 @@ extern void PF_Statistics();
 //
 void PF_ConfirmStatistics()
 {
-    // Must remember to delete the memory returned from StatisticsMgr::Get
     cout << "Verifying the statistics for buffer manager: ";
-    int *piGP = pStatisticsMgr->Get("GetPage");
-    int *piPF = pStatisticsMgr->Get("PageFound");
-    int *piPNF = pStatisticsMgr->Get("PageNotFound");
-    int *piWP = pStatisticsMgr->Get("WritePage");
-    int *piRP = pStatisticsMgr->Get("ReadPage");
-    int *piFP = pStatisticsMgr->Get("FlushPage");
-
-    if (piGP && (*piGP != 702)) {
-        cout << "Number of GetPages is incorrect! (" << *piGP << ")\n";
+    long long nGP = PF_GetCounter(PF_GETPAGE);
+    long long nPF = PF_GetCounter(PF_PAGEFOUND);
+    long long nPNF = PF_GetCounter(PF_PAGENOTFOUND);
+    long long nWP = PF_GetCounter(PF_WRITEPAGE);
+    long long nRP = PF_GetCounter(PF_READPAGE);
+    long long nFP = PF_GetCounter(PF_FLUSHPAGES);
+
+    if (nGP != 607) {
+        cout << "Number of GetPages is incorrect! (" << nGP << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piPF && (*piPF != 23)) {
+    if (nPF != 303) {
         cout << "Number of pages found in the buffer is incorrect! (" <<
-          *piPF << ")\n";
+          nPF << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piPNF && (*piPNF != 679)) {
+    if (nPNF != 304) {
         cout << "Number of pages not found in the buffer is incorrect! (" <<
-          *piPNF << ")\n";
+          nPNF << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piRP && (*piRP != 679)) {
+    if (nRP != 304) {
         cout << "Number of read requests to the Unix file system is " <<
-            "incorrect! (" << *piPNF << ")\n";
+            "incorrect! (" << nRP << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piWP && (*piWP != 339)) {
+    if (nWP != 339) {
         cout << "Number of write requests to the Unix file system is "<<
-            "incorrect! (" << *piPNF << ")\n";
+            "incorrect! (" << nWP << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piFP && (*piFP != 16)) {
+    if (nFP != 16) {
         cout << "Number of requests to flush the buffer is "<<
-            "incorrect! (" << *piPNF << ")\n";
+            "incorrect! (" << nFP << ")\n";
         // No built in error code for this
         exit(1);
     }
     cout << " Correct!\n";
-
-    // Delete the memory returned from StatisticsMgr::Get
-    delete piGP;
-    delete piPF;
-    delete piPNF;
-    delete piWP;
-    delete piRP;
-    delete piFP;
 }
-#endif    // PF_STATS
 
 
 
@@ -105,6 +94,9 @@ void PF_ConfirmStatistics()
 //
 #define FILE1   "file1"
 #define FILE2   "file2"
+#define FILE3   "file3"
+#define FILE4   "file4"
+#define TRACE1  "trace1"
 
 //
 // Function declarations
@@ -114,6 +106,14 @@ RC PrintFile(PF_FileHandle &fh);
 RC ReadFile(PF_Manager &pfm, char* fname);
 RC TestPF();
 RC TestHash();
+void FillPage(char *pData, PageNum pageNum, int round);
+RC CheckCompressedFile(PF_Manager &pfm, int numPages, int round,
+                       int orRound = -1);
+RC TestCompress();
+RC AppendPages(PF_FileHandle &fh, int numPages);
+RC CheckFileSize(int numPages);
+RC TestExtend();
+RC TestTrace();
 
 RC WriteFile(PF_Manager &pfm, char *fname)
 {
@@ -455,12 +455,9 @@ printf("get bock size returned %d\n",len);
             (rc = pfm.DestroyFile(FILE2)))
         return(rc);
 
-    // If we are dealing with statistics then we should output the final
-    // numbers
-#ifdef PF_STATS
+    // Output the final numbers
     PF_Statistics();
     PF_ConfirmStatistics();
-#endif
 
     // Return ok
     return (0);
@@ -507,6 +504,329 @@ RC TestHash()
     return (0);
 }
 
+//
+// FillPage
+//
+// Desc: Contents of a page of the compressed test file.  Most pages are
+//       mostly zeros; every fourth (third after the rewrite) is noise
+//       that does not compress.
+//
+void FillPage(char *pData, PageNum pageNum, int round)
+{
+    unsigned int seed = pageNum * 7 + round;
+
+    memset(pData, 0, PF_PAGE_SIZE);
+    if (pageNum % (round ? 3 : 4) == 0)
+        for (int i = 0; i < PF_PAGE_SIZE; i++)
+            pData[i] = (char)rand_r(&seed);
+    else
+        for (int i = 0; i < 20 * (pageNum % 5); i++)
+            pData[i * 13] = (char)(pageNum + i);
+    memcpy(pData, &pageNum, sizeof(PageNum));
+    memcpy(pData + sizeof(PageNum), &round, sizeof(int));
+}
+
+//
+// CheckCompressedFile
+//
+// Desc: Every page must hold its contents of round, or of orRound if that
+//       is not -1
+//
+RC CheckCompressedFile(PF_Manager &pfm, int numPages, int round,
+                       int orRound)
+{
+    PF_FileHandle fh;
+    PF_PageHandle ph;
+    RC            rc;
+    char          *pData;
+    char          expected[PF_PAGE_SIZE];
+
+    if ((rc = pfm.OpenFile(FILE3, fh)))
+        return (rc);
+
+    for (PageNum pageNum = 0; pageNum < numPages; pageNum++) {
+        if ((rc = fh.GetThisPage(pageNum, ph)) ||
+                (rc = ph.GetData(pData)))
+            return (rc);
+        FillPage(expected, pageNum, round);
+        if (memcmp(pData, expected, PF_PAGE_SIZE) && orRound != -1)
+            FillPage(expected, pageNum, orRound);
+        if (memcmp(pData, expected, PF_PAGE_SIZE)) {
+            cout << "Compressed page " << pageNum << " read back wrong\n";
+            return (PF_INVALIDPAGE);
+        }
+        if ((rc = fh.UnpinPage(pageNum)))
+            return (rc);
+    }
+
+    return (pfm.CloseFile(fh));
+}
+
+RC TestCompress()
+{
+    PF_Manager    pfm;
+    PF_FileHandle fh;
+    PF_PageHandle ph;
+    RC            rc;
+    char          *pData;
+    PageNum       pageNum;
+    struct stat   st;
+    const int     numPages = PF_BUFFER_SIZE * 3;
+
+    cout << "Testing the page codec\n";
+
+    char page[PF_PAGE_SIZE], comp[PF_PAGE_SIZE], back[PF_PAGE_SIZE];
+    for (int round = 0; round < 2; round++)
+        for (pageNum = 0; pageNum < 12; pageNum++) {
+            FillPage(page, pageNum, round);
+            int length = PF_Compress(page, PF_PAGE_SIZE, comp, PF_PAGE_SIZE);
+            if (length == 0 && pageNum % (round ? 3 : 4) == 0)
+                continue;
+            if (length == 0 ||
+                    PF_Decompress(comp, length, back, PF_PAGE_SIZE)
+                        != PF_PAGE_SIZE ||
+                    memcmp(page, back, PF_PAGE_SIZE)) {
+                cout << "Page " << pageNum << " did not survive the codec\n";
+                return (PF_INVALIDPAGE);
+            }
+            if (PF_Decompress(comp, length, back, PF_PAGE_SIZE - 1) != -1) {
+                cout << "Page " << pageNum << " overflowed its buffer\n";
+                return (PF_INVALIDPAGE);
+            }
+        }
+
+    cout << "Writing " << numPages << " compressed pages\n";
+
+    unlink(FILE3);
+    if ((rc = pfm.CreateFile(FILE3, TRUE)) ||
+            (rc = pfm.OpenFile(FILE3, fh)))
+        return (rc);
+    for (int i = 0; i < numPages; i++) {
+        if ((rc = fh.AllocatePage(ph)) ||
+                (rc = ph.GetData(pData)) ||
+                (rc = ph.GetPageNum(pageNum)))
+            return (rc);
+        FillPage(pData, pageNum, 0);
+        if ((rc = fh.MarkDirty(pageNum)) ||
+                (rc = fh.UnpinPage(pageNum)))
+            return (rc);
+    }
+    if ((rc = pfm.CloseFile(fh)) ||
+            (rc = CheckCompressedFile(pfm, numPages, 0)))
+        return (rc);
+
+    if (stat(FILE3, &st) ||
+            st.st_size >= PF_FILE_HDR_SIZE + (off_t)numPages * PF_PAGE_SIZE / 2) {
+        cout << "Compressed file takes " << st.st_size << " bytes\n";
+        return (PF_INVALIDPAGE);
+    }
+
+    // The map as saved before the rewrite
+    string oldMap;
+    {
+        ifstream in(FILE3 PF_PAGEMAP_SUFFIX, ios::binary);
+        oldMap.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    cout << "Rewriting the pages with new sizes\n";
+
+    if ((rc = pfm.OpenFile(FILE3, fh)))
+        return (rc);
+    for (pageNum = 0; pageNum < numPages; pageNum++) {
+        if ((rc = fh.GetThisPage(pageNum, ph)) ||
+                (rc = ph.GetData(pData)))
+            return (rc);
+        FillPage(pData, pageNum, 1);
+        if ((rc = fh.MarkDirty(pageNum)) ||
+                (rc = fh.UnpinPage(pageNum)))
+            return (rc);
+    }
+    if ((rc = pfm.CloseFile(fh)) ||
+            (rc = CheckCompressedFile(pfm, numPages, 1)))
+        return (rc);
+
+    // As after a crash before the map was saved: the pages rewritten in
+    // place must read back new, and the others old
+    cout << "Reading the pages through the old page map\n";
+    {
+        ofstream out(FILE3 PF_PAGEMAP_SUFFIX, ios::binary | ios::trunc);
+        out << oldMap;
+    }
+    if ((rc = CheckCompressedFile(pfm, numPages, 1, 0)))
+        return (rc);
+
+    if ((rc = pfm.DestroyFile(FILE3)))
+        return (rc);
+    if (access(FILE3 PF_PAGEMAP_SUFFIX, F_OK) == 0) {
+        cout << "Page map was not destroyed\n";
+        return (PF_INVALIDPAGE);
+    }
+
+    // Units a page moves away from are reused only after the map is saved
+    PF_PageMap map(FILE3, PF_PAGE_SIZE);
+    PF_PageExtent first = map.Place(0, PF_COMP_UNIT);
+    map.Place(1, PF_COMP_UNIT);
+    map.Place(0, 2 * PF_COMP_UNIT);
+    if (map.Place(2, PF_COMP_UNIT).start == first.start) {
+        cout << "Units were reused before the page map was saved\n";
+        return (PF_INVALIDPAGE);
+    }
+    if ((rc = map.Save()))
+        return (rc);
+    if (map.Place(3, PF_COMP_UNIT).start != first.start) {
+        cout << "Units were not reused after the page map was saved\n";
+        return (PF_INVALIDPAGE);
+    }
+    unlink(FILE3 PF_PAGEMAP_SUFFIX);
+
+    // Return ok
+    return (0);
+}
+
+//
+// AppendPages
+//
+// Allocate numPages new pages and unpin them
+//
+RC AppendPages(PF_FileHandle &fh, int numPages)
+{
+    RC            rc;
+    PF_PageHandle ph;
+    PageNum       pageNum;
+
+    for (int i = 0; i < numPages; i++)
+        if ((rc = fh.AllocatePage(ph)) ||
+                (rc = ph.GetPageNum(pageNum)) ||
+                (rc = fh.UnpinPage(pageNum)))
+            return (rc);
+    return (0);
+}
+
+//
+// CheckFileSize
+//
+// Confirm that FILE4 has room for numPages pages
+//
+RC CheckFileSize(int numPages)
+{
+    struct stat st;
+    off_t expected = PF_FILE_HDR_SIZE + (off_t)numPages * PF_MIN_PAGE_BYTES;
+
+    if (stat(FILE4, &st) < 0)
+        return (PF_UNIX);
+    if (st.st_size != expected) {
+        cout << "File is " << st.st_size << " bytes, not " << expected << "\n";
+        return (PF_INVALIDPAGE);
+    }
+    return (0);
+}
+
+//
+// TestExtend
+//
+// A file grows a chunk at a time, and remembers the preallocated tail
+// across opens.  Without a chunk it grows as its pages are written.
+//
+RC TestExtend()
+{
+    PF_Manager    pfm;
+    PF_FileHandle fh;
+    RC            rc;
+    const int     chunk = 16;
+
+    cout << "Testing file extension in chunks of " << chunk << " pages\n";
+
+    if ((rc = pfm.SetExtendChunk(chunk * PF_MIN_PAGE_BYTES)) ||
+            (rc = pfm.CreateFile(FILE4)) ||
+            (rc = pfm.OpenFile(FILE4, fh)) ||
+            (rc = AppendPages(fh, 1)) ||
+            (rc = CheckFileSize(chunk)) ||
+            (rc = AppendPages(fh, chunk)) ||
+            (rc = CheckFileSize(2 * chunk)) ||
+            (rc = pfm.CloseFile(fh)))
+        return (rc);
+
+    // The rest of the second chunk is still free to use
+    if ((rc = pfm.OpenFile(FILE4, fh)) ||
+            (rc = AppendPages(fh, chunk - 1)) ||
+            (rc = CheckFileSize(2 * chunk)))
+        return (rc);
+
+    // Page by page from here
+    if ((rc = pfm.SetExtendChunk(0)) ||
+            (rc = AppendPages(fh, 1)) ||
+            (rc = pfm.CloseFile(fh)) ||
+            (rc = CheckFileSize(2 * chunk + 1)) ||
+            (rc = pfm.DestroyFile(FILE4)))
+        return (rc);
+
+    // Return ok
+    return (0);
+}
+
+//
+// TestTrace
+//
+// The trace holds a record for each page allocated, requested and marked
+// dirty, and one for the pages dropped when the file is closed.
+//
+RC TestTrace()
+{
+    PF_Manager    pfm;
+    PF_FileHandle fh;
+    PF_PageHandle ph;
+    RC            rc;
+    const int     numPages = 10;
+
+    cout << "Testing the buffer access trace\n";
+
+    if ((rc = pfm.CreateFile(FILE4)) ||
+            (rc = pfm.OpenFile(FILE4, fh)) ||
+            (rc = pfm.StartTrace(TRACE1)) ||
+            (rc = AppendPages(fh, numPages)))
+        return (rc);
+    for (PageNum pageNum = 0; pageNum < numPages; pageNum++)
+        if ((rc = fh.GetThisPage(pageNum, ph)) ||
+                (rc = fh.MarkDirty(pageNum)) ||
+                (rc = fh.UnpinPage(pageNum)))
+            return (rc);
+    if ((rc = pfm.CloseFile(fh)) ||
+            (rc = pfm.StopTrace()) ||
+            (rc = pfm.DestroyFile(FILE4)))
+        return (rc);
+
+    // Expect ALLOC and DIRTY for each new page, then GET and DIRTY, then
+    // DROP
+    FILE *fp = fopen(TRACE1, "rb");
+    if (fp == NULL)
+        return (PF_UNIX);
+    PF_TraceHdr hdr;
+    PF_TraceRecord rec;
+    vector<PF_TraceOp> ops;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+            memcmp(hdr.magic, PF_TRACE_MAGIC, sizeof(hdr.magic)) != 0) {
+        fclose(fp);
+        cout << "Trace header is wrong\n";
+        return (PF_HDRREAD);
+    }
+    while (fread(&rec, sizeof(rec), 1, fp) == 1)
+        ops.push_back(rec.Op());
+    fclose(fp);
+    unlink(TRACE1);
+
+    if (ops.size() != 4 * numPages + 1 ||
+            ops[0] != PF_TRACE_ALLOC || ops[1] != PF_TRACE_DIRTY ||
+            ops[2 * numPages] != PF_TRACE_GET ||
+            ops[2 * numPages + 1] != PF_TRACE_DIRTY ||
+            ops.back() != PF_TRACE_DROP) {
+        cout << "Trace has the wrong records (" << ops.size() << ")\n";
+        return (PF_INVALIDPAGE);
+    }
+
+    // Return ok
+    return (0);
+}
+
 int main()
 {
     RC rc;
@@ -517,18 +837,20 @@ int main()
     cout << "Starting PF layer test.\n";
     cout.flush();
 
-    // If we are tracking the PF Layer statistics
-#ifdef PF_STATS
-    cout << "Note: Statistics are turned on.\n";
-#endif
-
     // Delete files from last time
     unlink(FILE1);
     unlink(FILE2);
+    unlink(FILE3);
+    unlink(FILE3 PF_PAGEMAP_SUFFIX);
+    unlink(FILE4);
+    unlink(TRACE1);
 
     // Do tests
     if ((rc = TestPF()) ||
-            (rc = TestHash())) {
+            (rc = TestHash()) ||
+            (rc = TestCompress()) ||
+            (rc = TestExtend()) ||
+            (rc = TestTrace())) {
         PF_PrintError(rc);
         return (1);
     }
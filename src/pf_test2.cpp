@@ -4,9 +4,7 @@
 // Authors:     Jason McHugh (mchughj@cs.stanford.edu)
 //
 // 1997: This file was created to utilize the statistics manager to ensure
-// that the buffer manager was performing correctly.  Note that you must
-// compile the pf layer with the -DPF_STATS flag.  If you don't then this
-// test won't really test anything over and above the pf_test1.cc.
+// that the buffer manager was performing correctly.
 //
 
 #include <cstdio>
@@ -19,20 +17,10 @@
 
 using namespace std;
 
-// The PF_STATS indicates that we will be tracking statistics for the PF
-// Layer.  The Manager is defined within pf_buffermgr.cc.  Here we must
-// place the initializer and then the final call to printout the statistics
-// once main has finished
-#ifdef PF_STATS
-#include "statistics.h"
-
-// This is defined within pf_buffermgr.cc
-extern StatisticsMgr *pStatisticsMgr;
-
-// This method is defined within pf_statistics.cc.  It is called at the end
-// to display the final statistics, or by the debugger to monitor progress.
-extern void PF_Statistics();
-#endif
+// The statistics of the PF layer are always kept (pf_statistics.h).  They
+// are checked as the test goes, and PF_Statistics displays the final
+// numbers.
+#include "pf_statistics.h"
 
 //
 // Defines
@@ -89,40 +77,32 @@ RC TestPF()
         }
     }
 
-    // Now, if we have compiled with PF_STATS then we need to ensure that
-    // PF_GETPAGE = PF_BUFFER_SIZE and PF_PAGEFOUND = PF_BUFFER_SIZE.
-    // Also that PF_PAGENOTFOUND = PF_BUFFER_SIZE.
-#ifdef PF_STATS
+    // Now we need to ensure that PF_GETPAGE = PF_BUFFER_SIZE and
+    // PF_PAGEFOUND = PF_BUFFER_SIZE.  Also that PF_PAGENOTFOUND = 0.
     cout << "Verifying the statistics for buffer manager: ";
-    int *piGP = pStatisticsMgr->Get(PF_GETPAGE);
-    int *piPF = pStatisticsMgr->Get(PF_PAGEFOUND);
-    int *piPNF = pStatisticsMgr->Get(PF_PAGENOTFOUND);
+    long long nGP = PF_GetCounter(PF_GETPAGE);
+    long long nPF = PF_GetCounter(PF_PAGEFOUND);
+    long long nPNF = PF_GetCounter(PF_PAGENOTFOUND);
 
-    if (piGP && (*piGP != PF_BUFFER_SIZE)) {
-        cout << "Number of GetPages is incorrect! (" << *piGP << ")\n";
+    if (nGP != PF_BUFFER_SIZE) {
+        cout << "Number of GetPages is incorrect! (" << nGP << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piPF && (*piPF != PF_BUFFER_SIZE)) {
+    if (nPF != PF_BUFFER_SIZE) {
         cout << "Number of pages found in the buffer is incorrect! (" <<
-          *piPF << ")\n";
+          nPF << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piPNF!=NULL) {
+    if (nPNF != 0) {
         cout << "Number of pages not found in the buffer is incorrect! (" <<
-          *piPNF << ")\n";
+          nPNF << ")\n";
         // No built in error code for this
         exit(1);
     }
     cout << " Correct!\n";
 
-    delete piGP;
-    delete piPF;
-    delete piPNF;
-
-#endif                 // PF_STATS
-
     cout << "Unpinning pages.\n";
     for (i = 0; i < PF_BUFFER_SIZE; i++)
         // Must unpine the pages twice
@@ -132,29 +112,22 @@ RC TestPF()
 
     // Confirm that the buffer manager has written the correct number of
     // pages.
-#ifdef PF_STATS
     cout << "Verifying the write statistics for buffer manager: ";
-    int *piWP = pStatisticsMgr->Get(PF_WRITEPAGE);
-    int *piRP = pStatisticsMgr->Get(PF_READPAGE);
+    long long nWP = PF_GetCounter(PF_WRITEPAGE);
+    long long nRP = PF_GetCounter(PF_READPAGE);
 
-    if (piWP && (*piWP != PF_BUFFER_SIZE)) {
-        cout << "Number of write pages is incorrect! (" << *piGP << ")\n";
+    if (nWP != 0) {
+        cout << "Number of write pages is incorrect! (" << nWP << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piRP!=NULL) {
-        cout << "Number of pages read in is incorrect! (" <<
-          *piPNF << ")\n";
+    if (nRP != 0) {
+        cout << "Number of pages read in is incorrect! (" << nRP << ")\n";
         // No built in error code for this
         exit(1);
     }
     cout << " Correct!\n";
 
-    delete piWP;
-    delete piRP;
-
-#endif          // PF_STATS
-
     // Goal here is to push out of the buffer manager the old pages by
     // asking for new ones.  At the end the LRU algorithm should ensure that
     // none of the original pages lie in memory
@@ -193,49 +166,40 @@ RC TestPF()
     // The previous refetch should have resulted in the buffer manager
     // going to disk for each of the pages, since the buffer should
     // not have had any of the pages.
-#ifdef PF_STATS
     cout << "Verifying that pages were not found in buffer pool: ";
-    piPNF = pStatisticsMgr->Get(PF_PAGENOTFOUND);
+    nPNF = PF_GetCounter(PF_PAGENOTFOUND);
 
-    if (piPNF && (*piPNF != PF_BUFFER_SIZE)) {
+    if (nPNF != PF_BUFFER_SIZE) {
         cout << "Number of pages not found in the buffer is incorrect! (" <<
-          *piPF << ")\n";
+          nPNF << ")\n";
         // No built in error code for this
         exit(1);
     }
     cout << " Correct!\n";
 
-    delete piPNF;
-#endif          // PF_STATS
-
     // Now we will Flush the buffer manager to disk and count the number of
     // flushes and the total number of writes.
     cout << "Flushing the File handle to disk.\n";
     if ((rc = fh.FlushPages()))
         return (rc);
 
-#ifdef PF_
     cout << "Testing flush to disk: ";
-    int *piFP = pStatisticsMgr->Get(PF_FLUSHPAGES);
-    piWP = pStatisticsMgr->Get(PF_WRITEPAGES);
+    long long nFP = PF_GetCounter(PF_FLUSHPAGES);
+    nWP = PF_GetCounter(PF_WRITEPAGE);
 
-    if (piFP && (*piFP != 1)) {
+    if (nFP != 1) {
         cout << "Number of times Flush pages routine has been called " <<
-            "is incorrect! (" << *piFP << ")\n";
+            "is incorrect! (" << nFP << ")\n";
         // No built in error code for this
         exit(1);
     }
-    if (piWP && (*piWP != 2*PF_BUFFER_SIZE)) {
-        cout << "Number of written pages is incorrect! (" << *piWP << ")\n";
+    if (nWP != 2*PF_BUFFER_SIZE) {
+        cout << "Number of written pages is incorrect! (" << nWP << ")\n";
         // No built in error code for this
         exit(1);
     }
     cout << " Correct!\n";
 
-    delete piFP;
-    delete piWP;
-#endif
-
 
     cout << "Flushing the File handle to disk. (Again)\n";
     if ((rc = fh.FlushPages()))
@@ -243,30 +207,23 @@ RC TestPF()
 
     // Here the idea is to ensure that the number of pages written has not
     // increased!  Since everything was already flushed.
-#ifdef PF_STATS
     cout << "Testing number of pages written to disk: ";
-    piWP = pStatisticsMgr->Get(PF_WRITEPAGE);
+    nWP = PF_GetCounter(PF_WRITEPAGE);
 
     // This number should not have increased since last time!
-    if (piWP && (*piWP != 2*PF_BUFFER_SIZE)) {
-        cout << "Number of written pages is incorrect! (" << *piWP << ")\n";
+    if (nWP != 2*PF_BUFFER_SIZE) {
+        cout << "Number of written pages is incorrect! (" << nWP << ")\n";
         // No built in error code for this
         exit(1);
     }
     cout << " Correct!\n";
 
-    delete piWP;
-#endif
-
     // Close the file
     if ((rc = pfm.CloseFile(fh)))
         return(rc);
 
-    // If we are dealing with statistics then we might as well output the
-    // final numbers
-#ifdef PF_STATS
+    // We might as well output the final numbers
     PF_Statistics();
-#endif
 
     // Return ok
     return (0);
@@ -283,12 +240,6 @@ int main()
     cout << "Starting PF layer test.\n";
     cout.flush();
 
-    // If we are tracking the PF Layer statistics
-#ifndef PF_STATS
-    cout << " ** The PF layer was not compiled with the -DPF_STATS flag **\n";
-    cout << " **    This test file is not very effective without it!    **\n";
-#endif
-
     cout << "----------------------\n";
 
     // Delete files from last time
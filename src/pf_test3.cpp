@@ -201,11 +201,6 @@ int main()
     cout << "Starting PF Chunk layer test.\n";
     cout.flush();
 
-    // If we are tracking the PF Layer statistics
-#ifdef PF_STATS
-    cout << "Note: Statistics are turned on.\n";
-#endif
-
     // Do tests
     if ((rc = TestChunk())) {
         PF_PrintError(rc);
@@ -0,0 +1,328 @@
+//
+// File:        pf_test4.cc
+// Description: Tests the PF component with several threads
+//
+// The buffer manager may be used by several threads at once.  This
+// tester has a number of threads fetch, change, mark dirty and unpin the
+// pages of one shared file at random.  There are more pages than fit in
+// the buffer, so pages are replaced (and written back) all the while.
+// Each thread only changes its own counter on every page, so once the
+// file has been closed and opened again every counter must hold the
+// number of times its thread incremented it.  The last round of changes
+// runs in a buffer large enough to be split into shards.  Finally all
+// threads scan the file at the same time without changing it, sharing one
+// scan ring.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "pf.h"
+#include "pf_internal.h"
+
+using namespace std;
+
+//
+// Defines
+//
+#define FILE1         "file1"
+#define NUM_PAGES     (PF_SHARD_PAGES * 5)      // more than fit in the buffer
+#define NUM_SHARDS    4                         // shards of the larger buffer
+#define NUM_THREADS   8
+#define NUM_ROUNDS    4000                      // page accesses per thread
+
+//
+// Page layout: the page number, then one counter per thread
+//
+struct TestPage {
+    PageNum pageNum;
+    int     counters[NUM_THREADS];
+};
+
+RC CreateTestFile(PF_Manager &pfm);
+RC CheckTestFile(PF_Manager &pfm, const vector<vector<int> > &expected);
+void ChangePages(PF_FileHandle *pfh, int thread, vector<int> *pCounts,
+                 RC *pRc);
+void ScanPages(PF_FileHandle *pfh, RC *pRc);
+RC RunThreads(PF_FileHandle &fh, vector<vector<int> > &counts, int bChange);
+RC TestThreads();
+
+//
+// CreateTestFile
+//
+// Desc: Create FILE1 with NUM_PAGES pages whose counters are all 0
+//
+RC CreateTestFile(PF_Manager &pfm)
+{
+    RC            rc;
+    PF_FileHandle fh;
+    PF_PageHandle ph;
+    char          *pData;
+    PageNum       pageNum;
+
+    cout << "Creating " << NUM_PAGES << " pages\n";
+
+    if ((rc = pfm.CreateFile(FILE1)) ||
+            (rc = pfm.OpenFile(FILE1, fh)))
+        return (rc);
+
+    for (int i = 0; i < NUM_PAGES; i++) {
+        if ((rc = fh.AllocatePage(ph)) ||
+                (rc = ph.GetData(pData)) ||
+                (rc = ph.GetPageNum(pageNum)))
+            return (rc);
+
+        TestPage page;
+        memset(&page, 0, sizeof(page));
+        page.pageNum = pageNum;
+        memcpy(pData, &page, sizeof(page));
+
+        if ((rc = fh.MarkDirty(pageNum)) ||
+                (rc = fh.UnpinPage(pageNum)))
+            return (rc);
+    }
+
+    return (pfm.CloseFile(fh));
+}
+
+//
+// ChangePages
+//
+// Desc: Body of a thread.  Fetch random pages, check their page number,
+//       and increment this thread's counter on about half of them.
+//       Every so often a second page is pinned while the first one is
+//       still held.
+//
+void ChangePages(PF_FileHandle *pfh, int thread, vector<int> *pCounts,
+                 RC *pRc)
+{
+    RC            rc;
+    PF_PageHandle ph, ph2;
+    char          *pData, *pData2;
+    unsigned int  seed = thread + 1;
+
+    for (int round = 0; round < NUM_ROUNDS; round++) {
+        PageNum pageNum = rand_r(&seed) % NUM_PAGES;
+
+        if ((rc = pfh->GetThisPage(pageNum, ph)) ||
+                (rc = ph.GetData(pData))) {
+            *pRc = rc;
+            return;
+        }
+        TestPage *pPage = (TestPage *)pData;
+        if (pPage->pageNum != pageNum) {
+            cout << "Thread " << thread << " found page " << pPage->pageNum
+                << " instead of " << pageNum << "\n";
+            *pRc = PF_INVALIDPAGE;
+            return;
+        }
+
+        if (rand_r(&seed) % 2) {
+            pPage->counters[thread]++;
+            (*pCounts)[pageNum]++;
+            if ((rc = pfh->MarkDirty(pageNum))) {
+                *pRc = rc;
+                return;
+            }
+        }
+
+        // Hold on to the page while fetching another one (maybe the same)
+        if (rand_r(&seed) % 8 == 0) {
+            PageNum pageNum2 = rand_r(&seed) % NUM_PAGES;
+            if ((rc = pfh->GetThisPage(pageNum2, ph2)) ||
+                    (rc = ph2.GetData(pData2))) {
+                *pRc = rc;
+                return;
+            }
+            if (((TestPage *)pData2)->pageNum != pageNum2) {
+                *pRc = PF_INVALIDPAGE;
+                return;
+            }
+            if ((rc = pfh->UnpinPage(pageNum2))) {
+                *pRc = rc;
+                return;
+            }
+        }
+
+        if ((rc = pfh->UnpinPage(pageNum))) {
+            *pRc = rc;
+            return;
+        }
+    }
+
+    *pRc = 0;
+}
+
+//
+// ScanPages
+//
+// Desc: Body of a thread.  Read every page in order, as a sequential
+//       scan, and check its page number.
+//
+void ScanPages(PF_FileHandle *pfh, RC *pRc)
+{
+    RC            rc;
+    PF_PageHandle ph;
+    char          *pData;
+
+    for (PageNum pageNum = 0; pageNum < NUM_PAGES; pageNum++) {
+        if ((rc = pfh->GetThisPage(pageNum, ph, SEQUENTIAL_SCAN)) ||
+                (rc = ph.GetData(pData))) {
+            *pRc = rc;
+            return;
+        }
+        if (((TestPage *)pData)->pageNum != pageNum) {
+            *pRc = PF_INVALIDPAGE;
+            return;
+        }
+        if ((rc = pfh->UnpinPage(pageNum))) {
+            *pRc = rc;
+            return;
+        }
+    }
+
+    *pRc = 0;
+}
+
+//
+// RunThreads
+//
+// Desc: Run NUM_THREADS threads over fh and wait for them.  The threads
+//       change the pages if bChange is set, otherwise they scan them.
+// Out:  counts - counts[t][p] is the number of times thread t incremented
+//                its counter on page p
+//
+RC RunThreads(PF_FileHandle &fh, vector<vector<int> > &counts, int bChange)
+{
+    vector<thread> threads;
+    vector<RC>     rcs(NUM_THREADS, 0);
+
+    counts.assign(NUM_THREADS, vector<int>(NUM_PAGES, 0));
+    for (int t = 0; t < NUM_THREADS; t++)
+        if (bChange)
+            threads.push_back(thread(ChangePages, &fh, t, &counts[t], &rcs[t]));
+        else
+            threads.push_back(thread(ScanPages, &fh, &rcs[t]));
+
+    for (int t = 0; t < NUM_THREADS; t++)
+        threads[t].join();
+
+    for (int t = 0; t < NUM_THREADS; t++)
+        if (rcs[t])
+            return (rcs[t]);
+    return (0);
+}
+
+//
+// CheckTestFile
+//
+// Desc: Check the page numbers and counters of every page of FILE1
+//
+RC CheckTestFile(PF_Manager &pfm, const vector<vector<int> > &expected)
+{
+    RC            rc;
+    PF_FileHandle fh;
+    PF_PageHandle ph;
+    char          *pData;
+
+    cout << "Checking the counters\n";
+
+    if ((rc = pfm.OpenFile(FILE1, fh)))
+        return (rc);
+
+    for (PageNum pageNum = 0; pageNum < NUM_PAGES; pageNum++) {
+        if ((rc = fh.GetThisPage(pageNum, ph)) ||
+                (rc = ph.GetData(pData)))
+            return (rc);
+
+        TestPage *pPage = (TestPage *)pData;
+        if (pPage->pageNum != pageNum)
+            return (PF_INVALIDPAGE);
+        for (int t = 0; t < NUM_THREADS; t++)
+            if (pPage->counters[t] != expected[t][pageNum]) {
+                cout << "Page " << pageNum << ", thread " << t << ": "
+                    << pPage->counters[t] << " instead of "
+                    << expected[t][pageNum] << "\n";
+                return (PF_INVALIDPAGE);
+            }
+
+        if ((rc = fh.UnpinPage(pageNum)))
+            return (rc);
+    }
+
+    return (pfm.CloseFile(fh));
+}
+
+RC TestThreads()
+{
+    PF_Manager            pfm;
+    PF_FileHandle         fh;
+    RC                    rc;
+    vector<vector<int> >  counts, total(NUM_THREADS, vector<int>(NUM_PAGES, 0));
+
+    unlink(FILE1);
+    if ((rc = CreateTestFile(pfm)))
+        return (rc);
+
+    // Once without and once with the background flusher writing pages,
+    // then with the flusher in a buffer of NUM_SHARDS shards
+    for (int pass = 0; pass < 3; pass++) {
+        if (pass == 1 && (rc = pfm.SetCleanTarget(50)))
+            return (rc);
+        if (pass == 2 &&
+                (rc = pfm.ResizeBuffer(PF_SHARD_PAGES * NUM_SHARDS)))
+            return (rc);
+
+        cout << NUM_THREADS << " threads changing pages: ";
+        if ((rc = pfm.OpenFile(FILE1, fh)) ||
+                (rc = RunThreads(fh, counts, TRUE)) ||
+                (rc = pfm.CloseFile(fh)))
+            return (rc);
+        cout << "Pass\n";
+
+        for (int t = 0; t < NUM_THREADS; t++)
+            for (int p = 0; p < NUM_PAGES; p++)
+                total[t][p] += counts[t][p];
+        if ((rc = CheckTestFile(pfm, total)))
+            return (rc);
+        cout << "Pass\n";
+    }
+
+    cout << NUM_THREADS << " threads scanning pages: ";
+    if ((rc = pfm.OpenFile(FILE1, fh)) ||
+            (rc = RunThreads(fh, counts, FALSE)) ||
+            (rc = pfm.CloseFile(fh)))
+        return (rc);
+    cout << "Pass\n";
+
+    if ((rc = pfm.DestroyFile(FILE1)))
+        return (rc);
+
+    return (0);
+}
+
+int main()
+{
+    RC rc;
+
+    // Write out initial starting message
+    cerr.flush();
+    cout.flush();
+    cout << "Starting PF multi-threaded test.\n";
+    cout.flush();
+
+    // Do tests
+    if ((rc = TestThreads())) {
+        PF_PrintError(rc);
+        return (1);
+    }
+
+    // Write ending message and exit
+    cout << "Ending PF multi-threaded test.\n\n";
+
+    return (0);
+}
@@ -0,0 +1,124 @@
+//
+// File:        pf_trace.cc
+// Description: PF_Tracer implementation
+//
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "pf_trace.h"
+
+using namespace std;
+
+PF_Tracer::PF_Tracer()
+{
+    bOn = false;
+    traceFd = -1;
+    error = 0;
+}
+
+PF_Tracer::~PF_Tracer()
+{
+    Close();
+}
+
+//
+// Open
+//
+// Desc: Start a trace, ending the one being written if there is one
+// In:   fileName - trace file, replaced if it exists
+//       pageSize, numPages - the buffer, recorded in the header
+// Ret:  PF_UNIX if the file cannot be written
+//
+RC PF_Tracer::Open(const char *fileName, int pageSize, int numPages)
+{
+    RC rc;
+    if ((rc = Close()))
+        return (rc);
+
+    lock_guard<mutex> guard(latch);
+
+    traceFd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, CREATION_MASK);
+    if (traceFd < 0)
+        return (PF_UNIX);
+
+    PF_TraceHdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PF_TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.pageSize = pageSize;
+    hdr.numPages = numPages;
+    if (write(traceFd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr)) {
+        close(traceFd);
+        traceFd = -1;
+        unlink(fileName);
+        return (PF_UNIX);
+    }
+
+    error = 0;
+    records.reserve(PF_TRACE_BATCH);
+    start = chrono::steady_clock::now();
+    bOn = true;
+    return (0);
+}
+
+//
+// Close
+//
+// Desc: Write the records still in memory and close the trace file
+// Ret:  PF_UNIX if any part of the trace could not be written
+//
+RC PF_Tracer::Close()
+{
+    lock_guard<mutex> guard(latch);
+
+    bOn = false;
+    if (traceFd < 0)
+        return (0);
+
+    Flush();
+    if (close(traceFd) < 0 && !error)
+        error = PF_UNIX;
+    traceFd = -1;
+    return (error);
+}
+
+//
+// Append
+//
+// Desc: Internal.  Add a record, writing out a full batch
+//
+void PF_Tracer::Append(PF_TraceOp op, int fd, PageNum pageNum)
+{
+    lock_guard<mutex> guard(latch);
+
+    // The trace may have been closed since Record looked
+    if (traceFd < 0)
+        return;
+
+    PF_TraceRecord rec;
+    rec.fd = fd;
+    rec.pageNum = pageNum;
+    rec.stamp = (unsigned long long)chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start).count() << 2 | (unsigned)op;
+    records.push_back(rec);
+
+    if (records.size() >= (size_t)PF_TRACE_BATCH)
+        Flush();
+}
+
+//
+// Flush
+//
+// Desc: Internal.  Write the records collected so far.  After a write
+//       fails nothing more is written, and Close reports the error.
+//
+RC PF_Tracer::Flush()
+{
+    size_t numBytes = records.size() * sizeof(PF_TraceRecord);
+    if (!error && numBytes > 0 &&
+            write(traceFd, records.data(), numBytes) != (ssize_t)numBytes)
+        error = PF_UNIX;
+    records.clear();
+    return (error);
+}
@@ -0,0 +1,90 @@
+//
+// File:        pf_trace.h
+// Description: Buffer access traces
+//
+// While a trace is on (PF_Manager::StartTrace), the buffer manager writes
+// a PF_TraceRecord to the trace file for every page requested from it,
+// allocated in it or marked dirty, and for every file whose pages it
+// drops.  pf_replay reads a trace back and replays it against simulated
+// buffers of several sizes and policies, to show how the hit ratio would
+// change with the size of the buffer.
+//
+// The file starts with a PF_TraceHdr; the records follow in the order in
+// which the requests were made.  Records are collected in memory and
+// written PF_TRACE_BATCH at a time.
+//
+
+#ifndef PF_TRACE_H
+#define PF_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "pf_internal.h"
+
+//
+// Constants
+//
+#define PF_TRACE_MAGIC  "PFTRACE1"      // first bytes of a trace file
+const int PF_TRACE_BATCH = 4096;        // records written at a time
+
+//
+// PF_TraceOp - what a record stands for
+//
+enum PF_TraceOp {
+    PF_TRACE_GET,                       // GetPage
+    PF_TRACE_ALLOC,                     // AllocatePage: a new page
+    PF_TRACE_DIRTY,                     // MarkDirty
+    PF_TRACE_DROP                       // pages of fd dropped (fd -1: all)
+};
+
+struct PF_TraceHdr {
+    char magic[8];                      // PF_TRACE_MAGIC
+    int  pageSize;                      // bytes per page
+    int  numPages;                      // buffer size when the trace began
+};
+
+struct PF_TraceRecord {
+    int       fd;
+    PageNum   pageNum;
+    unsigned long long stamp;           // microseconds since the trace
+                                        // began, shifted left 2, | op
+
+    PF_TraceOp Op () const { return (PF_TraceOp)(stamp & 3); }
+    unsigned long long Micros () const { return stamp >> 2; }
+};
+
+//
+// PF_Tracer - writes the trace of one buffer manager
+//
+// Record may be called from several threads at once; it costs a single
+// load while no trace is on.
+//
+class PF_Tracer {
+public:
+    PF_Tracer  ();
+    ~PF_Tracer ();
+
+    RC   Open   (const char *fileName, int pageSize, int numPages);
+    RC   Close  ();
+
+    void Record (PF_TraceOp op, int fd, PageNum pageNum)
+    {
+        if (bOn.load(std::memory_order_relaxed))
+            Append(op, fd, pageNum);
+    }
+
+private:
+    void Append (PF_TraceOp op, int fd, PageNum pageNum);
+    RC   Flush  ();                             // latch must be held
+
+    std::atomic<bool> bOn;                      // a trace is being written
+    std::mutex  latch;                          // protects all below
+    int         traceFd;                        // trace file, -1 if none
+    RC          error;                          // first failed write
+    std::vector<PF_TraceRecord> records;        // not written yet
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
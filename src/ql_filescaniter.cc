@@ -5,23 +5,59 @@
 #include "ql_iterator.h"
 
 QL_FileScanIterator::QL_FileScanIterator(std::string relName)
-        : QL_Iterator(), relName(relName) {
+        : QL_Iterator(), relName(relName), bFiltered(false), batchPos(0) {
     QL_Iterator::rmm->OpenFile(relName.c_str(), fileHandle);
-    scan.OpenScan(fileHandle, INT, 4, 0, NO_OP, NULL);
+    OpenScan();
 }
 
+QL_FileScanIterator::QL_FileScanIterator(std::string relName, const QL_Condition &condition)
+        : QL_Iterator(), relName(relName), bFiltered(true), condition(condition), batchPos(0) {
+    QL_Iterator::rmm->OpenFile(relName.c_str(), fileHandle);
+    OpenScan();
+}
+
+RC QL_FileScanIterator::OpenScan() {
+    if (!bFiltered)
+        return scan.OpenScan(fileHandle, INT, 4, 0, NO_OP, NULL, SEQUENTIAL_SCAN);
+    return scan.OpenScan(fileHandle, condition.lhsAttr.attrType, condition.lhsAttr.attrSize,
+                         condition.lhsAttr.offset, condition.op, condition.rhsValue.data,
+                         SEQUENTIAL_SCAN);
+}
+
+QL_FileScanIterator::~QL_FileScanIterator() {
+    batch.Release();
+    scan.CloseScan();
+    QL_Iterator::rmm->CloseFile(fileHandle);
+}
+
+// The records are read a page at a time and copied out of the page
 RC QL_FileScanIterator::GetNextRec(RM_Record &rec) {
-    return scan.GetNextRec(rec);
+    if (batchPos == batch.GetNumRecs()) {
+        batchPos = 0;
+        if (int rc = scan.GetNextBatch(batch)) {
+            if (rc != RM_EOF) {
+                TRY(rc);
+            }
+            return rc;
+        }
+    }
+    batch.GetRec(batchPos++, rec);
+    return 0;
 }
 
 RC QL_FileScanIterator::Reset() {
+    TRY(batch.Release());
+    batchPos = 0;
     TRY(scan.CloseScan());
-    TRY(scan.OpenScan(fileHandle, INT, 4, 0, NO_OP, NULL));
+    TRY(OpenScan());
     return 0;
 }
 
 void QL_FileScanIterator::Print(std::string prefix) {
     std::cout << prefix;
     std::cout << id << ": ";
-    std::cout << "SCAN " << relName << std::endl;
+    std::cout << "SCAN " << relName;
+    if (bFiltered)
+        std::cout << " " << condition;
+    std::cout << std::endl;
 }
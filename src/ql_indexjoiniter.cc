@@ -22,8 +22,6 @@ QL_IndexedJoinIterator::QL_IndexedJoinIterator(QL_Iterator *scanIter, const std:
         joinedSize += upper_align<4>(info.attrSize);
         if (!(info.attrSpecs & ATTR_SPEC_NOTNULL)) ++nullableNum;
     }
-    data = new char[joinedSize];
-    isnull = new bool[nullableNum];
 
     scanIter->GetNextRec(rec1);
     rec1.GetData(data1);
@@ -32,11 +30,6 @@ QL_IndexedJoinIterator::QL_IndexedJoinIterator(QL_Iterator *scanIter, const std:
     searchIter->Reset();
 }
 
-QL_IndexedJoinIterator::~QL_IndexedJoinIterator() {
-    delete[] data;
-    delete[] isnull;
-}
-
 RC QL_IndexedJoinIterator::GetNextRec(RM_Record &rec) {
     int retcode = searchIter->GetNextRec(rec2);
     while (retcode == RM_EOF) {
@@ -56,12 +49,12 @@ RC QL_IndexedJoinIterator::GetNextRec(RM_Record &rec) {
     if (retcode) return retcode;
     TRY(rec2.GetData(data2));
     TRY(rec2.GetIsnull(isnull2));
+    char *data = rec.AllocData(joinedSize);
+    bool *isnull = rec.AllocIsnull(nullableNum);
     memcpy(data, data1, scanSize);
     memcpy(data + scanSize, data2, joinedSize - scanSize);
     memcpy(isnull, isnull1, sizeof(bool) * nullableNum1);
     memcpy(isnull + nullableNum1, isnull2, sizeof(bool) * (nullableNum - nullableNum1));
-    rec.SetData(data, joinedSize);
-    rec.SetIsnull(isnull, nullableNum);
     return 0;
 }
 
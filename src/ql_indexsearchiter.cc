@@ -8,7 +8,13 @@ QL_IndexSearchIterator::QL_IndexSearchIterator(QL_Condition condition)
         : QL_Iterator(), condition(condition) {
     QL_Iterator::rmm->OpenFile(condition.lhsAttr.relName, fileHandle);
     QL_Iterator::ixm->OpenIndex(condition.lhsAttr.relName, condition.lhsAttr.indexNo, indexHandle);
-    scan.OpenScan(indexHandle, condition.op, condition.rhsValue.data);
+    scan.OpenScan(indexHandle, condition.op, condition.rhsValue.data, RANDOM_LOOKUP);
+}
+
+QL_IndexSearchIterator::~QL_IndexSearchIterator() {
+    scan.CloseScan();
+    QL_Iterator::ixm->CloseIndex(indexHandle);
+    QL_Iterator::rmm->CloseFile(fileHandle);
 }
 
 void QL_IndexSearchIterator::ChangeValue(char *value) {
@@ -18,15 +24,18 @@ void QL_IndexSearchIterator::ChangeValue(char *value) {
 RC QL_IndexSearchIterator::GetNextRec(RM_Record &rec) {
     RID rid;
     int retcode = scan.GetNextEntry(rid);
-    if (retcode == IX_EOF) return RM_EOF;
+    if (retcode == IX_EOF) {
+        TRY(rec.Release());
+        return RM_EOF;
+    }
     TRY(retcode);
-    TRY(fileHandle.GetRec(rid, rec));
+    TRY(fileHandle.PinRec(rid, rec, RANDOM_LOOKUP));
     return 0;
 }
 
 RC QL_IndexSearchIterator::Reset() {
     TRY(scan.CloseScan());
-    TRY(scan.OpenScan(indexHandle, condition.op, condition.rhsValue.data));
+    TRY(scan.OpenScan(indexHandle, condition.op, condition.rhsValue.data, RANDOM_LOOKUP));
     return 0;
 }
 
@@ -23,6 +23,7 @@ public:
     QL_Iterator() {
         id = ++totalIters;
     }
+    virtual ~QL_Iterator() {}
 
     static void setRM(RM_Manager *rmm) {
         QL_Iterator::rmm = rmm;
@@ -42,10 +43,20 @@ public:
 
 class QL_FileScanIterator : public QL_Iterator {
     std::string relName;
+    bool bFiltered;             // condition is checked by the scan
+    QL_Condition condition;
     RM_FileHandle fileHandle;
     RM_FileScan scan;
+    RM_RecordBatch batch;       // the page being read
+    int batchPos;
+
+    RC OpenScan();
 public:
     QL_FileScanIterator(std::string relName);
+    // Only the records that satisfy a condition on an attribute of the
+    // relation and a value
+    QL_FileScanIterator(std::string relName, const QL_Condition &condition);
+    virtual ~QL_FileScanIterator();
 
     RC GetNextRec(RM_Record &rec) override;
     RC Reset() override;
@@ -68,14 +79,12 @@ class QL_ProjectionIterator : public QL_Iterator {
     AttrList projectFrom;
     AttrList projectTo;
 
+    RM_Record input;
     size_t projectedSize;
     short nullableNum;
-    char *data;
-    bool *isnull;
 public:
     QL_ProjectionIterator(QL_Iterator *iter,
                           const AttrList &projectFrom, const AttrList &projectTo);
-    virtual ~QL_ProjectionIterator();
 
     RC GetNextRec(RM_Record &rec) override;
     RC Reset() override;
@@ -89,6 +98,7 @@ class QL_IndexSearchIterator : public QL_Iterator {
     IX_IndexScan scan;
 public:
     QL_IndexSearchIterator(QL_Condition condition);
+    virtual ~QL_IndexSearchIterator();
     void ChangeValue(char *value);
 
     RC GetNextRec(RM_Record &rec) override;
@@ -106,12 +116,11 @@ class QL_NestedLoopJoinIterator : public QL_Iterator {
     RM_Record rec2;
     size_t joinedSize, rec1Size;
     short nullableNum, nullableNum1;
-    char *data, *data1, *data2;
-    bool *isnull, *isnull1, *isnull2;
+    char *data1, *data2;
+    bool *isnull1, *isnull2;
 public:
     QL_NestedLoopJoinIterator(QL_Iterator *iter1, const AttrList &rel1,
                               QL_Iterator *iter2, const AttrList &rel2);
-    virtual ~QL_NestedLoopJoinIterator();
 
     RC GetNextRec(RM_Record &rec) override;
     RC Reset() override;
@@ -130,13 +139,12 @@ class QL_IndexedJoinIterator : public QL_Iterator {
     RM_Record rec2;
     size_t joinedSize, scanSize;
     short nullableNum, nullableNum1;
-    char *data, *data1, *data2;
-    bool *isnull, *isnull1, *isnull2;
+    char *data1, *data2;
+    bool *isnull1, *isnull2;
 public:
     QL_IndexedJoinIterator(QL_Iterator *scanIter, const AttrList &scanRel,
                            QL_IndexSearchIterator *indexIter, int searchAttrOffset,
                            QL_Iterator *searchIter, const AttrList &searchRel);
-    virtual ~QL_IndexedJoinIterator();
 
     RC GetNextRec(RM_Record &rec) override;
     RC Reset() override;
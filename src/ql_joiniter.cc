@@ -18,19 +18,12 @@ QL_NestedLoopJoinIterator::QL_NestedLoopJoinIterator(QL_Iterator *iter1, const A
         joinedSize += upper_align<4>(info.attrSize);
         if (!(info.attrSpecs & ATTR_SPEC_NOTNULL)) ++nullableNum;
     }
-    data = new char[joinedSize];
-    isnull = new bool[nullableNum];
 
     inputIter1->GetNextRec(rec1);
     rec1.GetData(data1);
     rec1.GetIsnull(isnull1);
 }
 
-QL_NestedLoopJoinIterator::~QL_NestedLoopJoinIterator() {
-    delete[] data;
-    delete[] isnull;
-}
-
 RC QL_NestedLoopJoinIterator::GetNextRec(RM_Record &rec) {
     int retcode = inputIter2->GetNextRec(rec2);
     while (retcode == RM_EOF) {
@@ -46,12 +39,12 @@ RC QL_NestedLoopJoinIterator::GetNextRec(RM_Record &rec) {
     TRY(retcode);
     TRY(rec2.GetData(data2));
     TRY(rec2.GetIsnull(isnull2));
+    char *data = rec.AllocData(joinedSize);
+    bool *isnull = rec.AllocIsnull(nullableNum);
     memcpy(data, data1, rec1Size);
     memcpy(data + rec1Size, data2, joinedSize - rec1Size);
     memcpy(isnull, isnull1, sizeof(bool) * nullableNum1);
     memcpy(isnull + nullableNum1, isnull2, sizeof(bool) * (nullableNum - nullableNum1));
-    rec.SetData(data, joinedSize);
-    rec.SetIsnull(isnull, nullableNum);
     return 0;
 }
 
@@ -289,14 +289,30 @@ RC QL_Manager::Select(int nSelAttrs, const RelAttr *selAttrs,
         }
         return found;
     };
+    auto findScanCondition = [&](int relNum, QL_Condition &scanCondition) -> bool {
+        for (auto cond : simpleConditions[relNum]) {
+            if (!cond.bRhsIsAttr && cond.op != NO_OP &&
+                cond.op != ISNULL_OP && cond.op != NOTNULL_OP &&
+                ((cond.lhsAttr.attrType == INT && cond.rhsValue.type == VT_INT) ||
+                 (cond.lhsAttr.attrType == FLOAT && cond.rhsValue.type == VT_FLOAT))) {
+                scanCondition = cond;
+                return true;
+            }
+        }
+        return false;
+    };
     auto performSimpleOperationsWithIndex = [&](int relNum) {
-        QL_Condition indexedCondition;
+        QL_Condition indexedCondition, scanCondition;
         bool hasIndexedCondition = findIndexedCondition(relNum, indexedCondition);
         QL_Iterator *rhs;
         if (hasIndexedCondition) {
             rhs = new QL_IndexSearchIterator(indexedCondition);
             erase_from(simpleConditions[relNum], indexedCondition);
             VLOG(2) << relations[relNum] << " contains indexed condition";
+        } else if (findScanCondition(relNum, scanCondition)) {
+            // The scan compares the numbers of a page at a time
+            rhs = new QL_FileScanIterator(relations[relNum], scanCondition);
+            erase_from(simpleConditions[relNum], scanCondition);
         } else {
             rhs = new QL_FileScanIterator(relations[relNum]);
         }
@@ -435,6 +451,12 @@ RC QL_Manager::Select(int nSelAttrs, const RelAttr *selAttrs,
     }
     printer.PrintFooter(std::cout);
 
+    // Consumers before their inputs, so that the records they hold pinned
+    // are released before the files are closed
+    TRY(record.Release());
+    for (auto it = queryPlans.rbegin(); it != queryPlans.rend(); ++it)
+        delete *it;
+
     return 0;
 }
 
@@ -539,7 +561,7 @@ RC QL_Manager::Insert(const char *relName, int nValues, const Value *values) {
             if (attributes[i].attrSpecs & ATTR_SPEC_PRIMARYKEY) {
                 TRY(pIxm->OpenIndex(relName, attributes[i].indexNo, indexHandle));
                 RID rid;
-                TRY(scan.OpenScan(indexHandle, EQ_OP, this_values[i].data));
+                TRY(scan.OpenScan(indexHandle, EQ_OP, this_values[i].data, RANDOM_LOOKUP));
                 int retcode = scan.GetNextEntry(rid);
                 TRY(scan.CloseScan());
                 TRY(pIxm->CloseIndex(indexHandle));
@@ -12,17 +12,9 @@ QL_ProjectionIterator::QL_ProjectionIterator(QL_Iterator *iter, const AttrList &
         projectedSize += upper_align<4>(info.attrSize);
         if (!(info.attrSpecs & ATTR_SPEC_NOTNULL)) ++nullableNum;
     }
-    data = new char[projectedSize];
-    isnull = new bool[nullableNum];
-}
-
-QL_ProjectionIterator::~QL_ProjectionIterator() {
-    delete[] data;
-    delete[] isnull;
 }
 
 RC QL_ProjectionIterator::GetNextRec(RM_Record &rec) {
-    RM_Record input;
     char *inputData;
     bool *inputIsnull;
 	// prevent RM_EOF from triggering error reporting mechanism in TRY
@@ -34,13 +26,13 @@ RC QL_ProjectionIterator::GetNextRec(RM_Record &rec) {
 	}
     TRY(input.GetData(inputData));
     TRY(input.GetIsnull(inputIsnull));
+    char *data = rec.AllocData(projectedSize);
+    bool *isnull = rec.AllocIsnull(nullableNum);
     for (int i = 0; i < projectFrom.size(); ++i) {
         memcpy(data + projectTo[i].offset, inputData + projectFrom[i].offset, (size_t)projectTo[i].attrSize);
         if (!(projectFrom[i].attrSpecs & ATTR_SPEC_NOTNULL))
             isnull[projectTo[i].nullableIndex] = inputIsnull[projectFrom[i].nullableIndex];
     }
-    rec.SetData(data, projectedSize);
-    rec.SetIsnull(isnull, nullableNum);
     return 0;
 }
 
@@ -18,6 +18,24 @@ DEFINE_string(c, "-",
         "    reads commands from <file>\n" \
         "    use '-' (without quotes) to use interactive mode.");
 
+DEFINE_string(buffer_policy, "2q",
+        "page replacement policy of the buffer pool: lru or 2q");
+DEFINE_int32(buffer_pages, 4096,
+        "number of pages in the buffer pool");
+DEFINE_int32(buffer_pool_mb, 0,
+        "size of the buffer pool in megabytes, overrides buffer_pages");
+DEFINE_int32(readahead_pages, 32,
+        "max pages read ahead by a sequential scan, 0 to disable");
+DEFINE_int32(buffer_clean_pct, 10,
+        "percent of the buffer pool, next in line for replacement, that is "
+        "written back in the background, 0 to disable");
+DEFINE_bool(buffer_hugepages, false,
+        "back the buffer pool with transparent huge pages");
+DEFINE_bool(direct_io, false,
+        "open data files with O_DIRECT so the buffer pool is their only cache");
+DEFINE_int32(index_resident_pages, 64,
+        "internal nodes of each open index kept pinned in the buffer pool");
+
 DECLARE_bool(n);
 
 using namespace std;
@@ -39,6 +57,31 @@ int main(int argc, char *argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, true);
     google::InitGoogleLogging(argv[0]);
 
+    if (FLAGS_buffer_policy == "lru") {
+        pfm.SetReplacePolicy(PF_LRU);
+    } else {
+        CHECK(FLAGS_buffer_policy == "2q")
+            << "unknown buffer policy " << FLAGS_buffer_policy;
+        pfm.SetReplacePolicy(PF_2Q);
+    }
+
+    pfm.SetReadAhead(FLAGS_readahead_pages);
+    pfm.SetCleanTarget(FLAGS_buffer_clean_pct);
+    pfm.SetHugePages(FLAGS_buffer_hugepages);
+    pfm.SetDirectIO(FLAGS_direct_io);
+    ixm.SetResidentLimit(FLAGS_index_resident_pages);
+
+    if (FLAGS_buffer_pool_mb > 0) {
+        CHECK(smm.Set("buffer_pool_mb",
+                      std::to_string(FLAGS_buffer_pool_mb).c_str()) == 0)
+            << "cannot allocate a buffer pool of "
+            << FLAGS_buffer_pool_mb << " MB";
+    } else {
+        CHECK(pfm.ResizeBuffer(FLAGS_buffer_pages) == 0)
+            << "cannot allocate a buffer pool of "
+            << FLAGS_buffer_pages << " pages";
+    }
+
     if (FLAGS_c != "-") {
         yyin = fopen(FLAGS_c.c_str(), "r");
         CHECK(yyin != NULL) << "cannot open " << FLAGS_c;
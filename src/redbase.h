@@ -75,10 +75,12 @@ enum ValueType {
 };
 
 // Attribute specifications
+//   ATTR_SPEC_VARCHAR marks a STRING attribute stored at its actual length
 enum AttrSpec {
     ATTR_SPEC_NONE = 0x0,
     ATTR_SPEC_NOTNULL = 0x1,
     ATTR_SPEC_PRIMARYKEY = 0x2,
+    ATTR_SPEC_VARCHAR = 0x4,
 };
 
 //
@@ -93,8 +95,17 @@ enum CompOp {
 //
 // Pin Strategy Hint
 //
+// Tells the buffer manager how the pages fetched by a scan will be used.
+// SEQUENTIAL_SCAN pages are read once and are recycled through a small
+// ring of frames instead of replacing the rest of the buffer;
+// RANDOM_LOOKUP pages are cached as usual; KEEP_HOT pages are kept
+// resident longer than other pages.
+//
 enum ClientHint {
-    NO_HINT                                     // default value
+    NO_HINT,                                    // default value
+    SEQUENTIAL_SCAN,                            // each page is read once
+    RANDOM_LOOKUP,                              // point lookups
+    KEEP_HOT                                    // keep the page resident
 };
 
 //
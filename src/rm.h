@@ -23,18 +23,37 @@
 #include "pf.h"
 
 #include <glog/logging.h>
+#include <cstdint>
 #include <cstring>
 
 //
 // RM_Record: RM Record interface
 //
+// A record either owns a copy of its data, in a buffer that is kept and
+// reused by the records later read into it, or is a view of the record in
+// its page, which stays pinned in the buffer pool until the record is
+// released, reused or destroyed.  Views are made by PinRec and by scans
+// opened with pinRecords; a view must be released before its file is
+// closed, and its data must not be used after the record is deleted.
+//
 class RM_Record {
     friend class RM_FileHandle;
     friend class RM_FileScan;
+    friend class RM_RecordBatch;
 
-    char *pData;
+    char *pData;                        // the data, in buffer or in a page
     bool *isnull;
     RID rid;
+
+    char *buffer;                       // owned data, reused
+    size_t bufferSize;
+    bool *nullBuffer;                   // isnull, reused
+    short nullBufferNum;
+
+    const PF_FileHandle *pinnedFile;    // file of the page pinned, or NULL
+    PageNum pinnedPage;
+
+    void SetView(const PF_FileHandle &file, PageNum pageNum, char *data);
 public:
     RM_Record ();
     RM_Record(const RM_Record&) = delete;
@@ -45,6 +64,15 @@ public:
     void SetData(char *data, size_t size);
     void SetIsnull(bool* isnull, short nullableNum);
 
+    // Make this an owned record of `size' bytes (`nullableNum' flags) and
+    // return the data to be filled in, without copying anything
+    char *AllocData(size_t size);
+    bool *AllocIsnull(short nullableNum);
+
+    // Unpin the page of a view.  The record is uninitialized afterwards.
+    RC Release();
+    bool IsPinned() const { return pinnedFile != NULL; }
+
     // Return the data corresponding to the record.  Sets *pData to the
     // record contents.
     RC GetData(char *&pData) const;
@@ -60,6 +88,7 @@ public:
 class RM_FileHandle {
     friend class RM_Manager;
     friend class RM_FileScan;
+    friend class RM_RecordBatch;
 
     PF_FileHandle pfHandle;
     short recordSize;
@@ -71,12 +100,60 @@ class RM_FileHandle {
     short* nullableOffsets;
 
     bool isHeaderDirty;
+
+    // Files with VARCHAR attributes keep their records in slotted pages
+    // (rm_slotted.cc); the other files have varNum == 0
+    short varNum;
+    short *varOffsets;
+    short *varSizes;
+    int dataSize;                       // bytes in a page
+    int maxBodySize;                    // of a stored record
+    char *bodyBuffer;
+
+    // PAX files split the records of a page into a minipage per column;
+    // the other files have columnNum == 0
+    short columnNum;
+    short *columnOffsets;
+    short *columnWidths;
+
+    // The nullable flags of a record in a pinned page
+    void ReadIsnull(char *data, SlotNum slotNum, RM_Record &rec) const;
+
+    // A record in a pinned page, in either layout: the free-list link of
+    // a free slot, and copies of the record into and out of the page
+    short *FreeLink(char *data, SlotNum slotNum) const;
+    void WriteRec  (char *data, SlotNum slotNum, const char *pData) const;
+    void ReadRec   (char *data, SlotNum slotNum, char *pData) const;
+
+    int  EncodeRec   (const char *pData, const bool *isnull, char *body) const;
+    void DecodeRec   (const char *body, char *pData, bool *isnull) const;
+    // Decode the record in slotNum of a pinned page, following its
+    // forward.  RM_RECORD_DELETED if the slot holds no record of its own.
+    RC   ReadSlotted (char *page, SlotNum slotNum, char *pData, bool *isnull,
+                      ClientHint hint = NO_HINT) const;
+    RC   GetSlotted  (const RID &rid, RM_Record &rec, ClientHint hint) const;
+    RC   InsertSlotted(const char *pData, RID &rid, bool *isnull);
+    RC   DeleteSlotted(const RID &rid);
+    RC   UpdateSlotted(const RM_Record &rec);
+    // Store a body in a page with room for it
+    RC   PlaceBody   (const char *body, int length, RID &rid);
+    // Put a page with room for any record back on the free list
+    void NoteFreeSpace(char *page, PageNum pageNum);
+    // Remove the moved record a forward points to
+    RC   RemoveMoved (const char *forward);
 public:
     RM_FileHandle ();
     ~RM_FileHandle();
 
-    // Given a RID, return the record
-    RC GetRec     (const RID &rid, RM_Record &rec) const;
+    // Given a RID, return the record.  `hint' is passed on to the
+    // buffer manager.
+    RC GetRec     (const RID &rid, RM_Record &rec,
+                   ClientHint hint = NO_HINT) const;
+    // The same, but `rec' becomes a view of the record in its pinned page.
+    // The records of files with VARCHAR attributes and of PAX files are
+    // always copied.
+    RC PinRec     (const RID &rid, RM_Record &rec,
+                   ClientHint hint = NO_HINT) const;
 
     // Insert a new record
     //   `isnull' gives the information for each nullable fields
@@ -90,6 +167,52 @@ public:
     RC ForcePages (PageNum pageNum = ALL_PAGES);
 };
 
+//
+// RM_RecordBatch: the records of one page that satisfy the condition of
+// a scan (RM_FileScan::GetNextBatch).  The page stays pinned, and the
+// data of the records valid, until the batch is released, reused or
+// destroyed; release it before the file is closed.  The records of a
+// file with VARCHAR attributes are decoded into the batch instead, and
+// no page stays pinned.  Those of a PAX file are put together from the
+// columns when they are asked for.
+//
+class RM_RecordBatch {
+    friend class RM_FileScan;
+
+    const RM_FileHandle *fileHandle;    // NULL if no page is pinned
+    PageNum pageNum;
+    char *pageData;
+    SlotNum *slots;                     // slots of the records, in order
+    int numRecs;
+    int slotsSize;                      // room in slots
+
+    char *records;                      // decoded or PAX records
+    bool *nulls;
+    size_t recordsBytes;                // room in records
+    size_t nullsBytes;                  // room in nulls
+    short recordSize;
+    short nullableNum;
+
+    void Reserve(int numSlots);
+    void ReserveRecords(const RM_FileHandle &file, int numSlots);
+public:
+    RM_RecordBatch ();
+    RM_RecordBatch(const RM_RecordBatch&) = delete;
+    ~RM_RecordBatch();
+
+    RM_RecordBatch& operator=(const RM_RecordBatch&) = delete;
+
+    int  GetNumRecs() const { return numRecs; }
+    RID  GetRid    (int i) const { return RID(pageNum, slots[i]); }
+    char *GetData  (int i) const;       // the record in the page
+    void GetIsnull (int i, bool *isnull) const;
+
+    // Copy the i-th record into rec
+    void GetRec    (int i, RM_Record &rec) const;
+
+    RC Release();                       // unpin the page
+};
+
 //
 // RM_FileScan: condition-based scan of records in the file
 //
@@ -111,8 +234,22 @@ class RM_FileScan {
     SlotNum currentSlotNum;
     short recordSize;
     int nullableIndex;
+    int attrBase;               // the attribute of slot s of a page is at
+    int attrStride;             //   attrBase + s * attrStride from the
+                                //   end of the page header
+    ClientHint pinHint;
+    bool pinRecords;
+    uint64_t *matchBits;        // matches in a page, for the kernels of
+                                // INT and FLOAT comparisons; else NULL
 
-    bool checkSatisfy(char *data, bool isnull);
+    bool checkSatisfy(char *attr, bool isnull);
+    // Whether the record in slotNum of a pinned page is a match
+    bool slotSatisfies(char *data, SlotNum slotNum);
+    // The matches among slots from..cnt-1 of a pinned page, by the kernels
+    int matchPage(char *data, int from, int cnt, SlotNum *slots);
+    // GetNextRec and GetNextBatch for files with VARCHAR attributes
+    RC nextSlotted(RM_Record &rec);
+    RC nextSlottedBatch(RM_RecordBatch &batch);
 public:
     RM_FileScan  ();
     ~RM_FileScan ();
@@ -123,8 +260,13 @@ public:
                   int        attrOffset,
                   CompOp     compOp,
                   void       *value,
-                  ClientHint pinHint = NO_HINT); // Initialize a file scan
+                  ClientHint pinHint = NO_HINT,  // Initialize a file scan
+                  bool       pinRecords = false); // return views (PinRec)
     RC GetNextRec(RM_Record &rec);               // Get next matching record
+                                                 // (rec is released at EOF)
+    // The matching records of the rest of the page, or of the next page
+    // that has any.  It may be mixed with GetNextRec.
+    RC GetNextBatch(RM_RecordBatch &batch);
     RC CloseScan ();                             // Close the scan
 };
 
@@ -132,13 +274,21 @@ public:
 // RM_Manager: provides RM file management
 //
 class RM_Manager {
+    friend class SM_Manager;
     PF_Manager *pfm;
 public:
     RM_Manager    (PF_Manager &pfm);
     ~RM_Manager   ();
 
+    // The VARCHAR attributes are given by their offsets and sizes, in
+    // the order of their offsets.  columnNum > 0 makes a PAX file whose
+    // columns start at columnOffsets, in increasing order from 0; the
+    // VARCHAR attributes of a PAX file are stored at their full size.
     RC CreateFile (const char *fileName, int recordSize,
-            short nullableNum = 0, short *nullableOffsets = NULL);
+            short nullableNum = 0, short *nullableOffsets = NULL,
+            bool compressed = false,
+            short varNum = 0, short *varOffsets = NULL, short *varSizes = NULL,
+            short columnNum = 0, short *columnOffsets = NULL);
     RC DestroyFile(const char *fileName);
     RC OpenFile   (const char *fileName, RM_FileHandle &fileHandle);
 
@@ -160,8 +310,9 @@ void RM_PrintError(RC rc);
 #define RM_SCAN_NOT_CLOSED      (START_RM_WARN + 7)
 #define RM_LASTWARN             RM_SCAN_NOT_CLOSED
 
-#define RM_RECORDSIZE_TOO_LARGE (START_RM_ERR - 0) // record size larger than PF_PAGE_SIZE
+#define RM_RECORDSIZE_TOO_LARGE (START_RM_ERR - 0) // record size larger than a page
 #define RM_BAD_NULLABLE_NUM     (START_RM_ERR - 1) // nullableNum out of range
-#define RM_LASTERROR            RM_BAD_NULLABLE_NUM
+#define RM_BAD_COLUMNS          (START_RM_ERR - 2) // PAX columns out of order
+#define RM_LASTERROR            RM_BAD_COLUMNS
 
 #endif
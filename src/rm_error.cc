@@ -26,6 +26,7 @@ static const char *RM_WarnMsg[] = {
 static const char *RM_ErrorMsg[] = {
         "recordSize is too large for current pagefile system",
         "nullable num read from the header is out of range",
+        "column offsets of a PAX file are not in increasing order",
 };
 
 void RM_PrintError(RC rc) {
@@ -34,7 +35,7 @@ void RM_PrintError(RC rc) {
         // Print warning
         cerr << "RM warning: " << RM_WarnMsg[rc - START_RM_WARN] << "\n";
         // Error codes are negative, so invert everything
-    else if (-rc >= -START_RM_ERR && -rc < -RM_LASTERROR)
+    else if (-rc >= -START_RM_ERR && -rc <= -RM_LASTERROR)
         // Print error
         cerr << "RM error: " << RM_ErrorMsg[-rc + START_RM_ERR] << "\n";
     else if (rc == 0)
@@ -11,12 +11,30 @@
 /* RM FileHandle */
 RM_FileHandle::RM_FileHandle() {
     recordSize = 0;
+    nullableOffsets = NULL;
+    varNum = 0;
+    varOffsets = varSizes = NULL;
+    bodyBuffer = NULL;
+    columnNum = 0;
+    columnOffsets = columnWidths = NULL;
 }
 
 RM_FileHandle::~RM_FileHandle() {}
 
-RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec) const {
+RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec, ClientHint hint) const {
+    TRY(PinRec(rid, rec, hint));
+    if (!rec.IsPinned()) return 0;
+    // Take over the pin, copy the record out of the page and unpin it
+    char *view = rec.pData;
+    rec.pinnedFile = NULL;
+    memcpy(rec.AllocData((size_t)recordSize), view, (size_t)recordSize);
+    TRY(pfHandle.UnpinPage(rec.pinnedPage));
+    return 0;
+}
+
+RC RM_FileHandle::PinRec(const RID &rid, RM_Record &rec, ClientHint hint) const {
     if (recordSize == 0) return RM_FILE_NOT_OPENED;
+    if (varNum > 0) return GetSlotted(rid, rec, hint);
     PageNum pageNum;
     SlotNum slotNum;
     PF_PageHandle pageHandle;
@@ -25,40 +43,79 @@ RC RM_FileHandle::GetRec(const RID &rid, RM_Record &rec) const {
     TRY(rid.GetSlotNum(slotNum));
     if (slotNum >= recordsPerPage || slotNum < 0)
         return RM_SLOTNUM_OUT_OF_RANGE;
-    TRY(pfHandle.GetThisPage(pageNum, pageHandle));
+    TRY(pfHandle.GetThisPage(pageNum, pageHandle, hint));
     TRY(pageHandle.GetData(data));
 
     rec.rid = rid;
-    rec.SetData(data + pageHeaderSize + recordSize * slotNum, (size_t)recordSize);
+    if (columnNum > 0) {
+        ReadRec(data, slotNum, rec.AllocData((size_t)recordSize));
+        ReadIsnull(data, slotNum, rec);
+        TRY(pfHandle.UnpinPage(pageNum));
+        return 0;
+    }
+    rec.SetView(pfHandle, pageNum, data + pageHeaderSize + recordSize * slotNum);
+    ReadIsnull(data, slotNum, rec);
+    return 0;
+}
 
-    if (nullableNum > 0) {
-        bool *isnull = new bool[nullableNum];
-        for (int i = 0; i < nullableNum; ++i) {
-            isnull[i] = getBitMap(((RM_PageHeader *)data)->bitmap,
-                                  recordsPerPage + slotNum * nullableNum + i);
-        }
-        rec.SetIsnull(isnull, nullableNum);
+short *RM_FileHandle::FreeLink(char *data, SlotNum slotNum) const {
+    if (columnNum > 0)
+        return (short *)(data + pageHeaderSize + columnWidths[0] * slotNum);
+    return (short *)(data + pageHeaderSize + recordSize * slotNum);
+}
+
+void RM_FileHandle::WriteRec(char *data, SlotNum slotNum, const char *pData) const {
+    // pData may be a view of this very record
+    if (columnNum == 0) {
+        memmove(data + pageHeaderSize + recordSize * slotNum, pData, (size_t)recordSize);
+        return;
+    }
+    char *minipage = data + pageHeaderSize;
+    for (int i = 0; i < columnNum; ++i) {
+        memcpy(minipage + columnWidths[i] * slotNum, pData + columnOffsets[i],
+               (size_t)columnWidths[i]);
+        minipage += columnWidths[i] * recordsPerPage;
     }
+}
 
-    TRY(pfHandle.UnpinPage(pageNum));
-    return 0;
+void RM_FileHandle::ReadRec(char *data, SlotNum slotNum, char *pData) const {
+    if (columnNum == 0) {
+        memcpy(pData, data + pageHeaderSize + recordSize * slotNum, (size_t)recordSize);
+        return;
+    }
+    char *minipage = data + pageHeaderSize;
+    for (int i = 0; i < columnNum; ++i) {
+        memcpy(pData + columnOffsets[i], minipage + columnWidths[i] * slotNum,
+               (size_t)columnWidths[i]);
+        minipage += columnWidths[i] * recordsPerPage;
+    }
+}
+
+void RM_FileHandle::ReadIsnull(char *data, SlotNum slotNum, RM_Record &rec) const {
+    if (nullableNum == 0) return;
+    bool *isnull = rec.AllocIsnull(nullableNum);
+    for (int i = 0; i < nullableNum; ++i) {
+        isnull[i] = getBitMap(((RM_PageHeader *)data)->bitmap,
+                              recordsPerPage + slotNum * nullableNum + i);
+    }
 }
 
 RC RM_FileHandle::InsertRec(const char *pData, RID &rid, bool *isnull) {
     if (recordSize == 0) return RM_FILE_NOT_OPENED;
+    if (varNum > 0) return InsertSlotted(pData, rid, isnull);
     PageNum pageNum;
     SlotNum slotNum;
     PF_PageHandle pageHandle;
-    char *data, *destination;
+    char *data;
 
     if (firstFreePage != kLastFreePage) {
         TRY(pfHandle.GetThisPage(firstFreePage, pageHandle));
         TRY(pageHandle.GetPageNum(pageNum));
         TRY(pageHandle.GetData(data));
         slotNum = ((RM_PageHeader *)data)->firstFreeRecord;
-        destination = data + pageHeaderSize + recordSize * slotNum;
-        ((RM_PageHeader *)data)->firstFreeRecord = *(short *)destination;
-        if (*(short *)destination == kLastFreeRecord) {
+        short next = *FreeLink(data, slotNum);
+        ((RM_PageHeader *)data)->firstFreeRecord = next;
+        if (next == kLastFreeRecord) {
             firstFreePage = ((RM_PageHeader *)data)->nextFreePage;
             isHeaderDirty = true;
         }
@@ -77,13 +134,12 @@ RC RM_FileHandle::InsertRec(const char *pData, RID &rid, bool *isnull) {
                    (size_t)(recordsPerPage * (nullableNum + 1)));
         }
         slotNum = ((RM_PageHeader *)data)->allocatedRecords;
-        destination = data + pageHeaderSize + recordSize * slotNum;
         // LOG(INFO) << "recordSize = " << recordSize << " slotnum = " << slotNum;
         // LOG(INFO) << "recordsPerPage = " << recordsPerPage << " allocated = " <<
             // ((RM_PageHeader *)data)->allocatedRecords;
         ++((RM_PageHeader *)data)->allocatedRecords;
     }
-    memcpy(destination, pData, (size_t)recordSize);
+    WriteRec(data, slotNum, pData);
     setBitMap(((RM_PageHeader *)data)->bitmap, slotNum, true);
     for (int i = 0; i < nullableNum; ++i) {
         setBitMap(((RM_PageHeader *)data)->bitmap,
@@ -98,6 +154,7 @@ RC RM_FileHandle::InsertRec(const char *pData, RID &rid, bool *isnull) {
 
 RC RM_FileHandle::DeleteRec(const RID &rid) {
     if (recordSize == 0) return RM_FILE_NOT_OPENED;
+    if (varNum > 0) return DeleteSlotted(rid);
     PageNum pageNum;
     SlotNum slotNum;
     PF_PageHandle pageHandle;
@@ -112,7 +169,7 @@ RC RM_FileHandle::DeleteRec(const RID &rid) {
     if (getBitMap(((RM_PageHeader *)data)->bitmap, slotNum) == 0)
         return RM_RECORD_DELETED;
     setBitMap(((RM_PageHeader *)data)->bitmap, slotNum, false);
-    *(short *)(data + pageHeaderSize + recordSize * slotNum) = ((RM_PageHeader *)data)->firstFreeRecord;
+    *FreeLink(data, slotNum) = ((RM_PageHeader *)data)->firstFreeRecord;
     if (((RM_PageHeader *)data)->firstFreeRecord == kLastFreeRecord) {
         ((RM_PageHeader *)data)->nextFreePage = firstFreePage;
         firstFreePage = pageNum;
@@ -127,6 +184,7 @@ RC RM_FileHandle::DeleteRec(const RID &rid) {
 
 RC RM_FileHandle::UpdateRec(const RM_Record &rec) {
     if (recordSize == 0) return RM_FILE_NOT_OPENED;
+    if (varNum > 0) return UpdateSlotted(rec);
     PageNum pageNum;
     SlotNum slotNum;
     PF_PageHandle pageHandle;
@@ -138,7 +196,7 @@ RC RM_FileHandle::UpdateRec(const RM_Record &rec) {
     TRY(pfHandle.GetThisPage(pageNum, pageHandle));
     TRY(pageHandle.GetData(data));
 
-    memcpy(data + pageHeaderSize + recordSize * slotNum, rec.pData, (size_t)recordSize);
+    WriteRec(data, slotNum, rec.pData);
     for (int i = 0; i < nullableNum; ++i) {
         setBitMap(((RM_PageHeader *)data)->bitmap,
                   recordsPerPage + slotNum * nullableNum + i, rec.isnull[i]);
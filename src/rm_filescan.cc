@@ -9,11 +9,14 @@
 
 RM_FileScan::RM_FileScan() {
     scanOpened = false;
+    matchBits = NULL;
 }
 
-RM_FileScan::~RM_FileScan() {}
+RM_FileScan::~RM_FileScan() {
+    delete[] matchBits;
+}
 
-RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle, AttrType attrType, int attrLength, int attrOffset, CompOp compOp, void *value, ClientHint pinHint) {
+RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle, AttrType attrType, int attrLength, int attrOffset, CompOp compOp, void *value, ClientHint pinHint, bool pinRecords) {
     if (scanOpened) return RM_SCAN_NOT_CLOSED;
 
     this->fileHandle = &fileHandle;
@@ -21,6 +24,8 @@ RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle, AttrType attrType, int
     this->attrLength = attrLength;
     this->attrOffset = attrOffset;
     this->compOp = compOp;
+    this->pinHint = pinHint;
+    this->pinRecords = pinRecords;
     if (value == NULL) {
         this->value.stringVal = NULL;
     } else {
@@ -62,57 +67,240 @@ RC RM_FileScan::OpenScan(const RM_FileHandle &fileHandle, AttrType attrType, int
     currentSlotNum = 0;
     TRY(fileHandle.pfHandle.UnpinPage(0));
 
+    // In a PAX file the attribute is in the minipage of its column
+    attrBase = attrOffset;
+    attrStride = recordSize;
+    for (int i = fileHandle.columnNum - 1; i >= 0; --i) {
+        if (fileHandle.columnOffsets[i] <= attrOffset) {
+            attrBase = fileHandle.columnOffsets[i] * fileHandle.recordsPerPage +
+                       attrOffset - fileHandle.columnOffsets[i];
+            attrStride = fileHandle.columnWidths[i];
+            break;
+        }
+    }
+
+    // GetNextBatch compares numbers a page at a time
+    if (fileHandle.varNum == 0 && (attrType == INT || attrType == FLOAT) && value != NULL &&
+        compOp != NO_OP && compOp != ISNULL_OP && compOp != NOTNULL_OP)
+        matchBits = new uint64_t[(fileHandle.recordsPerPage + 63) / 64];
+
     return 0;
 }
 
 RC RM_FileScan::GetNextRec(RM_Record &rec) {
     if (!scanOpened) return RM_SCAN_NOT_OPENED;
+    if (fileHandle->varNum > 0) return nextSlotted(rec);
 
     char *data;
     PF_PageHandle pageHandle;
     bool found = false;
-    TRY(fileHandle->pfHandle.GetThisPage(currentPageNum, pageHandle));
+    TRY(fileHandle->pfHandle.GetThisPage(currentPageNum, pageHandle, pinHint));
     while (true) {
         TRY(pageHandle.GetData(data));
         int cnt = ((RM_PageHeader *)data)->allocatedRecords;
         unsigned char *bitMap = ((RM_PageHeader *)data)->bitmap;
-        for (; currentSlotNum < cnt; ++currentSlotNum) {
-            if (getBitMap(bitMap, currentSlotNum) == 0) continue;
-            char *pData = data + fileHandle->pageHeaderSize + recordSize * currentSlotNum;
-            bool isnull = false;
-            if (nullableIndex != -1) {
-                isnull = getBitMap(((RM_PageHeader *)data)->bitmap,
-                                   fileHandle->recordsPerPage +
-                                   currentSlotNum * fileHandle->nullableNum + nullableIndex);
-            }
-            if (checkSatisfy(pData, isnull)) {
+        for (currentSlotNum = nextBitMap(bitMap, currentSlotNum, cnt); currentSlotNum < cnt;
+             currentSlotNum = nextBitMap(bitMap, currentSlotNum + 1, cnt)) {
+            if (slotSatisfies(data, currentSlotNum)) {
                 found = true;
                 break;
             }
         }
-        TRY(fileHandle->pfHandle.UnpinPage(currentPageNum));
         if (found) break;
-        int rc = fileHandle->pfHandle.GetNextPage(currentPageNum, pageHandle);
-        if (rc == PF_EOF) return RM_EOF;
+        TRY(fileHandle->pfHandle.UnpinPage(currentPageNum));
+        int rc = fileHandle->pfHandle.GetNextPage(currentPageNum, pageHandle, pinHint);
+        if (rc == PF_EOF) {
+            TRY(rec.Release());
+            return RM_EOF;
+        }
         else if (rc != 0) return rc;
         TRY(pageHandle.GetPageNum(currentPageNum));
         currentSlotNum = 0;
     }
 
-    TRY(fileHandle->GetRec(RID(currentPageNum, currentSlotNum), rec));
+    // The page of the record is still pinned: hand the pin to a view, or
+    // copy the record and unpin the page
+    bool view = pinRecords && fileHandle->columnNum == 0;
+    rec.rid = RID(currentPageNum, currentSlotNum);
+    if (view) {
+        rec.SetView(fileHandle->pfHandle, currentPageNum,
+                    data + fileHandle->pageHeaderSize + recordSize * currentSlotNum);
+    } else {
+        fileHandle->ReadRec(data, currentSlotNum, rec.AllocData((size_t)recordSize));
+    }
+    fileHandle->ReadIsnull(data, currentSlotNum, rec);
+    if (!view)
+        TRY(fileHandle->pfHandle.UnpinPage(currentPageNum));
     ++currentSlotNum;
     return 0;
 }
 
+RC RM_FileScan::GetNextBatch(RM_RecordBatch &batch) {
+    if (!scanOpened) return RM_SCAN_NOT_OPENED;
+    if (fileHandle->varNum > 0) return nextSlottedBatch(batch);
+
+    TRY(batch.Release());
+    batch.Reserve(fileHandle->recordsPerPage);
+    // Only PAX records are gathered into the batch; the others are read
+    // in the page
+    batch.ReserveRecords(*fileHandle,
+                         fileHandle->columnNum > 0 ? fileHandle->recordsPerPage : 0);
+
+    char *data;
+    PF_PageHandle pageHandle;
+    TRY(fileHandle->pfHandle.GetThisPage(currentPageNum, pageHandle, pinHint));
+    while (true) {
+        TRY(pageHandle.GetData(data));
+        int cnt = ((RM_PageHeader *)data)->allocatedRecords;
+        unsigned char *bitMap = ((RM_PageHeader *)data)->bitmap;
+        int numRecs = 0;
+        if (matchBits != NULL) {
+            numRecs = matchPage(data, currentSlotNum, cnt, batch.slots);
+            currentSlotNum = cnt;
+        } else {
+            for (currentSlotNum = nextBitMap(bitMap, currentSlotNum, cnt); currentSlotNum < cnt;
+                 currentSlotNum = nextBitMap(bitMap, currentSlotNum + 1, cnt)) {
+                if (slotSatisfies(data, currentSlotNum))
+                    batch.slots[numRecs++] = currentSlotNum;
+            }
+        }
+        if (numRecs > 0) {
+            // The batch keeps the page pinned
+            batch.fileHandle = fileHandle;
+            batch.pageNum = currentPageNum;
+            batch.pageData = data;
+            batch.numRecs = numRecs;
+            return 0;
+        }
+        TRY(fileHandle->pfHandle.UnpinPage(currentPageNum));
+        int rc = fileHandle->pfHandle.GetNextPage(currentPageNum, pageHandle, pinHint);
+        if (rc == PF_EOF) return RM_EOF;
+        else if (rc != 0) return rc;
+        TRY(pageHandle.GetPageNum(currentPageNum));
+        currentSlotNum = 0;
+    }
+}
+
+RC RM_FileScan::nextSlotted(RM_Record &rec) {
+    char *data;
+    PF_PageHandle pageHandle;
+    TRY(fileHandle->pfHandle.GetThisPage(currentPageNum, pageHandle, pinHint));
+    while (true) {
+        TRY(pageHandle.GetData(data));
+        int cnt = ((RM_SlotPageHeader *)data)->numSlots;
+        for (; currentSlotNum < cnt; ++currentSlotNum) {
+            char *pData = rec.AllocData((size_t)recordSize);
+            bool *isnull = fileHandle->nullableNum > 0 ?
+                           rec.AllocIsnull(fileHandle->nullableNum) : NULL;
+            int rc = fileHandle->ReadSlotted(data, currentSlotNum, pData, isnull, pinHint);
+            if (rc == RM_RECORD_DELETED) continue;
+            else if (rc != 0) return rc;
+            if (checkSatisfy(pData + attrOffset, nullableIndex != -1 && isnull[nullableIndex])) {
+                rec.rid = RID(currentPageNum, currentSlotNum++);
+                TRY(fileHandle->pfHandle.UnpinPage(currentPageNum));
+                return 0;
+            }
+        }
+        TRY(fileHandle->pfHandle.UnpinPage(currentPageNum));
+        int rc = fileHandle->pfHandle.GetNextPage(currentPageNum, pageHandle, pinHint);
+        if (rc == PF_EOF) {
+            TRY(rec.Release());
+            return RM_EOF;
+        }
+        else if (rc != 0) return rc;
+        TRY(pageHandle.GetPageNum(currentPageNum));
+        currentSlotNum = 0;
+    }
+}
+
+RC RM_FileScan::nextSlottedBatch(RM_RecordBatch &batch) {
+    TRY(batch.Release());
+
+    char *data;
+    PF_PageHandle pageHandle;
+    TRY(fileHandle->pfHandle.GetThisPage(currentPageNum, pageHandle, pinHint));
+    while (true) {
+        TRY(pageHandle.GetData(data));
+        int cnt = ((RM_SlotPageHeader *)data)->numSlots;
+        batch.Reserve(cnt);
+        batch.ReserveRecords(*fileHandle, cnt);
+        int numRecs = 0;
+        for (; currentSlotNum < cnt; ++currentSlotNum) {
+            char *pData = batch.records + (size_t)numRecs * recordSize;
+            bool *isnull = batch.nulls + (size_t)numRecs * fileHandle->nullableNum;
+            int rc = fileHandle->ReadSlotted(data, currentSlotNum, pData, isnull, pinHint);
+            if (rc == RM_RECORD_DELETED) continue;
+            else if (rc != 0) return rc;
+            if (checkSatisfy(pData + attrOffset, nullableIndex != -1 && isnull[nullableIndex]))
+                batch.slots[numRecs++] = currentSlotNum;
+        }
+        // The records are copied out: the page need not stay pinned
+        TRY(fileHandle->pfHandle.UnpinPage(currentPageNum));
+        if (numRecs > 0) {
+            batch.pageNum = currentPageNum;
+            batch.numRecs = numRecs;
+            return 0;
+        }
+        int rc = fileHandle->pfHandle.GetNextPage(currentPageNum, pageHandle, pinHint);
+        if (rc == PF_EOF) return RM_EOF;
+        else if (rc != 0) return rc;
+        TRY(pageHandle.GetPageNum(currentPageNum));
+        currentSlotNum = 0;
+    }
+}
+
 RC RM_FileScan::CloseScan() {
     if (!scanOpened) return RM_SCAN_NOT_OPENED;
     scanOpened = false;
     if (attrType == STRING && value.stringVal != NULL)
         delete[] value.stringVal;
+    delete[] matchBits;
+    matchBits = NULL;
     return 0;
 }
 
-bool RM_FileScan::checkSatisfy(char *data, bool isnull) {
+int RM_FileScan::matchPage(char *data, int from, int cnt, SlotNum *slots) {
+    if (from >= cnt) return 0;
+    int numWords = (cnt + 63) / 64;
+    memset(matchBits, 0, numWords * sizeof(uint64_t));
+    char *attr = data + fileHandle->pageHeaderSize + attrBase;
+    if (attrType == INT)
+        RM_MatchInts(attr, attrStride, cnt, compOp, value.intVal, matchBits);
+    else
+        RM_MatchFloats(attr, attrStride, cnt, compOp, value.floatVal, matchBits);
+
+    // Keep the slots in use from `from' on whose attribute is not null
+    unsigned char *bitMap = ((RM_PageHeader *)data)->bitmap;
+    int numRecs = 0;
+    for (int w = from / 64; w < numWords; ++w) {
+        uint64_t word = matchBits[w] & loadBitMap(bitMap, w * 64);
+        if (w == from / 64)
+            word &= ~(uint64_t)0 << (from & 63);
+        for (; word != 0; word &= word - 1) {
+            int slotNum = w * 64 + __builtin_ctzll(word);
+            if (nullableIndex != -1 &&
+                getBitMap(bitMap, fileHandle->recordsPerPage +
+                                  slotNum * fileHandle->nullableNum + nullableIndex))
+                continue;
+            slots[numRecs++] = slotNum;
+        }
+    }
+    return numRecs;
+}
+
+bool RM_FileScan::slotSatisfies(char *data, SlotNum slotNum) {
+    if (compOp == NO_OP) return true;
+    bool isnull = false;
+    if (nullableIndex != -1) {
+        isnull = getBitMap(((RM_PageHeader *)data)->bitmap,
+                           fileHandle->recordsPerPage +
+                           slotNum * fileHandle->nullableNum + nullableIndex);
+    }
+    return checkSatisfy(data + fileHandle->pageHeaderSize + attrBase + attrStride * slotNum,
+                        isnull);
+}
+
+bool RM_FileScan::checkSatisfy(char *attr, bool isnull) {
     if (compOp == NO_OP) return true;
     if (compOp == ISNULL_OP) {
         return isnull;
@@ -123,7 +311,7 @@ bool RM_FileScan::checkSatisfy(char *data, bool isnull) {
     if (isnull) return false;
     switch (attrType) {
         case INT: {
-            int curVal = *(int *)(data + attrOffset);
+            int curVal = *(int *)attr;
             switch (compOp) {
                 case NO_OP:
                     return true;
@@ -144,7 +332,7 @@ bool RM_FileScan::checkSatisfy(char *data, bool isnull) {
             }
         }
         case FLOAT: {
-            float curVal = *(float *)(data + attrOffset);
+            float curVal = *(float *)attr;
             switch (compOp) {
                 case NO_OP:
                     return true;
@@ -165,7 +353,7 @@ bool RM_FileScan::checkSatisfy(char *data, bool isnull) {
             }
         }
         case STRING: {
-            char *curVal = data + attrOffset;
+            char *curVal = attr;
             switch (compOp) {
                 case NO_OP:
                     return true;
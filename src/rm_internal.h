@@ -5,6 +5,11 @@
 #ifndef RM_INTERNAL_H
 #define RM_INTERNAL_H
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "redbase.h"
+
 static const int kLastFreePage = -1;
 static const int kLastFreeRecord = -2;
 
@@ -23,6 +28,84 @@ struct RM_FileHeader {
     short nullableOffsets[1];
 };
 
+// Files with VARCHAR attributes have recordsPerPage == kSlottedPages.
+// Their header goes on after the nullable offsets with the number of
+// VARCHAR attributes and, for each, its offset and size in the record.
+static const short kSlottedPages = 0;
+
+// A page of such a file starts with an RM_SlotPageHeader and a directory
+// of slots; the records are packed at the end of the page, growing down
+// towards the directory.  A record is stored as a body: its kind, the
+// nullable flags (a bit each) and the record with each VARCHAR attribute
+// cut after its terminating '\0'.  A record that grows too large for its
+// page moves to another page, as a kMovedBody, and leaves a kForwardBody
+// holding the RID of the copy in its slot, so that its RID stays valid.
+struct RM_Slot {
+    unsigned short offset;          // of the body in the page
+    unsigned short length;          // 0 if the slot is free
+};
+
+struct RM_SlotPageHeader {
+    unsigned short numSlots;        // entries in the directory
+    unsigned short freeSlots;       // entries whose length is 0
+    unsigned short recordStart;     // the bodies fill the page from here on
+    unsigned short freeBytes;       // free space, holes included
+    short onFreeList;
+    short unused;
+    int nextFreePage;
+    RM_Slot slots[1];
+};
+
+// PAX files keep the page layout of the other files, but the space for
+// the records is split into a minipage per column: column c of slot s is
+// at colOffset[c] * recordsPerPage + s * width[c] from the end of the
+// page header, where the columns are the parts of the record between
+// consecutive column offsets.  The free-list link of a free slot is in
+// its first column.  After the VARCHAR part the header holds the number
+// of columns, 0 in the other files, and the offset of each.
+
+enum RM_BodyKind {
+    kRecordBody,
+    kForwardBody,                   // followed by the PageNum and SlotNum
+    kMovedBody                      // only reached through its forward
+};
+
+// Bodies are never shorter, so that any of them can become a forward
+static const int kForwardSize = 1 + 2 * sizeof(int);
+
+// The headers are stored on disk; keep their layout the same in 32-bit
+// and 64-bit builds
+static_assert(offsetof(RM_PageHeader, bitmap) == 8, "RM_PageHeader layout changed");
+static_assert(offsetof(RM_FileHeader, firstFreePage) == 8 &&
+              offsetof(RM_FileHeader, nullableOffsets) == 12,
+              "RM_FileHeader layout changed");
+static_assert(offsetof(RM_SlotPageHeader, nextFreePage) == 12 &&
+              offsetof(RM_SlotPageHeader, slots) == 16,
+              "RM_SlotPageHeader layout changed");
+
+inline void initSlotPage(char *page, int dataSize) {
+    RM_SlotPageHeader *header = (RM_SlotPageHeader *)page;
+    header->numSlots = 0;
+    header->freeSlots = 0;
+    header->recordStart = (unsigned short)dataSize;
+    header->freeBytes = (unsigned short)(dataSize - offsetof(RM_SlotPageHeader, slots));
+    header->onFreeList = 0;
+    header->unused = 0;
+    header->nextFreePage = kLastFreePage;
+}
+
+// The VARCHAR part of the header of a slotted file: the number of
+// VARCHAR attributes, then the offset and the size of each
+inline short *varHeader(RM_FileHeader *header) {
+    return header->nullableOffsets + header->nullableNum;
+}
+
+// The PAX part: the number of columns, then the offset of each
+inline short *columnHeader(RM_FileHeader *header) {
+    short *varInfo = varHeader(header);
+    return varInfo + 1 + 2 * varInfo[0];
+}
+
 inline bool getBitMap(unsigned char *bitMap, int pos) {
     return (bool)(bitMap[pos >> 3] >> (pos & 0x7) & 1);
 }
@@ -35,4 +118,44 @@ inline void setBitMap(unsigned char *bitMap, int pos, bool value) {
     }
 }
 
+// 64 bits of a bitmap from position `base' on, a multiple of 64
+inline uint64_t loadBitMap(const unsigned char *bitMap, int base) {
+    uint64_t word;
+    memcpy(&word, bitMap + (base >> 3), sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+// The first position from `pos' on and before `end' whose bit is set, or
+// `end' if there is none.  The bitmap is read 64 bits at a time; it may
+// be read up to 7 bytes past the byte of `end', which must still be in
+// the page.
+inline int nextBitMap(const unsigned char *bitMap, int pos, int end) {
+    while (pos < end) {
+        int base = pos & ~63;
+        uint64_t word = loadBitMap(bitMap, base) & (~(uint64_t)0 << (pos & 63));
+        if (word) {
+            pos = base + __builtin_ctzll(word);
+            return pos < end ? pos : end;
+        }
+        pos = base + 64;
+    }
+    return end;
+}
+
+// Predicate kernels (rm_predicate.cc).  For each of the n values that
+// lie `stride' bytes apart from `attr', set bit i of `match' (zeroed by
+// the caller, in the layout of loadBitMap) if value i satisfies
+// `op value'.  op is one of EQ_OP, NE_OP, LT_OP, GT_OP, LE_OP and GE_OP.
+void RM_MatchInts  (const char *attr, int stride, int n,
+                    CompOp op, int value, uint64_t *match);
+void RM_MatchFloats(const char *attr, int stride, int n,
+                    CompOp op, float value, uint64_t *match);
+
+// Let the kernels use AVX2 where the processor has it (the default), or
+// compare every value one by one.  For testing.
+void RM_SetPredicateAVX2(bool bOn);
+
 #endif //REBASE_RM_INTERNAL_H
@@ -7,6 +7,8 @@
 #include "rm_internal.h"
 
 #include <stddef.h>
+#include <algorithm>
+#include <climits>
 
 /* RM Manager */
 RM_Manager::RM_Manager(PF_Manager &pfm) {
@@ -16,14 +18,36 @@ RM_Manager::RM_Manager(PF_Manager &pfm) {
 RM_Manager::~RM_Manager() {}
 
 RC RM_Manager::CreateFile(const char *fileName, int recordSize,
-                          short nullableNum, short *nullableOffsets) {
-    if (recordSize > PF_PAGE_SIZE) {
+                          short nullableNum, short *nullableOffsets,
+                          bool compressed,
+                          short varNum, short *varOffsets, short *varSizes,
+                          short columnNum, short *columnOffsets) {
+    // records take the space of the pages of the current database
+    int dataSize;
+    TRY(pfm->GetDataSize(dataSize));
+    if (recordSize > dataSize || recordSize > SHRT_MAX) {
         return RM_RECORDSIZE_TOO_LARGE;
     }
-    if (sizeof(RM_PageHeader) + nullableNum * sizeof(short) > PF_PAGE_SIZE) {
+    if (columnNum > 0) {
+        varNum = 0;
+        // the first column also holds the free-list link of a free slot
+        if (columnOffsets[0] != 0) return RM_BAD_COLUMNS;
+        for (int i = 0; i < columnNum; ++i) {
+            int end = i + 1 < columnNum ? columnOffsets[i + 1] : recordSize;
+            if (end - columnOffsets[i] < (i == 0 ? (int)sizeof(short) : 1))
+                return RM_BAD_COLUMNS;
+        }
+    }
+    if (sizeof(RM_FileHeader) +
+        (nullableNum + 2 + 2 * varNum + columnNum) * sizeof(short) > (size_t)dataSize) {
+        return RM_RECORDSIZE_TOO_LARGE;
+    }
+    // a slotted page holds at least one record of the largest size
+    if (varNum > 0 && offsetof(RM_SlotPageHeader, slots) + sizeof(RM_Slot) + 1 +
+                      (nullableNum + 7) / 8 + recordSize > (size_t)dataSize) {
         return RM_RECORDSIZE_TOO_LARGE;
     }
-    pfm->CreateFile(fileName);
+    pfm->CreateFile(fileName, compressed);
     // initialize header
     PF_FileHandle fileHandle;
     PF_PageHandle pageHandle;
@@ -35,11 +59,12 @@ RC RM_Manager::CreateFile(const char *fileName, int recordSize,
 
     // total size = sizeof PageHeader + bitmap[ = records * (1 + nullable)] +
     //   records * recordSize
-    short recordsPerPage = (PF_PAGE_SIZE - sizeof(RM_PageHeader)) /
+    short recordsPerPage = (dataSize - sizeof(RM_PageHeader)) /
                            (recordSize + nullableNum + 1);
     if (upper_align<4>(recordsPerPage * (nullableNum + 1)) +
-        sizeof(RM_PageHeader) + recordSize * recordsPerPage > PF_PAGE_SIZE)
+        sizeof(RM_PageHeader) + recordSize * recordsPerPage > (size_t)dataSize)
         --recordsPerPage;
+    if (varNum > 0) recordsPerPage = kSlottedPages;
     fileHeader->recordSize = (short)recordSize;
     fileHeader->recordsPerPage = recordsPerPage;
     fileHeader->nullableNum = nullableNum;
@@ -47,6 +72,17 @@ RC RM_Manager::CreateFile(const char *fileName, int recordSize,
     for (int i = 0; i < nullableNum; ++i) {
         fileHeader->nullableOffsets[i] = nullableOffsets[i];
     }
+    short *varInfo = varHeader(fileHeader);
+    varInfo[0] = varNum;
+    for (int i = 0; i < varNum; ++i) {
+        varInfo[1 + 2 * i] = varOffsets[i];
+        varInfo[2 + 2 * i] = varSizes[i];
+    }
+    short *columnInfo = columnHeader(fileHeader);
+    columnInfo[0] = columnNum;
+    for (int i = 0; i < columnNum; ++i) {
+        columnInfo[1 + i] = columnOffsets[i];
+    }
 
     TRY(fileHandle.MarkDirty(0));
     TRY(fileHandle.UnpinPage(0));
@@ -54,9 +90,13 @@ RC RM_Manager::CreateFile(const char *fileName, int recordSize,
     TRY(fileHandle.AllocatePage(pageHandle));
     TRY(pageHandle.GetData(CVOID(pageHeader)));
 
-    *pageHeader = {kLastFreeRecord, 0, kLastFreePage};
-    memset(pageHeader + offsetof(RM_PageHeader, bitmap), 0,
-           (size_t)(recordsPerPage * (nullableNum + 1)));
+    if (varNum > 0) {
+        initSlotPage((char *)pageHeader, dataSize);
+    } else {
+        *pageHeader = {kLastFreeRecord, 0, kLastFreePage};
+        memset(pageHeader + offsetof(RM_PageHeader, bitmap), 0,
+               (size_t)(recordsPerPage * (nullableNum + 1)));
+    }
 
     TRY(fileHandle.MarkDirty(1));
     TRY(fileHandle.UnpinPage(1));
@@ -97,6 +137,39 @@ RC RM_Manager::OpenFile(const char *fileName, RM_FileHandle &fileHandle) {
     fileHandle.pageHeaderSize = sizeof(RM_PageHeader) + upper_align<4>(
             data->recordsPerPage * (1 + data->nullableNum));
 
+    fileHandle.varNum = 0;
+    fileHandle.varOffsets = fileHandle.varSizes = NULL;
+    fileHandle.bodyBuffer = NULL;
+    if (data->recordsPerPage == kSlottedPages) {
+        short *varInfo = varHeader(data);
+        fileHandle.varNum = varInfo[0];
+        fileHandle.varOffsets = new short[varInfo[0]];
+        fileHandle.varSizes = new short[varInfo[0]];
+        for (int i = 0; i < varInfo[0]; ++i) {
+            fileHandle.varOffsets[i] = varInfo[1 + 2 * i];
+            fileHandle.varSizes[i] = varInfo[2 + 2 * i];
+        }
+        TRY(pfHandle.GetDataSize(fileHandle.dataSize));
+        fileHandle.maxBodySize = std::max(kForwardSize,
+                1 + (data->nullableNum + 7) / 8 + data->recordSize);
+        fileHandle.bodyBuffer = new char[fileHandle.maxBodySize];
+    }
+
+    // Files written before the PAX layout have no columns: the rest of
+    // their header page is zero
+    short *columnInfo = columnHeader(data);
+    fileHandle.columnNum = columnInfo[0];
+    fileHandle.columnOffsets = fileHandle.columnWidths = NULL;
+    if (fileHandle.columnNum > 0) {
+        fileHandle.columnOffsets = new short[columnInfo[0]];
+        fileHandle.columnWidths = new short[columnInfo[0]];
+        for (int i = 0; i < columnInfo[0]; ++i) {
+            short end = i + 1 < columnInfo[0] ? columnInfo[2 + i] : data->recordSize;
+            fileHandle.columnOffsets[i] = columnInfo[1 + i];
+            fileHandle.columnWidths[i] = end - columnInfo[1 + i];
+        }
+    }
+
     TRY(pfHandle.UnpinPage(0));
     return 0;
 }
@@ -115,11 +188,19 @@ RC RM_Manager::CloseFile(RM_FileHandle &fileHandle) {
         for (int i = 0; i < fileHandle.nullableNum; ++i) {
             header->nullableOffsets[i] = fileHandle.nullableOffsets[i];
         }
-        delete[] fileHandle.nullableOffsets;
 
         TRY(fileHandle.pfHandle.MarkDirty(0));
         TRY(fileHandle.pfHandle.UnpinPage(0));
     }
+    delete[] fileHandle.nullableOffsets;
+    delete[] fileHandle.varOffsets;
+    delete[] fileHandle.varSizes;
+    delete[] fileHandle.bodyBuffer;
+    delete[] fileHandle.columnOffsets;
+    delete[] fileHandle.columnWidths;
+    fileHandle.nullableOffsets = fileHandle.varOffsets = fileHandle.varSizes = NULL;
+    fileHandle.columnOffsets = fileHandle.columnWidths = NULL;
+    fileHandle.bodyBuffer = NULL;
     TRY(pfm->CloseFile(fileHandle.pfHandle));
     return 0;
 }
@@ -0,0 +1,203 @@
+//
+// Predicate kernels: compare an attribute of every record of a page with
+// a constant and produce a bitmap of the records that match.
+//
+// The attribute is read at a fixed stride: the record size, or the size
+// of the value in the minipage of a PAX page.  With AVX2 eight values are
+// gathered, or loaded when they are contiguous, and compared at a time;
+// elsewhere, and for the last values of a page, they are compared one by
+// one.  The kernel for a comparison operator is chosen once per page, not
+// per record.
+//
+
+#include "rm_internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RM_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+template <typename T, CompOp op>
+inline bool compare(T lhs, T rhs) {
+    switch (op) {
+        case EQ_OP: return lhs == rhs;
+        case NE_OP: return lhs != rhs;
+        case LT_OP: return lhs < rhs;
+        case GT_OP: return lhs > rhs;
+        case LE_OP: return lhs <= rhs;
+        case GE_OP: return lhs >= rhs;
+        default: return false;
+    }
+}
+
+// Values from..n-1, one at a time
+template <typename T, CompOp op>
+void matchScalar(const char *attr, int stride, int from, int n,
+                 T value, uint64_t *match) {
+    for (int i = from; i < n; ++i) {
+        T x;
+        memcpy(&x, attr + (size_t)i * stride, sizeof(x));
+        if (compare<T, op>(x, value))
+            match[i >> 6] |= (uint64_t)1 << (i & 63);
+    }
+}
+
+#ifdef RM_HAVE_AVX2
+
+template <CompOp op>
+__attribute__((target("avx2")))
+inline __m256i compareInts(__m256i x, __m256i v) {
+    const __m256i ones = _mm256_set1_epi32(-1);
+    switch (op) {
+        case EQ_OP: return _mm256_cmpeq_epi32(x, v);
+        case NE_OP: return _mm256_xor_si256(_mm256_cmpeq_epi32(x, v), ones);
+        case LT_OP: return _mm256_cmpgt_epi32(v, x);
+        case GT_OP: return _mm256_cmpgt_epi32(x, v);
+        case LE_OP: return _mm256_xor_si256(_mm256_cmpgt_epi32(x, v), ones);
+        case GE_OP: return _mm256_xor_si256(_mm256_cmpgt_epi32(v, x), ones);
+        default: return _mm256_setzero_si256();
+    }
+}
+
+// The ordered predicates are false when either side is NaN and != is
+// true, as in C
+template <CompOp op>
+__attribute__((target("avx2")))
+inline __m256 compareFloats(__m256 x, __m256 v) {
+    switch (op) {
+        case EQ_OP: return _mm256_cmp_ps(x, v, _CMP_EQ_OQ);
+        case NE_OP: return _mm256_cmp_ps(x, v, _CMP_NEQ_UQ);
+        case LT_OP: return _mm256_cmp_ps(x, v, _CMP_LT_OQ);
+        case GT_OP: return _mm256_cmp_ps(x, v, _CMP_GT_OQ);
+        case LE_OP: return _mm256_cmp_ps(x, v, _CMP_LE_OQ);
+        case GE_OP: return _mm256_cmp_ps(x, v, _CMP_GE_OQ);
+        default: return _mm256_setzero_ps();
+    }
+}
+
+// Groups of eight values, gathered by their byte offsets.  Returns the
+// number of values done; the offsets of a page fit in 32 bits.
+template <CompOp op>
+__attribute__((target("avx2")))
+int matchIntsAVX2(const char *attr, int stride, int n, int value, uint64_t *match) {
+    int i = 0;
+    if (stride == (int)sizeof(int)) {
+        const __m256i v = _mm256_set1_epi32(value);
+        for (; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(attr + (size_t)i * stride));
+            unsigned bits = (unsigned)_mm256_movemask_ps(
+                    _mm256_castsi256_ps(compareInts<op>(x, v)));
+            match[i >> 6] |= (uint64_t)bits << (i & 63);
+        }
+        return i;
+    }
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                         _mm256_set1_epi32(stride));
+    const __m256i step = _mm256_set1_epi32(8 * stride);
+    const __m256i v = _mm256_set1_epi32(value);
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_i32gather_epi32((const int *)attr, offsets, 1);
+        offsets = _mm256_add_epi32(offsets, step);
+        unsigned bits = (unsigned)_mm256_movemask_ps(
+                _mm256_castsi256_ps(compareInts<op>(x, v)));
+        match[i >> 6] |= (uint64_t)bits << (i & 63);
+    }
+    return i;
+}
+
+template <CompOp op>
+__attribute__((target("avx2")))
+int matchFloatsAVX2(const char *attr, int stride, int n, float value, uint64_t *match) {
+    int i = 0;
+    if (stride == (int)sizeof(float)) {
+        const __m256 v = _mm256_set1_ps(value);
+        for (; i + 8 <= n; i += 8) {
+            __m256 x = _mm256_loadu_ps((const float *)(attr + (size_t)i * stride));
+            unsigned bits = (unsigned)_mm256_movemask_ps(compareFloats<op>(x, v));
+            match[i >> 6] |= (uint64_t)bits << (i & 63);
+        }
+        return i;
+    }
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                         _mm256_set1_epi32(stride));
+    const __m256i step = _mm256_set1_epi32(8 * stride);
+    const __m256 v = _mm256_set1_ps(value);
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_i32gather_ps((const float *)attr, offsets, 1);
+        offsets = _mm256_add_epi32(offsets, step);
+        unsigned bits = (unsigned)_mm256_movemask_ps(compareFloats<op>(x, v));
+        match[i >> 6] |= (uint64_t)bits << (i & 63);
+    }
+    return i;
+}
+
+bool avx2Enabled = true;
+
+bool hasAVX2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has && avx2Enabled;
+}
+
+template <CompOp op>
+void matchInts(const char *attr, int stride, int n, int value, uint64_t *match) {
+    int done = hasAVX2() ? matchIntsAVX2<op>(attr, stride, n, value, match) : 0;
+    matchScalar<int, op>(attr, stride, done, n, value, match);
+}
+
+template <CompOp op>
+void matchFloats(const char *attr, int stride, int n, float value, uint64_t *match) {
+    int done = hasAVX2() ? matchFloatsAVX2<op>(attr, stride, n, value, match) : 0;
+    matchScalar<float, op>(attr, stride, done, n, value, match);
+}
+
+#else
+
+template <CompOp op>
+void matchInts(const char *attr, int stride, int n, int value, uint64_t *match) {
+    matchScalar<int, op>(attr, stride, 0, n, value, match);
+}
+
+template <CompOp op>
+void matchFloats(const char *attr, int stride, int n, float value, uint64_t *match) {
+    matchScalar<float, op>(attr, stride, 0, n, value, match);
+}
+
+#endif
+
+}
+
+void RM_SetPredicateAVX2(bool bOn) {
+#ifdef RM_HAVE_AVX2
+    avx2Enabled = bOn;
+#else
+    (void)bOn;
+#endif
+}
+
+void RM_MatchInts(const char *attr, int stride, int n,
+                  CompOp op, int value, uint64_t *match) {
+    switch (op) {
+        case EQ_OP: matchInts<EQ_OP>(attr, stride, n, value, match); break;
+        case NE_OP: matchInts<NE_OP>(attr, stride, n, value, match); break;
+        case LT_OP: matchInts<LT_OP>(attr, stride, n, value, match); break;
+        case GT_OP: matchInts<GT_OP>(attr, stride, n, value, match); break;
+        case LE_OP: matchInts<LE_OP>(attr, stride, n, value, match); break;
+        case GE_OP: matchInts<GE_OP>(attr, stride, n, value, match); break;
+        default: break;
+    }
+}
+
+void RM_MatchFloats(const char *attr, int stride, int n,
+                    CompOp op, float value, uint64_t *match) {
+    switch (op) {
+        case EQ_OP: matchFloats<EQ_OP>(attr, stride, n, value, match); break;
+        case NE_OP: matchFloats<NE_OP>(attr, stride, n, value, match); break;
+        case LT_OP: matchFloats<LT_OP>(attr, stride, n, value, match); break;
+        case GT_OP: matchFloats<GT_OP>(attr, stride, n, value, match); break;
+        case LE_OP: matchFloats<LE_OP>(attr, stride, n, value, match); break;
+        case GE_OP: matchFloats<GE_OP>(attr, stride, n, value, match); break;
+        default: break;
+    }
+}
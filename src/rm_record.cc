@@ -7,31 +7,59 @@
 RM_Record::RM_Record() {
     pData = NULL;
     isnull = NULL;
+    buffer = NULL;
+    bufferSize = 0;
+    nullBuffer = NULL;
+    nullBufferNum = 0;
+    pinnedFile = NULL;
 }
 
 RM_Record::~RM_Record() {
-    if (pData != NULL) {
-        delete[] pData;
+    Release();
+    delete[] buffer;
+    delete[] nullBuffer;
+}
+
+RC RM_Record::Release() {
+    if (pinnedFile == NULL) return 0;
+    const PF_FileHandle *file = pinnedFile;
+    pinnedFile = NULL;
+    pData = NULL;
+    return file->UnpinPage(pinnedPage);
+}
+
+void RM_Record::SetView(const PF_FileHandle &file, PageNum pageNum, char *data) {
+    Release();
+    pinnedFile = &file;
+    pinnedPage = pageNum;
+    pData = data;
+}
+
+char *RM_Record::AllocData(size_t size) {
+    Release();
+    if (bufferSize < size) {
+        delete[] buffer;
+        buffer = new char[size];
+        bufferSize = size;
     }
-    if (isnull != NULL) {
-        delete[] isnull;
+    return pData = buffer;
+}
+
+bool *RM_Record::AllocIsnull(short nullableNum) {
+    if (nullBufferNum < nullableNum) {
+        delete[] nullBuffer;
+        nullBuffer = new bool[nullableNum];
+        nullBufferNum = nullableNum;
     }
+    return isnull = nullBuffer;
 }
 
 void RM_Record::SetData(char *data, size_t size) {
-    if (pData != NULL) {
-        delete[] pData;
-    }
-    pData = new char[size];
-    memcpy(pData, data, size);
+    memcpy(AllocData(size), data, size);
 }
 
 void RM_Record::SetIsnull(bool *isnull, short nullableNum) {
-    if (this->isnull != NULL) {
-        delete[] this->isnull;
-    }
-    this->isnull = new bool[nullableNum];
-    memcpy(this->isnull, isnull, nullableNum * sizeof(bool));
+    memcpy(AllocIsnull(nullableNum), isnull, nullableNum * sizeof(bool));
 }
 
 RC RM_Record::GetData(char *&pData) const {
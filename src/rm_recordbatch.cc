@@ -0,0 +1,92 @@
+//
+// The records of a page returned by RM_FileScan::GetNextBatch
+//
+
+#include "rm.h"
+#include "rm_internal.h"
+
+RM_RecordBatch::RM_RecordBatch() {
+    fileHandle = NULL;
+    slots = NULL;
+    numRecs = 0;
+    slotsSize = 0;
+    records = NULL;
+    nulls = NULL;
+    recordsBytes = 0;
+    nullsBytes = 0;
+    recordSize = 0;
+    nullableNum = 0;
+}
+
+RM_RecordBatch::~RM_RecordBatch() {
+    Release();
+    delete[] slots;
+    delete[] records;
+    delete[] nulls;
+}
+
+void RM_RecordBatch::Reserve(int numSlots) {
+    if (slotsSize < numSlots) {
+        delete[] slots;
+        slots = new SlotNum[numSlots];
+        slotsSize = numSlots;
+    }
+}
+
+// Room for numSlots records of file.  The batch may have held records of
+// another file before.
+void RM_RecordBatch::ReserveRecords(const RM_FileHandle &file, int numSlots) {
+    size_t numBytes = (size_t)numSlots * file.recordSize;
+    if (recordsBytes < numBytes) {
+        delete[] records;
+        records = new char[numBytes];
+        recordsBytes = numBytes;
+    }
+    numBytes = (size_t)numSlots * file.nullableNum;
+    if (nullsBytes < numBytes) {
+        delete[] nulls;
+        nulls = new bool[numBytes];
+        nullsBytes = numBytes;
+    }
+    recordSize = file.recordSize;
+    nullableNum = file.nullableNum;
+}
+
+RC RM_RecordBatch::Release() {
+    numRecs = 0;
+    if (fileHandle == NULL) return 0;
+    const RM_FileHandle *file = fileHandle;
+    fileHandle = NULL;
+    return file->pfHandle.UnpinPage(pageNum);
+}
+
+char *RM_RecordBatch::GetData(int i) const {
+    if (fileHandle == NULL) return records + (size_t)i * recordSize;
+    if (fileHandle->columnNum > 0) {
+        char *pData = records + (size_t)i * recordSize;
+        fileHandle->ReadRec(pageData, slots[i], pData);
+        return pData;
+    }
+    return pageData + fileHandle->pageHeaderSize + fileHandle->recordSize * slots[i];
+}
+
+void RM_RecordBatch::GetIsnull(int i, bool *isnull) const {
+    if (fileHandle == NULL) {
+        memcpy(isnull, nulls + (size_t)i * nullableNum, (size_t)nullableNum);
+        return;
+    }
+    for (int j = 0; j < fileHandle->nullableNum; ++j) {
+        isnull[j] = getBitMap(((RM_PageHeader *)pageData)->bitmap,
+                              fileHandle->recordsPerPage + slots[i] * fileHandle->nullableNum + j);
+    }
+}
+
+void RM_RecordBatch::GetRec(int i, RM_Record &rec) const {
+    rec.rid = GetRid(i);
+    if (fileHandle != NULL)
+        fileHandle->ReadRec(pageData, slots[i], rec.AllocData((size_t)recordSize));
+    else
+        memcpy(rec.AllocData((size_t)recordSize), GetData(i), (size_t)recordSize);
+    if (nullableNum > 0)
+        GetIsnull(i, rec.AllocIsnull(nullableNum));
+}
@@ -44,4 +44,8 @@ private:
     SlotNum slotNum;
 };
 
+// RIDs are stored in index buckets, so their layout must not depend on
+// the word size of the build
+static_assert(sizeof(RID) == 8, "RID layout changed");
+
 #endif
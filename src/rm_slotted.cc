@@ -0,0 +1,402 @@
+//
+// Records of files with VARCHAR attributes, kept in slotted pages
+//
+// A record is stored without the unused tail of its VARCHAR attributes,
+// so a page holds as many records as their actual sizes allow.  The upper
+// layers still see records of the fixed size: a VARCHAR attribute is
+// padded with '\0' when the record is read.  See rm_internal.h for the
+// layout of the pages.
+//
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "pf.h"
+#include "rm.h"
+#include "rm_internal.h"
+
+namespace {
+
+inline RM_SlotPageHeader *slotHeader(char *page) {
+    return (RM_SlotPageHeader *)page;
+}
+
+// Offset of the first byte after the slot directory
+inline int directoryEnd(const RM_SlotPageHeader *header) {
+    return (int)(offsetof(RM_SlotPageHeader, slots) + header->numSlots * sizeof(RM_Slot));
+}
+
+// Whether a new body of `length' bytes fits, in a free slot or a new one
+inline bool hasRoom(char *page, int length) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    int slotCost = header->freeSlots > 0 ? 0 : (int)sizeof(RM_Slot);
+    return header->freeBytes >= length + slotCost;
+}
+
+// Pack the bodies at the end of the page, so that the free space is all
+// between the directory and the bodies
+void compactPage(char *page, int dataSize) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    int start = header->recordStart;
+    std::vector<char> bodies(page + start, page + dataSize);
+    int end = dataSize;
+    for (int i = 0; i < header->numSlots; ++i) {
+        RM_Slot &slot = header->slots[i];
+        if (slot.length == 0) continue;
+        end -= slot.length;
+        memcpy(page + end, bodies.data() + (slot.offset - start), slot.length);
+        slot.offset = (unsigned short)end;
+    }
+    header->recordStart = (unsigned short)end;
+}
+
+// Take `length' bytes for slot from the free space, which has them
+void takeSpace(char *page, int dataSize, RM_Slot &slot, int length, int extra) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    if (header->recordStart - directoryEnd(header) < length + extra)
+        compactPage(page, dataSize);
+    header->recordStart = (unsigned short)(header->recordStart - length);
+    header->freeBytes = (unsigned short)(header->freeBytes - length);
+    slot.offset = header->recordStart;
+    slot.length = (unsigned short)length;
+}
+
+// Give the space of a slot back
+void freeSpace(char *page, RM_Slot &slot) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    header->freeBytes = (unsigned short)(header->freeBytes + slot.length);
+    if (slot.offset == header->recordStart)
+        header->recordStart = (unsigned short)(header->recordStart + slot.length);
+    slot.length = 0;
+}
+
+// Store a body in a page with room for it and return its slot
+SlotNum addBody(char *page, int dataSize, const char *body, int length) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    SlotNum slotNum;
+    if (header->freeSlots > 0) {
+        for (slotNum = 0; header->slots[slotNum].length != 0; ++slotNum);
+        --header->freeSlots;
+        takeSpace(page, dataSize, header->slots[slotNum], length, 0);
+    } else {
+        // make room for the entry before the directory grows into it
+        RM_Slot slot;
+        takeSpace(page, dataSize, slot, length, sizeof(RM_Slot));
+        slotNum = header->numSlots++;
+        header->freeBytes = (unsigned short)(header->freeBytes - sizeof(RM_Slot));
+        header->slots[slotNum] = slot;
+    }
+    memcpy(page + header->slots[slotNum].offset, body, (size_t)length);
+    return slotNum;
+}
+
+void removeBody(char *page, SlotNum slotNum) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    freeSpace(page, header->slots[slotNum]);
+    ++header->freeSlots;
+    // entries at the end of the directory are not referred to by any RID
+    while (header->numSlots > 0 && header->slots[header->numSlots - 1].length == 0) {
+        --header->numSlots;
+        --header->freeSlots;
+        header->freeBytes = (unsigned short)(header->freeBytes + sizeof(RM_Slot));
+    }
+}
+
+// Make the body of slotNum `length' bytes long, in place or elsewhere in
+// the page; its contents are to be written again.  False, and the page
+// unchanged, if the page has no room.
+bool resizeBody(char *page, int dataSize, SlotNum slotNum, int length) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    RM_Slot &slot = header->slots[slotNum];
+    if (length <= slot.length) {
+        header->freeBytes = (unsigned short)(header->freeBytes + slot.length - length);
+        slot.length = (unsigned short)length;
+        return true;
+    }
+    if (header->freeBytes + slot.length < length) return false;
+    freeSpace(page, slot);
+    takeSpace(page, dataSize, slot, length, 0);
+    return true;
+}
+
+inline void makeForward(char *body, PageNum pageNum, SlotNum slotNum) {
+    body[0] = kForwardBody;
+    memcpy(body + 1, &pageNum, sizeof(pageNum));
+    memcpy(body + 1 + sizeof(pageNum), &slotNum, sizeof(slotNum));
+}
+
+inline void readForward(const char *body, PageNum &pageNum, SlotNum &slotNum) {
+    memcpy(&pageNum, body + 1, sizeof(pageNum));
+    memcpy(&slotNum, body + 1 + sizeof(pageNum), sizeof(slotNum));
+}
+
+}
+
+int RM_FileHandle::EncodeRec(const char *pData, const bool *isnull, char *body) const {
+    char *p = body;
+    *p++ = kRecordBody;
+    int nullBytes = (nullableNum + 7) / 8;
+    memset(p, 0, (size_t)nullBytes);
+    for (int i = 0; i < nullableNum; ++i) {
+        if (isnull[i]) p[i >> 3] |= (char)(1 << (i & 7));
+    }
+    p += nullBytes;
+    // the string of a VARCHAR attribute is kept with its '\0', unless it
+    // fills the attribute
+    int from = 0;
+    for (int i = 0; i < varNum; ++i) {
+        memcpy(p, pData + from, (size_t)(varOffsets[i] - from));
+        p += varOffsets[i] - from;
+        size_t n = strnlen(pData + varOffsets[i], (size_t)varSizes[i]);
+        memcpy(p, pData + varOffsets[i], n);
+        p += n;
+        if (n < (size_t)varSizes[i]) *p++ = '\0';
+        from = varOffsets[i] + varSizes[i];
+    }
+    memcpy(p, pData + from, (size_t)(recordSize - from));
+    p += recordSize - from;
+    return std::max((int)(p - body), kForwardSize);
+}
+
+void RM_FileHandle::DecodeRec(const char *body, char *pData, bool *isnull) const {
+    const char *p = body + 1;
+    for (int i = 0; i < nullableNum; ++i) {
+        isnull[i] = (bool)(p[i >> 3] >> (i & 7) & 1);
+    }
+    p += (nullableNum + 7) / 8;
+    int from = 0;
+    for (int i = 0; i < varNum; ++i) {
+        memcpy(pData + from, p, (size_t)(varOffsets[i] - from));
+        p += varOffsets[i] - from;
+        size_t n = strnlen(p, (size_t)varSizes[i]);
+        memcpy(pData + varOffsets[i], p, n);
+        memset(pData + varOffsets[i] + n, 0, varSizes[i] - n);
+        p += n < (size_t)varSizes[i] ? n + 1 : n;
+        from = varOffsets[i] + varSizes[i];
+    }
+    memcpy(pData + from, p, (size_t)(recordSize - from));
+}
+
+RC RM_FileHandle::ReadSlotted(char *page, SlotNum slotNum, char *pData, bool *isnull,
+                              ClientHint hint) const {
+    RM_SlotPageHeader *header = slotHeader(page);
+    if (slotNum < 0 || slotNum >= header->numSlots)
+        return RM_SLOTNUM_OUT_OF_RANGE;
+    RM_Slot &slot = header->slots[slotNum];
+    if (slot.length == 0) return RM_RECORD_DELETED;
+    char *body = page + slot.offset;
+    if (body[0] == kMovedBody) return RM_RECORD_DELETED;
+    if (body[0] == kRecordBody) {
+        DecodeRec(body, pData, isnull);
+        return 0;
+    }
+
+    PageNum pageNum;
+    SlotNum movedSlot;
+    PF_PageHandle pageHandle;
+    char *moved;
+    readForward(body, pageNum, movedSlot);
+    TRY(pfHandle.GetThisPage(pageNum, pageHandle, hint));
+    TRY(pageHandle.GetData(moved));
+    DecodeRec(moved + slotHeader(moved)->slots[movedSlot].offset, pData, isnull);
+    TRY(pfHandle.UnpinPage(pageNum));
+    return 0;
+}
+
+RC RM_FileHandle::GetSlotted(const RID &rid, RM_Record &rec, ClientHint hint) const {
+    PageNum pageNum;
+    SlotNum slotNum;
+    PF_PageHandle pageHandle;
+    char *page;
+    TRY(rid.GetPageNum(pageNum));
+    TRY(rid.GetSlotNum(slotNum));
+    TRY(pfHandle.GetThisPage(pageNum, pageHandle, hint));
+    TRY(pageHandle.GetData(page));
+
+    rec.rid = rid;
+    RC rc = ReadSlotted(page, slotNum, rec.AllocData((size_t)recordSize),
+                        nullableNum > 0 ? rec.AllocIsnull(nullableNum) : NULL, hint);
+    TRY(pfHandle.UnpinPage(pageNum));
+    return rc;
+}
+
+RC RM_FileHandle::PlaceBody(const char *body, int length, RID &rid) {
+    PF_PageHandle pageHandle;
+    PageNum pageNum = kLastFreePage;
+    char *page;
+
+    // A page on the free list has room for any record, unless updates
+    // have taken it since; such a page leaves the list
+    while (firstFreePage != kLastFreePage) {
+        TRY(pfHandle.GetThisPage(firstFreePage, pageHandle));
+        TRY(pageHandle.GetData(page));
+        if (hasRoom(page, length)) {
+            pageNum = firstFreePage;
+            break;
+        }
+        PageNum full = firstFreePage;
+        slotHeader(page)->onFreeList = 0;
+        firstFreePage = slotHeader(page)->nextFreePage;
+        isHeaderDirty = true;
+        TRY(pfHandle.MarkDirty(full));
+        TRY(pfHandle.UnpinPage(full));
+    }
+    if (pageNum == kLastFreePage) {
+        TRY(pfHandle.GetLastPage(pageHandle));
+        TRY(pageHandle.GetPageNum(pageNum));
+        TRY(pageHandle.GetData(page));
+        if (!hasRoom(page, length)) {
+            TRY(pfHandle.UnpinPage(pageNum));
+            TRY(pfHandle.AllocatePage(pageHandle));
+            TRY(pageHandle.GetPageNum(pageNum));
+            TRY(pageHandle.GetData(page));
+            initSlotPage(page, dataSize);
+        }
+    }
+
+    SlotNum slotNum = addBody(page, dataSize, body, length);
+    if (pageNum == firstFreePage && !hasRoom(page, maxBodySize)) {
+        slotHeader(page)->onFreeList = 0;
+        firstFreePage = slotHeader(page)->nextFreePage;
+        isHeaderDirty = true;
+    }
+    rid = RID(pageNum, slotNum);
+
+    TRY(pfHandle.MarkDirty(pageNum));
+    TRY(pfHandle.UnpinPage(pageNum));
+    return 0;
+}
+
+void RM_FileHandle::NoteFreeSpace(char *page, PageNum pageNum) {
+    RM_SlotPageHeader *header = slotHeader(page);
+    if (header->onFreeList || !hasRoom(page, maxBodySize)) return;
+    header->onFreeList = 1;
+    header->nextFreePage = firstFreePage;
+    firstFreePage = pageNum;
+    isHeaderDirty = true;
+}
+
+RC RM_FileHandle::RemoveMoved(const char *forward) {
+    PageNum pageNum;
+    SlotNum slotNum;
+    PF_PageHandle pageHandle;
+    char *page;
+    readForward(forward, pageNum, slotNum);
+    TRY(pfHandle.GetThisPage(pageNum, pageHandle));
+    TRY(pageHandle.GetData(page));
+    removeBody(page, slotNum);
+    NoteFreeSpace(page, pageNum);
+    TRY(pfHandle.MarkDirty(pageNum));
+    TRY(pfHandle.UnpinPage(pageNum));
+    return 0;
+}
+
+RC RM_FileHandle::InsertSlotted(const char *pData, RID &rid, bool *isnull) {
+    int length = EncodeRec(pData, isnull, bodyBuffer);
+    return PlaceBody(bodyBuffer, length, rid);
+}
+
+RC RM_FileHandle::DeleteSlotted(const RID &rid) {
+    PageNum pageNum;
+    SlotNum slotNum;
+    PF_PageHandle pageHandle;
+    char *page;
+    TRY(rid.GetPageNum(pageNum));
+    TRY(rid.GetSlotNum(slotNum));
+    TRY(pfHandle.GetThisPage(pageNum, pageHandle));
+    TRY(pageHandle.GetData(page));
+
+    RM_SlotPageHeader *header = slotHeader(page);
+    RC rc = 0;
+    if (slotNum < 0 || slotNum >= header->numSlots) {
+        rc = RM_SLOTNUM_OUT_OF_RANGE;
+    } else if (header->slots[slotNum].length == 0 ||
+               page[header->slots[slotNum].offset] == kMovedBody) {
+        rc = RM_RECORD_DELETED;
+    }
+    if (rc != 0) {
+        TRY(pfHandle.UnpinPage(pageNum));
+        return rc;
+    }
+
+    if (page[header->slots[slotNum].offset] == kForwardBody)
+        TRY(RemoveMoved(page + header->slots[slotNum].offset));
+    removeBody(page, slotNum);
+    NoteFreeSpace(page, pageNum);
+
+    TRY(pfHandle.MarkDirty(pageNum));
+    TRY(pfHandle.UnpinPage(pageNum));
+    return 0;
+}
+
+RC RM_FileHandle::UpdateSlotted(const RM_Record &rec) {
+    PageNum pageNum;
+    SlotNum slotNum;
+    PF_PageHandle pageHandle;
+    char *page;
+    TRY(rec.rid.GetPageNum(pageNum));
+    TRY(rec.rid.GetSlotNum(slotNum));
+    TRY(pfHandle.GetThisPage(pageNum, pageHandle));
+    TRY(pageHandle.GetData(page));
+
+    RM_SlotPageHeader *header = slotHeader(page);
+    RC rc = 0;
+    if (slotNum < 0 || slotNum >= header->numSlots) {
+        rc = RM_SLOTNUM_OUT_OF_RANGE;
+    } else if (header->slots[slotNum].length == 0 ||
+               page[header->slots[slotNum].offset] == kMovedBody) {
+        rc = RM_RECORD_DELETED;
+    }
+    if (rc != 0) {
+        TRY(pfHandle.UnpinPage(pageNum));
+        return rc;
+    }
+
+    int length = EncodeRec(rec.pData, rec.isnull, bodyBuffer);
+    char *body = page + header->slots[slotNum].offset;
+    if (body[0] == kForwardBody) {
+        // Update the moved record where it is if it still fits there
+        PageNum movedPage;
+        SlotNum movedSlot;
+        PF_PageHandle movedHandle;
+        char *moved;
+        readForward(body, movedPage, movedSlot);
+        TRY(pfHandle.GetThisPage(movedPage, movedHandle));
+        TRY(movedHandle.GetData(moved));
+        if (resizeBody(moved, dataSize, movedSlot, length)) {
+            bodyBuffer[0] = kMovedBody;
+            memcpy(moved + slotHeader(moved)->slots[movedSlot].offset, bodyBuffer,
+                   (size_t)length);
+            NoteFreeSpace(moved, movedPage);
+            TRY(pfHandle.MarkDirty(movedPage));
+            TRY(pfHandle.UnpinPage(movedPage));
+            TRY(pfHandle.UnpinPage(pageNum));
+            return 0;
+        }
+        removeBody(moved, movedSlot);
+        NoteFreeSpace(moved, movedPage);
+        TRY(pfHandle.MarkDirty(movedPage));
+        TRY(pfHandle.UnpinPage(movedPage));
+    }
+
+    // In its own page if it fits, else moved away behind a forward
+    if (resizeBody(page, dataSize, slotNum, length)) {
+        memcpy(page + header->slots[slotNum].offset, bodyBuffer, (size_t)length);
+    } else {
+        RID movedRid;
+        PageNum movedPage;
+        SlotNum movedSlot;
+        bodyBuffer[0] = kMovedBody;
+        TRY(PlaceBody(bodyBuffer, length, movedRid));
+        TRY(movedRid.GetPageNum(movedPage));
+        TRY(movedRid.GetSlotNum(movedSlot));
+        resizeBody(page, dataSize, slotNum, kForwardSize);
+        makeForward(page + header->slots[slotNum].offset, movedPage, movedSlot);
+    }
+    NoteFreeSpace(page, pageNum);
+
+    TRY(pfHandle.MarkDirty(pageNum));
+    TRY(pfHandle.UnpinPage(pageNum));
+    return 0;
+}
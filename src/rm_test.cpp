@@ -21,10 +21,12 @@
 #include <cstdlib>
 #include <cassert>
 #include <unistd.h>
+#include <vector>
 
 #include "redbase.h"
 #include "pf.h"
 #include "rm.h"
+#include "rm_internal.h"
 
 using namespace std;
 
@@ -67,6 +69,27 @@ short NRecNullableOffsets[] = {
 
 const int NRecNullableNum = sizeof(NRecNullableOffsets) / sizeof(short);
 
+// Records with a VARCHAR attribute
+struct VRec {
+    int num;
+    char vstr[200]; // nullable VARCHAR(199)
+};
+
+short VRecVarOffsets[] = { (short)offsetof(VRec, vstr) };
+short VRecVarSizes[] = { (short)sizeof(((VRec *)0)->vstr) };
+
+// Columns of NRec and TestRec stored as PAX minipages
+short NRecColumnOffsets[] = {
+    (short)offsetof(NRec, num),
+    (short)offsetof(NRec, nstr),
+    (short)offsetof(NRec, ni),
+};
+short TestRecColumnOffsets[] = {
+    (short)offsetof(TestRec, str),
+    (short)offsetof(TestRec, num),
+    (short)offsetof(TestRec, r),
+};
+
 //
 // Global PF_Manager and RM_Manager variables
 //
@@ -84,6 +107,12 @@ RC Test5(void);
 RC Test6(void);
 RC Test7(void);
 RC Test8(void);
+RC Test9(void);
+RC Test10(void);
+RC Test11(void);
+RC Test12(void);
+RC Test13(void);
+RC Test14(void);
 
 void Test_PrintError(RC rc);
 void LsFile(char *fileName);
@@ -100,6 +129,15 @@ RC InsertRec(RM_FileHandle &fh, char *record, RID &rid);
 RC UpdateRec(RM_FileHandle &fh, RM_Record &rec);
 RC DeleteRec(RM_FileHandle &fh, RID &rid);
 RC GetNextRecScan(RM_FileScan &fs, RM_Record &rec);
+RC CountMatches(RM_FileHandle &fh, AttrType attrType, int attrOffset,
+                CompOp op, void *value, bool byBatch, int &count);
+RC VerifyVarFile(RM_FileHandle &fh, int numRecs, RID *rids, char (*strs)[200],
+                 bool *nulls, bool *deleted);
+RC VerifyPaxFile(RM_FileHandle &fh, int numRecs, RID *rids, NRec *recs,
+                 bool (*nulls)[2], bool *deleted);
+void FillBatchRec(char *pData, int recordSize, int num, bool bVar);
+RC ScanWithBatch(RM_RecordBatch &batch, int recordSize, short varNum,
+                 short columnNum, short *columnOffsets);
 
 //
 // Array of pointers to the test functions
@@ -114,6 +152,12 @@ int (*tests[])() =                      // RC doesn't work on some compilers
     Test6,
     Test7,
     Test8,
+    Test9,
+    Test10,
+    Test11,
+    Test12,
+    Test13,
+    Test14,
 };
 #define NUM_TESTS       ((int)((sizeof(tests)) / sizeof(tests[0])))    // number of tests
 
@@ -921,3 +965,739 @@ RC Test8(void) {
 
     return 0;
 }
+
+//
+// Test9 tests records pinned in the buffer pool
+//
+RC Test9(void) {
+    RC            rc;
+    RM_FileHandle fh;
+
+    LOG(INFO) << "test9 starting";
+
+    int n = 300;
+
+    if ((rc = CreateFile((char *)FILENAME, sizeof(TestRec))) ||
+        (rc = OpenFile((char *)FILENAME, fh)) ||
+        (rc = AddRecs(fh, n)))
+        return (rc);
+
+    RM_FileScan sc;
+    RM_Record rec;
+    TestRec *data;
+    RID rid;
+
+    // Every record of a scan is a view of its page, released at the end
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(TestRec, num),
+                NO_OP, NULL, NO_HINT, true));
+    int count = 0;
+    for (RC rc; rc = sc.GetNextRec(rec), rc != RM_EOF; ) {
+        if (rc) {
+            return rc;
+        }
+        CHECK(rec.IsPinned());
+        TRY(rec.GetData(CVOID(data)));
+        CHECK(data->num == count);
+        ++count;
+    }
+    CHECK(count == n);
+    CHECK(!rec.IsPinned());
+    CHECK(rec.GetData(CVOID(data)) == RM_UNINITIALIZED_RECORD);
+    TRY(sc.CloseScan());
+
+    // Update a record through its view
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(TestRec, num),
+                EQ_OP, &(count = 7), NO_HINT, true));
+    TRY(sc.GetNextRec(rec));
+    TRY(rec.GetRid(rid));
+    TRY(rec.GetData(CVOID(data)));
+    data->num = n;
+    TRY(fh.UpdateRec(rec));
+    TRY(rec.Release());
+    TRY(sc.CloseScan());
+
+    // A copy reuses its buffer
+    RM_Record copy;
+    char *buffer, *next;
+    TRY(fh.GetRec(rid, copy));
+    CHECK(!copy.IsPinned());
+    TRY(copy.GetData(buffer));
+    CHECK(((TestRec *)buffer)->num == n);
+    TRY(fh.GetRec(RID(1, 0), copy));
+    TRY(copy.GetData(next));
+    CHECK(next == buffer && ((TestRec *)next)->num == 0);
+
+    TRY(fh.PinRec(rid, rec));
+    CHECK(rec.IsPinned());
+    TRY(rec.GetData(CVOID(data)));
+    CHECK(data->num == n);
+
+    // Nothing may be left pinned when the file is closed
+    TRY(rec.Release());
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = DestroyFile((char *)FILENAME)))
+        return (rc);
+
+    LOG(INFO) << "test9 done";
+    return (0);
+}
+
+//
+// Test10 tests scanning a page at a time
+//
+RC Test10(void) {
+    RC            rc;
+    RM_FileHandle fh;
+
+    LOG(INFO) << "test10 starting";
+
+    int n = 1000;
+
+    if ((rc = CreateFile((char *)FILENAME, sizeof(TestRec))) ||
+        (rc = OpenFile((char *)FILENAME, fh)) ||
+        (rc = AddRecs(fh, n)))
+        return (rc);
+
+    RM_FileScan sc;
+    RM_Record rec;
+    RM_RecordBatch batch;
+    RID rid;
+
+    // Delete every third record
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(TestRec, num), NO_OP, NULL));
+    for (RC rc; rc = sc.GetNextRec(rec), rc != RM_EOF; ) {
+        if (rc) {
+            return rc;
+        }
+        TestRec *data;
+        TRY(rec.GetData(CVOID(data)));
+        TRY(rec.GetRid(rid));
+        if (data->num % 3 == 0)
+            TRY(fh.DeleteRec(rid));
+    }
+    TRY(sc.CloseScan());
+
+    // The batches hold the records left that match, in order
+    int limit = 800;
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(TestRec, num), LT_OP, &limit));
+    int expected = 1, numBatches = 0;
+    for (RC rc; rc = sc.GetNextBatch(batch), rc != RM_EOF; ) {
+        if (rc) {
+            return rc;
+        }
+        ++numBatches;
+        CHECK(batch.GetNumRecs() > 0);
+        for (int i = 0; i < batch.GetNumRecs(); ++i) {
+            CHECK(((TestRec *)batch.GetData(i))->num == expected);
+            batch.GetRec(i, rec);
+            TRY(rec.GetRid(rid));
+            CHECK(rid == batch.GetRid(i));
+            expected += expected % 3 == 1 ? 1 : 2;
+        }
+    }
+    CHECK(expected >= limit && expected < limit + 2);
+    CHECK(numBatches > 1 && batch.GetNumRecs() == 0);
+    TRY(sc.CloseScan());
+
+    // GetNextRec goes on where the batch ended, and the other way round
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(TestRec, num), NO_OP, NULL));
+    TRY(sc.GetNextRec(rec));
+    TRY(sc.GetNextBatch(batch));
+    CHECK(((TestRec *)batch.GetData(0))->num == 2);
+    int count = 1 + batch.GetNumRecs();
+    for (RC rc; rc = sc.GetNextRec(rec), rc != RM_EOF; ) {
+        if (rc) {
+            return rc;
+        }
+        ++count;
+    }
+    CHECK(count == n - (n + 2) / 3);
+    TRY(sc.CloseScan());
+
+    // Nothing may be left pinned when the file is closed
+    TRY(batch.Release());
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = DestroyFile((char *)FILENAME)))
+        return (rc);
+
+    LOG(INFO) << "test10 done";
+    return (0);
+}
+
+//
+// CountMatches
+//
+// Desc: Count the records of a scan, one at a time or a page at a time
+//
+RC CountMatches(RM_FileHandle &fh, AttrType attrType, int attrOffset,
+                CompOp op, void *value, bool byBatch, int &count)
+{
+    RM_FileScan sc;
+    RM_Record rec;
+    RM_RecordBatch batch;
+    RC rc;
+
+    count = 0;
+    TRY(sc.OpenScan(fh, attrType, 4, attrOffset, op, value));
+    if (byBatch) {
+        while ((rc = sc.GetNextBatch(batch)) == 0)
+            count += batch.GetNumRecs();
+    } else {
+        while ((rc = sc.GetNextRec(rec)) == 0)
+            ++count;
+    }
+    if (rc != RM_EOF)
+        return (rc);
+    TRY(sc.CloseScan());
+    return (0);
+}
+
+//
+// Test11 tests comparing numbers a page at a time
+//
+RC Test11(void) {
+    RM_FileHandle fh;
+
+    LOG(INFO) << "test11 starting";
+
+    TRY(rmm.CreateFile(FILENAME, sizeof(NRec),
+            NRecNullableNum, NRecNullableOffsets));
+    TRY(rmm.OpenFile(FILENAME, fh));
+
+    // Random numbers, some of them null, and some records deleted
+    NRec nr;
+    RID rid;
+    memset(&nr, 0, sizeof(nr));
+    srand(11);
+    for (int i = 0; i < 2000; ++i) {
+        nr.num = rand() % 200 - 100;
+        nr.ni = rand() % 200 - 100;
+        bool isnull[2] = {false, rand() % 5 == 0};
+        TRY(fh.InsertRec((char *)&nr, rid, isnull));
+        if (rand() % 7 == 0)
+            TRY(fh.DeleteRec(rid));
+    }
+
+    CompOp ops[] = {EQ_OP, NE_OP, LT_OP, GT_OP, LE_OP, GE_OP};
+    int values[] = {-101, -50, 0, 7, 99};
+    int offsets[] = {(int)offsetof(NRec, num), (int)offsetof(NRec, ni)};
+    // With and without the AVX2 kernels
+    for (int avx2 = 0; avx2 < 2; ++avx2) {
+        RM_SetPredicateAVX2(avx2);
+        for (int o = 0; o < 2; ++o)
+            for (CompOp op : ops)
+                for (int value : values) {
+                    int byRec, byBatch;
+                    TRY(CountMatches(fh, INT, offsets[o], op, &value, false, byRec));
+                    TRY(CountMatches(fh, INT, offsets[o], op, &value, true, byBatch));
+                    CHECK(byRec == byBatch);
+                }
+    }
+
+    TRY(rmm.CloseFile(fh));
+    TRY(rmm.DestroyFile((char *)FILENAME));
+
+    // Floats
+    RC rc;
+    if ((rc = CreateFile((char *)FILENAME, sizeof(TestRec))) ||
+        (rc = OpenFile((char *)FILENAME, fh)) ||
+        (rc = AddRecs(fh, 1000)))
+        return (rc);
+    float fvalues[] = {-1.0f, 0.0f, 333.0f, 333.5f, 2000.0f};
+    for (int avx2 = 0; avx2 < 2; ++avx2) {
+        RM_SetPredicateAVX2(avx2);
+        for (CompOp op : ops)
+            for (float value : fvalues) {
+                int byRec, byBatch;
+                TRY(CountMatches(fh, FLOAT, offsetof(TestRec, r), op, &value, false, byRec));
+                TRY(CountMatches(fh, FLOAT, offsetof(TestRec, r), op, &value, true, byBatch));
+                CHECK(byRec == byBatch);
+            }
+    }
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = DestroyFile((char *)FILENAME)))
+        return (rc);
+
+    LOG(INFO) << "test11 done";
+    return (0);
+}
+
+//
+// VerifyVarFile
+//
+// Desc: Check the records of Test12 by RID and by scans.  Record i has
+//       num i and is deleted if deleted[i].
+//
+RC VerifyVarFile(RM_FileHandle &fh, int numRecs, RID *rids, char (*strs)[200],
+                 bool *nulls, bool *deleted)
+{
+    RM_Record rec;
+    RM_FileScan sc;
+    RM_RecordBatch batch;
+    VRec *vr;
+    bool *isnull;
+    RC rc;
+
+    for (int i = 0; i < numRecs; ++i) {
+        if (deleted[i]) {
+            CHECK(fh.GetRec(rids[i], rec) != 0);
+            continue;
+        }
+        TRY(fh.GetRec(rids[i], rec));
+        TRY(rec.GetData((char *&)vr));
+        TRY(rec.GetIsnull(isnull));
+        CHECK(vr->num == i && isnull[0] == nulls[i]);
+        // the unused part of the string reads as '\0'
+        CHECK(memcmp(vr->vstr, strs[i], sizeof(vr->vstr)) == 0);
+    }
+
+    // Every record once, moved or not
+    std::vector<int> seen(numRecs, 0);
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(VRec, num), NO_OP, NULL));
+    while ((rc = sc.GetNextRec(rec)) == 0) {
+        RID rid;
+        TRY(rec.GetData((char *&)vr));
+        TRY(rec.GetRid(rid));
+        CHECK(vr->num >= 0 && vr->num < numRecs && !deleted[vr->num]);
+        CHECK(rid == rids[vr->num]);
+        CHECK(strcmp(vr->vstr, strs[vr->num]) == 0);
+        ++seen[vr->num];
+    }
+    if (rc != RM_EOF)
+        return (rc);
+    TRY(sc.CloseScan());
+    for (int i = 0; i < numRecs; ++i)
+        CHECK(seen[i] == (deleted[i] ? 0 : 1));
+
+    // The same by batches, with a condition on the string
+    char value[] = "m";
+    int count = 0;
+    int expected = 0;
+    for (int i = 0; i < numRecs; ++i)
+        if (!deleted[i] && !nulls[i] && strcmp(strs[i], value) < 0)
+            ++expected;
+    TRY(sc.OpenScan(fh, STRING, sizeof(value), offsetof(VRec, vstr), LT_OP, value));
+    while ((rc = sc.GetNextBatch(batch)) == 0) {
+        for (int i = 0; i < batch.GetNumRecs(); ++i) {
+            bool bNull;
+            vr = (VRec *)batch.GetData(i);
+            batch.GetIsnull(i, &bNull);
+            CHECK(!bNull && strcmp(vr->vstr, value) < 0);
+            CHECK(batch.GetRid(i) == rids[vr->num]);
+            ++count;
+        }
+    }
+    if (rc != RM_EOF)
+        return (rc);
+    TRY(sc.CloseScan());
+    CHECK(count == expected);
+
+    return (0);
+}
+
+//
+// Test12 tests records with a VARCHAR attribute
+//
+RC Test12(void) {
+    const int n = 3000;
+    RM_FileHandle fh;
+    RM_Record rec;
+    RC rc;
+
+    LOG(INFO) << "test12 starting";
+
+    short nullableOffset = offsetof(VRec, vstr);
+    TRY(rmm.CreateFile(FILENAME, sizeof(VRec), 1, &nullableOffset, false,
+                       1, VRecVarOffsets, VRecVarSizes));
+    TRY(rmm.OpenFile(FILENAME, fh));
+
+    static RID rids[n];
+    static char strs[n][200];
+    static bool nulls[n], deleted[n];
+    memset(strs, 0, sizeof(strs));
+
+    // Short strings: many records to a page
+    VRec vr;
+    srand(12);
+    for (int i = 0; i < n; ++i) {
+        memset(&vr, 0, sizeof(vr));
+        vr.num = i;
+        int len = rand() % 20;
+        for (int j = 0; j < len; ++j)
+            vr.vstr[j] = (char)('a' + rand() % 26);
+        memcpy(strs[i], vr.vstr, sizeof(vr.vstr));
+        nulls[i] = rand() % 10 == 0;
+        deleted[i] = false;
+        TRY(fh.InsertRec((char *)&vr, rids[i], &nulls[i]));
+    }
+    PageNum lastPage;
+    TRY(rids[n - 1].GetPageNum(lastPage));
+    CHECK(lastPage < n * (int)sizeof(VRec) / PF_PAGE_SIZE / 4);
+    TRY(VerifyVarFile(fh, n, rids, strs, nulls, deleted));
+
+    // New records go to the space of deleted ones
+    for (int i = 3; i < n; i += 4) {
+        TRY(fh.DeleteRec(rids[i]));
+        deleted[i] = true;
+    }
+    static RID moreRids[n / 8];
+    for (int i = 0; i < n / 8; ++i) {
+        memset(&vr, 0, sizeof(vr));
+        vr.num = n + i;
+        bool isnull = false;
+        TRY(fh.InsertRec((char *)&vr, moreRids[i], &isnull));
+        PageNum pageNum;
+        TRY(moreRids[i].GetPageNum(pageNum));
+        CHECK(pageNum <= lastPage);
+    }
+    for (int i = 0; i < n / 8; ++i)
+        TRY(fh.DeleteRec(moreRids[i]));
+
+    // Grow some strings to their full length, so that they have to move
+    // to other pages, shrink others and delete some
+    for (int i = 0; i < n; ++i) {
+        if (deleted[i]) continue;
+        int what = rand() % 4;
+        if (what == 0) {
+            TRY(fh.DeleteRec(rids[i]));
+            deleted[i] = true;
+            continue;
+        }
+        TRY(fh.GetRec(rids[i], rec));
+        VRec *data;
+        TRY(rec.GetData((char *&)data));
+        if (what == 1) {
+            memset(data->vstr, 'a' + i % 26, sizeof(data->vstr) - 1);
+        } else if (what == 2) {
+            memset(data->vstr, 0, sizeof(data->vstr));
+            data->vstr[0] = (char)('a' + i % 26);
+        }
+        memcpy(strs[i], data->vstr, sizeof(data->vstr));
+        TRY(fh.UpdateRec(rec));
+    }
+    TRY(VerifyVarFile(fh, n, rids, strs, nulls, deleted));
+
+    // Moved records grow and shrink again
+    for (int i = 0; i < n; ++i) {
+        if (deleted[i] || i % 3 != 0) continue;
+        TRY(fh.GetRec(rids[i], rec));
+        VRec *data;
+        TRY(rec.GetData((char *&)data));
+        int len = (int)strlen(data->vstr) > 10 ? 2 : 199;
+        memset(data->vstr, 0, sizeof(data->vstr));
+        memset(data->vstr, 'z', len);
+        memcpy(strs[i], data->vstr, sizeof(data->vstr));
+        TRY(fh.UpdateRec(rec));
+    }
+
+    // Everything is still there after the file is closed
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = OpenFile((char *)FILENAME, fh)))
+        return (rc);
+    TRY(VerifyVarFile(fh, n, rids, strs, nulls, deleted));
+
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = DestroyFile((char *)FILENAME)))
+        return (rc);
+
+    LOG(INFO) << "test12 done";
+    return (0);
+}
+
+//
+// VerifyPaxFile
+//
+// Desc: Check the records of Test13 by RID, by scans and by batches.
+//       Record i has num i and is deleted if deleted[i].
+//
+RC VerifyPaxFile(RM_FileHandle &fh, int numRecs, RID *rids, NRec *recs,
+                 bool (*nulls)[2], bool *deleted)
+{
+    RM_Record rec;
+    RM_FileScan sc;
+    RM_RecordBatch batch;
+    NRec *nr;
+    bool *isnull;
+    RC rc;
+
+    for (int i = 0; i < numRecs; ++i) {
+        if (deleted[i]) continue;
+        TRY(fh.GetRec(rids[i], rec));
+        TRY(rec.GetData((char *&)nr));
+        TRY(rec.GetIsnull(isnull));
+        CHECK(memcmp(nr, &recs[i], sizeof(NRec)) == 0);
+        CHECK(isnull[0] == nulls[i][0] && isnull[1] == nulls[i][1]);
+    }
+
+    // Every record once, gathered from its columns
+    std::vector<int> seen(numRecs, 0);
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(NRec, num), NO_OP, NULL));
+    while ((rc = sc.GetNextRec(rec)) == 0) {
+        RID rid;
+        TRY(rec.GetData((char *&)nr));
+        TRY(rec.GetRid(rid));
+        CHECK(nr->num >= 0 && nr->num < numRecs && !deleted[nr->num]);
+        CHECK(rid == rids[nr->num]);
+        CHECK(memcmp(nr, &recs[nr->num], sizeof(NRec)) == 0);
+        ++seen[nr->num];
+    }
+    if (rc != RM_EOF)
+        return (rc);
+    TRY(sc.CloseScan());
+    for (int i = 0; i < numRecs; ++i)
+        CHECK(seen[i] == (deleted[i] ? 0 : 1));
+
+    // Conditions on the nullable column, a record and a batch at a time
+    CompOp ops[] = {EQ_OP, NE_OP, LT_OP, GT_OP, LE_OP, GE_OP};
+    int values[] = {-101, -50, 0, 7, 99};
+    for (CompOp op : ops)
+        for (int value : values) {
+            int expected = 0;
+            for (int i = 0; i < numRecs; ++i) {
+                if (deleted[i] || nulls[i][1]) continue;
+                int x = recs[i].ni;
+                switch (op) {
+                    case EQ_OP: expected += x == value; break;
+                    case NE_OP: expected += x != value; break;
+                    case LT_OP: expected += x < value; break;
+                    case GT_OP: expected += x > value; break;
+                    case LE_OP: expected += x <= value; break;
+                    case GE_OP: expected += x >= value; break;
+                    default: break;
+                }
+            }
+            int byRec, byBatch;
+            TRY(CountMatches(fh, INT, offsetof(NRec, ni), op, &value, false, byRec));
+            TRY(CountMatches(fh, INT, offsetof(NRec, ni), op, &value, true, byBatch));
+            CHECK(byRec == expected && byBatch == expected);
+        }
+
+    int value = 0;
+    TRY(sc.OpenScan(fh, INT, sizeof(int), offsetof(NRec, ni), GT_OP, &value));
+    while ((rc = sc.GetNextBatch(batch)) == 0) {
+        for (int i = 0; i < batch.GetNumRecs(); ++i) {
+            bool bNull[2];
+            nr = (NRec *)batch.GetData(i);
+            batch.GetIsnull(i, bNull);
+            CHECK(nr->ni > 0 && !bNull[1]);
+            CHECK(memcmp(nr, &recs[nr->num], sizeof(NRec)) == 0);
+            CHECK(batch.GetRid(i) == rids[nr->num]);
+            batch.GetRec(i, rec);
+            TRY(rec.GetData((char *&)nr));
+            CHECK(memcmp(nr, &recs[nr->num], sizeof(NRec)) == 0);
+        }
+    }
+    if (rc != RM_EOF)
+        return (rc);
+    TRY(sc.CloseScan());
+
+    return (0);
+}
+
+//
+// Test13 tests files whose pages keep each column in a minipage
+//
+RC Test13(void) {
+    const int n = 2000;
+    RM_FileHandle fh;
+    RM_Record rec;
+    RC rc;
+
+    LOG(INFO) << "test13 starting";
+
+    // The first column holds the free-list link
+    short badOffsets[] = {0, 1};
+    CHECK(rmm.CreateFile(FILENAME, sizeof(NRec), NRecNullableNum,
+                         NRecNullableOffsets, false, 0, NULL, NULL,
+                         2, badOffsets) == RM_BAD_COLUMNS);
+
+    TRY(rmm.CreateFile(FILENAME, sizeof(NRec), NRecNullableNum,
+                       NRecNullableOffsets, false, 0, NULL, NULL,
+                       3, NRecColumnOffsets));
+    TRY(rmm.OpenFile(FILENAME, fh));
+
+    static RID rids[n];
+    static NRec recs[n];
+    static bool nulls[n][2], deleted[n];
+    memset(recs, 0, sizeof(recs));
+
+    srand(13);
+    for (int i = 0; i < n; ++i) {
+        recs[i].num = i;
+        sprintf(recs[i].nstr, "s%d", rand() % 1000);
+        recs[i].ni = rand() % 200 - 100;
+        nulls[i][0] = false;
+        nulls[i][1] = rand() % 5 == 0;
+        deleted[i] = false;
+        TRY(fh.InsertRec((char *)&recs[i], rids[i], nulls[i]));
+    }
+    TRY(VerifyPaxFile(fh, n, rids, recs, nulls, deleted));
+
+    // Delete some and fill their slots again
+    PageNum lastPage;
+    TRY(rids[n - 1].GetPageNum(lastPage));
+    for (int i = 0; i < n; i += 7) {
+        TRY(fh.DeleteRec(rids[i]));
+        deleted[i] = true;
+    }
+    TRY(VerifyPaxFile(fh, n, rids, recs, nulls, deleted));
+    for (int i = 0; i < n; i += 14) {
+        PageNum pageNum;
+        recs[i].ni = -recs[i].ni;
+        deleted[i] = false;
+        TRY(fh.InsertRec((char *)&recs[i], rids[i], nulls[i]));
+        TRY(rids[i].GetPageNum(pageNum));
+        CHECK(pageNum <= lastPage);
+    }
+
+    // Change every column of some records
+    for (int i = 1; i < n; i += 3) {
+        if (deleted[i]) continue;
+        NRec *data;
+        bool *isnull;
+        TRY(fh.GetRec(rids[i], rec));
+        TRY(rec.GetData((char *&)data));
+        TRY(rec.GetIsnull(isnull));
+        data->ni += 1;
+        sprintf(data->nstr, "u%d", i);
+        isnull[1] = !isnull[1];
+        memcpy(&recs[i], data, sizeof(NRec));
+        nulls[i][1] = isnull[1];
+        TRY(fh.UpdateRec(rec));
+    }
+    TRY(VerifyPaxFile(fh, n, rids, recs, nulls, deleted));
+
+    // Everything is still there after the file is closed
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = OpenFile((char *)FILENAME, fh)))
+        return (rc);
+    TRY(VerifyPaxFile(fh, n, rids, recs, nulls, deleted));
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = DestroyFile((char *)FILENAME)))
+        return (rc);
+
+    // Floats, in a file of records added as for the other tests
+    TRY(rmm.CreateFile(FILENAME, sizeof(TestRec), 0, NULL, false, 0, NULL, NULL,
+                       3, TestRecColumnOffsets));
+    if ((rc = OpenFile((char *)FILENAME, fh)) ||
+        (rc = AddRecs(fh, 1000)) ||
+        (rc = VerifyFile(fh, 1000)))
+        return (rc);
+    CompOp ops[] = {EQ_OP, NE_OP, LT_OP, GT_OP, LE_OP, GE_OP};
+    float fvalues[] = {-1.0f, 0.0f, 333.0f, 333.5f, 2000.0f};
+    for (CompOp op : ops)
+        for (float value : fvalues) {
+            int byRec, byBatch;
+            TRY(CountMatches(fh, FLOAT, offsetof(TestRec, r), op, &value, false, byRec));
+            TRY(CountMatches(fh, FLOAT, offsetof(TestRec, r), op, &value, true, byBatch));
+            CHECK(byRec == byBatch);
+        }
+    float value = 333.0f;
+    int count;
+    TRY(CountMatches(fh, FLOAT, offsetof(TestRec, r), LT_OP, &value, true, count));
+    CHECK(count == 333);
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = DestroyFile((char *)FILENAME)))
+        return (rc);
+
+    LOG(INFO) << "test13 done";
+    return (0);
+}
+
+//
+// FillBatchRec
+//
+// Desc: Contents of record num of a Test14 file.  In a file with a VARCHAR
+//       attribute everything after the int is the string.
+//
+void FillBatchRec(char *pData, int recordSize, int num, bool bVar)
+{
+    memset(pData, 0, recordSize);
+    memcpy(pData, &num, sizeof(int));
+    if (bVar) {
+        int len = num % (recordSize - (int)sizeof(int));
+        memset(pData + sizeof(int), 'a' + num % 26, len);
+    } else {
+        for (int j = sizeof(int); j < recordSize; ++j)
+            pData[j] = (char)(num + j);
+    }
+}
+
+//
+// ScanWithBatch
+//
+// Desc: Create a file of the given layout, fill it and read it back with
+//       batch.  The VARCHAR attribute, if any, starts after an int.
+//
+RC ScanWithBatch(RM_RecordBatch &batch, int recordSize, short varNum,
+                 short columnNum, short *columnOffsets)
+{
+    const int n = 1000;
+    RM_FileHandle fh;
+    RM_FileScan sc;
+    RID rid;
+    RC rc;
+
+    short nullableOffset = 0;
+    short varOffset = sizeof(int);
+    short varSize = recordSize - sizeof(int);
+    TRY(rmm.CreateFile(FILENAME, recordSize, 1, &nullableOffset, false,
+                       varNum, &varOffset, &varSize, columnNum, columnOffsets));
+    TRY(rmm.OpenFile(FILENAME, fh));
+
+    std::vector<char> rec(recordSize), expected(recordSize);
+    bool isnull = false;
+    for (int i = 0; i < n; ++i) {
+        FillBatchRec(rec.data(), recordSize, i, varNum > 0);
+        TRY(fh.InsertRec(rec.data(), rid, &isnull));
+    }
+
+    std::vector<int> seen(n, 0);
+    TRY(sc.OpenScan(fh, INT, sizeof(int), 0, NO_OP, NULL));
+    while ((rc = sc.GetNextBatch(batch)) == 0) {
+        for (int i = 0; i < batch.GetNumRecs(); ++i) {
+            char *pData = batch.GetData(i);
+            int num;
+            memcpy(&num, pData, sizeof(int));
+            CHECK(num >= 0 && num < n);
+            FillBatchRec(expected.data(), recordSize, num, varNum > 0);
+            CHECK(memcmp(pData, expected.data(), recordSize) == 0);
+            ++seen[num];
+        }
+    }
+    if (rc != RM_EOF)
+        return (rc);
+    TRY(sc.CloseScan());
+    TRY(batch.Release());
+    for (int i = 0; i < n; ++i)
+        CHECK(seen[i] == 1);
+
+    if ((rc = CloseFile((char *)FILENAME, fh)) ||
+        (rc = DestroyFile((char *)FILENAME)))
+        return (rc);
+    return (0);
+}
+
+//
+// Test14 tests reusing one batch for files of different layouts and
+// record sizes
+//
+RC Test14(void) {
+    RM_RecordBatch batch;
+    short columnOffsets[] = {0, 4};
+
+    LOG(INFO) << "test14 starting";
+
+    // PAX records grow
+    TRY(ScanWithBatch(batch, 4, 0, 1, columnOffsets));
+    TRY(ScanWithBatch(batch, 8, 0, 2, columnOffsets));
+    // Slotted records grow after a fixed file of the same size
+    TRY(ScanWithBatch(batch, 100, 1, 0, NULL));
+    TRY(ScanWithBatch(batch, 200, 0, 0, NULL));
+    TRY(ScanWithBatch(batch, 200, 1, 0, NULL));
+    // and PAX records after slotted ones
+    TRY(ScanWithBatch(batch, 400, 0, 2, columnOffsets));
+
+    LOG(INFO) << "test14 done";
+    return (0);
+}
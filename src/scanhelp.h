@@ -146,6 +146,12 @@ static int get_id(char *s) {
         return yylval.ival = RW_DATABASE;
     if (!strcmp(string, "databases"))
         return yylval.ival = RW_DATABASES;
+    if (!strcmp(string, "page_size"))
+        return yylval.ival = RW_PAGE_SIZE;
+    if (!strcmp(string, "compressed"))
+        return yylval.ival = RW_COMPRESSED;
+    if (!strcmp(string, "pax"))
+        return yylval.ival = RW_PAX;
     if (!strcmp(string, "tables"))
         return yylval.ival = RW_TABLES;
     if (!strcmp(string, "show"))
@@ -38,7 +38,9 @@ public:
 
     RC CreateTable(const char *relName,           // create relation relName
                    int        attrCount,          //   number of attributes
-                   AttrInfo   *attributes);       //   attribute data
+                   AttrInfo   *attributes,        //   attribute data
+                   bool       compressed = false, //   compress its pages
+                   bool       pax = false);       //   store pages as columns
     RC DropTable  (const char *relName);          // destroy a relation
 
     RC CreateIndex(const char *relName,           // create an index for
@@ -80,7 +82,9 @@ void SM_PrintError(RC rc);
 #define SM_INDEX_NOTEXIST        (START_SM_WARN + 4)
 #define SM_FILE_FORMAT_INCORRECT (START_SM_WARN + 5)
 #define SM_FILE_NOT_FOUND        (START_SM_WARN + 6)
-#define SM_LASTWARN SM_FILE_NOT_FOUND
+#define SM_UNKNOWN_PARAM         (START_SM_WARN + 7)
+#define SM_INVALID_PARAM_VALUE   (START_SM_WARN + 8)
+#define SM_LASTWARN SM_INVALID_PARAM_VALUE
 
 
 #define SM_CHDIR_FAILED    (START_SM_ERR - 0)
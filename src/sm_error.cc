@@ -21,6 +21,8 @@ static const char *SM_WarnMsg[] = {
         "index does not exist for given attribute",
         "file to load has incorrect format",
         "file not found",
+        "unknown system parameter",
+        "invalid value for system parameter",
         "length of string-typed attribute should not exceed MAXSTRINGLEN=255"
 };
 
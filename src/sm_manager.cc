@@ -11,8 +11,11 @@
 #include <memory>
 #include <cassert>
 #include <stddef.h>
+#include <climits>
 
 static const int kCwdLen = 256;
+// written in the database directory; not a valid relation name
+static const char *const kWarmUpList = ".warmup";
 
 SM_Manager::SM_Manager(IX_Manager &ixm_, RM_Manager &rmm_) {
     this->ixm = &ixm_;
@@ -23,6 +26,12 @@ SM_Manager::~SM_Manager() {}
 
 RC SM_Manager::OpenDb(const char *dbName) {
     if (chdir(dbName) != 0) return SM_CHDIR_FAILED;
+    // the buffer holds pages of the size the database was created with
+    int pageSize;
+    TRY(rmm->pfm->GetFilePageSize("relcat", pageSize));
+    TRY(rmm->pfm->SetPageSize(pageSize));
+    // read in again the pages that were in the buffer when it was closed
+    TRY(rmm->pfm->LoadWarmUp(kWarmUpList));
     TRY(rmm->OpenFile("relcat", relcat));
     TRY(rmm->OpenFile("attrcat", attrcat));
     return 0;
@@ -31,11 +40,13 @@ RC SM_Manager::OpenDb(const char *dbName) {
 RC SM_Manager::CloseDb() {
     TRY(rmm->CloseFile(relcat));
     TRY(rmm->CloseFile(attrcat));
+    TRY(rmm->pfm->SaveWarmUp(kWarmUpList));
     if (chdir("..") != 0) return SM_CHDIR_FAILED;
     return 0;
 }
 
-RC SM_Manager::CreateTable(const char *relName, int attrCount, AttrInfo *attributes) {
+RC SM_Manager::CreateTable(const char *relName, int attrCount, AttrInfo *attributes,
+                           bool compressed, bool pax) {
     RM_FileScan scan;
     RM_Record rec;
     TRY(scan.OpenScan(relcat, STRING, MAXNAME + 1, offsetof(RelCatEntry, relName),
@@ -47,6 +58,8 @@ RC SM_Manager::CreateTable(const char *relName, int attrCount, AttrInfo *attribu
     int indexNo = 0;
     short offset = 0;
     std::vector<short> nullableOffsets;
+    std::vector<short> varOffsets, varSizes;
+    std::vector<short> columnOffsets;
     for (int i = 0; i < attrCount; ++i) {
         AttrCatEntry attrEntry;
         memset(&attrEntry, 0, sizeof attrEntry);
@@ -60,6 +73,11 @@ RC SM_Manager::CreateTable(const char *relName, int attrCount, AttrInfo *attribu
         attrEntry.attrSpecs = attributes[i].attrSpecs;
         if (!(attrEntry.attrSpecs & ATTR_SPEC_NOTNULL))
             nullableOffsets.push_back(offset);
+        columnOffsets.push_back(offset);
+        if (attrEntry.attrSpecs & ATTR_SPEC_VARCHAR) {
+            varOffsets.push_back(offset);
+            varSizes.push_back((short)attrEntry.attrSize);
+        }
         offset += upper_align<4>(attrEntry.attrSize);
         if (attrEntry.attrSpecs & ATTR_SPEC_PRIMARYKEY) {
             attrEntry.indexNo = indexNo++;
@@ -77,8 +95,18 @@ RC SM_Manager::CreateTable(const char *relName, int attrCount, AttrInfo *attribu
     relEntry.indexCount = 0;
     relEntry.recordCount = 0;
     
-    TRY(rmm->CreateFile(relName, relEntry.tupleLength,
-                        (short)nullableOffsets.size(), &nullableOffsets[0]));
+    // A PAX file keeps VARCHAR attributes at their full size
+    if (pax) {
+        TRY(rmm->CreateFile(relName, relEntry.tupleLength,
+                            (short)nullableOffsets.size(), nullableOffsets.data(),
+                            compressed, 0, NULL, NULL,
+                            (short)columnOffsets.size(), columnOffsets.data()));
+    } else {
+        TRY(rmm->CreateFile(relName, relEntry.tupleLength,
+                            (short)nullableOffsets.size(), nullableOffsets.data(),
+                            compressed, (short)varOffsets.size(),
+                            varOffsets.data(), varSizes.data()));
+    }
     
     for (int i = 0; i < attrCount; ++i)
         if (attributes[i].attrSpecs & ATTR_SPEC_PRIMARYKEY)
@@ -319,7 +347,7 @@ RC SM_Manager::Print(const char *relName) {
     RM_FileScan scan;
     RM_Record rec;
     TRY(rmm->OpenFile(relName, fileHandle));
-    TRY(scan.OpenScan(fileHandle, INT, sizeof(int), 0, NO_OP, NULL));
+    TRY(scan.OpenScan(fileHandle, INT, sizeof(int), 0, NO_OP, NULL, SEQUENTIAL_SCAN));
     RC retcode;
     while ((retcode = scan.GetNextRec(rec)) != RM_EOF) {
         if (retcode) return retcode;
@@ -337,7 +365,68 @@ RC SM_Manager::Print(const char *relName) {
     return 0;
 }
 
+//
+// Set
+//
+// Supported parameters:
+//   buffer_pages    number of pages in the buffer pool
+//   buffer_pool_mb  size of the buffer pool in megabytes
+//   readahead_pages max pages read ahead by a sequential scan (0 = off)
+//   buffer_clean_pct percent of the buffer, next in line for replacement,
+//                   that is written in the background (0 = off)
+//   index_resident_pages internal nodes an open index keeps pinned in the
+//                   buffer (0 = none)
+//   buffer_trace    file to write a trace of the buffer accesses to, for
+//                   pf_replay ("" = stop tracing)
+//
 RC SM_Manager::Set(const char *paramName, const char *value) {
+    char *end;
+    long num = strtol(value, &end, 10);
+    bool valid = *value != '\0' && *end == '\0' && num > 0;
+
+    if (strcmp(paramName, "readahead_pages") == 0) {
+        if (*value == '\0' || *end != '\0' || num < 0 || num > INT_MAX)
+            return SM_INVALID_PARAM_VALUE;
+        TRY(rmm->pfm->SetReadAhead((int)num));
+        return 0;
+    }
+
+    if (strcmp(paramName, "index_resident_pages") == 0) {
+        if (*value == '\0' || *end != '\0' || num < 0 || num > INT_MAX)
+            return SM_INVALID_PARAM_VALUE;
+        TRY(ixm->SetResidentLimit((int)num));
+        return 0;
+    }
+
+    if (strcmp(paramName, "buffer_trace") == 0) {
+        if (*value == '\0') {
+            TRY(rmm->pfm->StopTrace());
+        } else {
+            TRY(rmm->pfm->StartTrace(value));
+        }
+        return 0;
+    }
+
+    if (strcmp(paramName, "buffer_clean_pct") == 0) {
+        if (*value == '\0' || *end != '\0' || num < 0 || num > 100)
+            return SM_INVALID_PARAM_VALUE;
+        TRY(rmm->pfm->SetCleanTarget((int)num));
+        return 0;
+    }
+
+    if (strcmp(paramName, "buffer_pages") == 0) {
+        if (!valid || num > INT_MAX) return SM_INVALID_PARAM_VALUE;
+        TRY(rmm->pfm->ResizeBuffer((int)num));
+    } else if (strcmp(paramName, "buffer_pool_mb") == 0) {
+        int blockSize;
+        TRY(rmm->pfm->GetBlockSize(blockSize));
+        if (!valid || num <= 0 || num > (long long)INT_MAX * blockSize / (1024 * 1024))
+            return SM_INVALID_PARAM_VALUE;
+        long long pages = (long long)num * 1024 * 1024 / blockSize;
+        TRY(rmm->pfm->ResizeBuffer((int)pages));
+    } else {
+        return SM_UNKNOWN_PARAM;
+    }
     return 0;
 }
 
@@ -22,17 +22,6 @@
 
 using namespace std;
 
-//
-// Here are Statistics Keys utilized by the PF layer of the Redbase
-// project.
-//
-const char *PF_GETPAGE = "GETPAGE";
-const char *PF_PAGEFOUND = "PAGEFOUND";
-const char *PF_PAGENOTFOUND = "PAGENOTFOUND";
-const char *PF_READPAGE = "READPAGE";           // IO
-const char *PF_WRITEPAGE = "WRITEPAGE";         // IO
-const char *PF_FLUSHPAGES = "FLUSHPAGES";
-
 //
 // Statistic class
 //
@@ -117,6 +106,7 @@ Boolean Statistic::operator==(const char *psKey_) const {
 //
 RC StatisticsMgr::Register (const char *psKey, const Stat_Operation op,
                             const int *const piValue) {
+    lock_guard<recursive_mutex> guard(latch);
     int i, iCount;
     Statistic *pStat = NULL;
 
@@ -176,6 +166,7 @@ RC StatisticsMgr::Register (const char *psKey, const Stat_Operation op,
 //
 // Print out the information pertaining to a specific statistic
 RC StatisticsMgr::Print(const char *psKey) {
+    lock_guard<recursive_mutex> guard(latch);
     if (psKey == NULL)
         return STAT_INVALID_ARGS;
 
@@ -201,6 +192,7 @@ RC StatisticsMgr::Print(const char *psKey) {
 // returned when done.
 //
 int *StatisticsMgr::Get(const char *psKey) {
+    lock_guard<recursive_mutex> guard(latch);
     int i, iCount;
     Statistic *pStat = NULL;
 
@@ -225,6 +217,7 @@ int *StatisticsMgr::Get(const char *psKey) {
 // Print out all the statistics tracked
 //
 void StatisticsMgr::Print() {
+    lock_guard<recursive_mutex> guard(latch);
     int i, iCount;
     Statistic *pStat = NULL;
 
@@ -243,6 +236,7 @@ void StatisticsMgr::Print() {
 // completely from the list
 //
 RC StatisticsMgr::Reset(const char *psKey) {
+    lock_guard<recursive_mutex> guard(latch);
     int i, iCount;
     Statistic *pStat = NULL;
 
@@ -273,5 +267,6 @@ RC StatisticsMgr::Reset(const char *psKey) {
 // elements to Erase itself.
 //
 void StatisticsMgr::Reset() {
+    lock_guard<recursive_mutex> guard(latch);
     llStats.Erase();
 }
@@ -17,9 +17,15 @@
 // Andre Bergholz, who was the TA for the 2000 offering, has written
 // some (or probably all) of this code.
 
+// The manager may be used from several threads at once; every method
+// holds the manager's latch.  The PF layer keeps its own counters
+// (pf_statistics.h).
+
 #ifndef STATISTICS_H
 #define STATISTICS_H
 
+#include <mutex>
+
 // Some common definitions that might not already be set
 #ifndef Boolean
 typedef char Boolean;
@@ -117,6 +123,7 @@ public:
 
 private:
     LinkList<Statistic> llStats;
+    std::recursive_mutex latch;   // Print(psKey) calls Get
 };
 
 //
@@ -125,17 +132,5 @@ private:
 const int STAT_INVALID_ARGS = STAT_BASE+1;  // Bad Args in call to method
 const int STAT_UNKNOWN_KEY  = STAT_BASE+2;  // No such Key being tracked
 
-//
-// The following are specifically for tracking the statistics in the PF
-// component of Redbase.  When statistics are utilized, these constants
-// will be used as the keys for the statistics manager.
-//
-extern const char *PF_GETPAGE;
-extern const char *PF_PAGEFOUND;
-extern const char *PF_PAGENOTFOUND;
-extern const char *PF_READPAGE;         // IO
-extern const char *PF_WRITEPAGE;        // IO
-extern const char *PF_FLUSHPAGES;
-
 #endif
 